@@ -5,6 +5,7 @@
 
 typedef struct taz_Interface taz_Interface;
 typedef struct taz_Config    taz_Config;
+typedef struct taz_Shared    taz_Shared;
 typedef struct taz_Var       taz_Var;
 typedef struct taz_StrLoan   taz_StrLoan;
 typedef struct taz_Trace     taz_Trace;
@@ -13,6 +14,7 @@ typedef struct taz_FunInfo   taz_FunInfo;
 typedef enum   taz_FibState  taz_FibState;
 typedef enum   taz_ErrNum    taz_ErrNum;
 typedef enum   taz_Scope     taz_Scope;
+typedef enum   taz_Pressure  taz_Pressure;
 
 
 typedef struct taz_Tup  taz_Tup;
@@ -28,9 +30,86 @@ typedef struct taz_Writer taz_Writer;
 
 typedef void*    (*taz_MemCb)( void* old, size_t osz, size_t nsz );
 typedef taz_Tup* (*taz_FunCb)( taz_Interface* taz, taz_Tup* args );
+typedef void     (*taz_PressureCb)( void* data, taz_Pressure level, size_t used );
 
 struct taz_Config {
     taz_MemCb alloc;
+    
+    // Number of objects the GC should scan per allocation while a
+    // full collection is in progress, or zero to have every cycle
+    // run to completion in one go.
+    unsigned gcStepSize;
+    
+    // Number of threads to mark full cycles with once the heap grows
+    // past `taz_CONFIG_GC_PARALLEL_MARK_THRESHOLD` bytes, only used if
+    // built with `taz_CONFIG_ENABLE_GC_PARALLEL_MARK`.
+    unsigned gcMarkThreads;
+    
+    // Heap size, in bytes, that the first cycle runs at; the heap is
+    // never paced below this.  Zero for `taz_CONFIG_GC_HEAP_TARGET`.
+    size_t gcHeapTarget;
+    
+    // How far the heap may grow past what survived the last cycle
+    // before the next one is run, as a fraction of the survivors.
+    // Zero for `taz_CONFIG_GC_HEAP_GROWTH`.
+    double gcHeapGrowth;
+    
+    // Every `gcFullInterval`th cycle is a full one, the rest only
+    // collect the nursery.  Zero for `taz_CONFIG_GC_FULL_CYCLE_INTERVAL`.
+    unsigned gcFullInterval;
+    
+    // The least number of bytes to be allocated after a full cycle
+    // starts before the GC starts another of its own accord, minor or
+    // incremental cycles are run in the meantime; see the Heap Limits
+    // note in `taz_engine.h`.  Zero for `taz_CONFIG_GC_FULL_MIN_ALLOC`.
+    size_t gcFullMinAlloc;
+    
+    // Soft and hard limits on the heap size in bytes, or zero for
+    // no limit.  Past the soft limit the GC runs full collections,
+    // past the hard limit allocations fail the current fiber.
+    size_t memSoftLimit;
+    size_t memHardLimit;
+    
+    // Called, if given, whenever a collection fails to bring the heap
+    // back under one of its limits; see the Heap Limits note in
+    // `taz_engine.h`.
+    taz_PressureCb onPressure;
+    void*          pressureData;
+    
+    // If non-zero the engine takes its memory from `alloc` in chunks
+    // of at least this many bytes, and never gives any back until it's
+    // freed; which is then done by releasing the chunks, without any
+    // finalizers being run.  Meant for short lived engines, such as
+    // those made for a single request.
+    size_t arenaChunkSize;
+    
+    // Disables automatic collection, the heap just grows until the
+    // engine is freed or `memHardLimit` is reached.
+    bool gcDisabled;
+    
+    // Queues the finalizers of dead state objects to be run once control
+    // returns to the host, instead of running them during the collection;
+    // see the Deferred Finalizers note in `taz_engine.h`.
+    bool gcDeferFinalizers;
+    
+    // Hands the memory released by the GC to a helper thread to be freed,
+    // only used if built with `taz_CONFIG_ENABLE_GC_BACKGROUND_FREE`; in
+    // which case `alloc` must be safe to call from another thread.
+    bool gcFreeThread;
+    
+    // Keeps small raw buffers, such as the value arrays of small records,
+    // in pages of their own which are compacted after full cycles; see the
+    // Compaction note in `taz_engine.h`.  Ignored by arena engines.  If
+    // built with `taz_CONFIG_ENABLE_PAGE_RELEASE` the emptied pages are
+    // released with `madvise()`, though they came from `alloc`; so it
+    // must give out private anonymous memory, as malloc() does.
+    bool gcCompact;
+    
+    // A frozen engine whose objects and interned strings this one may
+    // reference without copying them, as returned when it was frozen,
+    // or NULL; see the Sharing Engines note in `taz_engine.h`.  It must
+    // outlive this engine.
+    taz_Shared* shared;
 };
 
 struct taz_Var {
@@ -117,6 +196,7 @@ enum taz_ErrNum {
         taz_ErrNum_FIB_NOT_STOPPED,
         taz_ErrNum_TOO_MANY_RETURNS,
         taz_ErrNum_TOO_FEW_RETURNS,
+        taz_ErrNum_HEAP_LIMIT,
         taz_ErrNum_PANIC,
         taz_ErrNum_OTHER,
     taz_ErrNum_FATAL,
@@ -124,6 +204,11 @@ enum taz_ErrNum {
     taz_ErrNum_LAST
 };
 
+enum taz_Pressure {
+    taz_Pressure_SOFT,
+    taz_Pressure_HARD
+};
+
 enum taz_FibState {
     taz_FibState_CURRENT,
     taz_FibState_FAILED,
@@ -95,6 +95,14 @@ static size_t sizeofAssembler( tazE_Engine* eng, tazR_State* self ) {
     return sizeof(BCAssembler);
 }
 
+static size_t ownedByAssembler( tazE_Engine* eng, tazR_State* self ) {
+    BCAssembler* as = (BCAssembler*)self;
+    return
+        sizeof(BCInstr)*as->instrs.cap +
+        sizeof(BCLabel)*as->labels.cap +
+        sizeof(tazR_TVal)*as->consts.cap;
+}
+
 static unsigned addLabel( tazC_Assembler* _as, size_t where ) {
     BCAssembler* as = (BCAssembler*)_as;
     assert( where <= as->instrs.top );
@@ -321,6 +329,9 @@ tazC_Assembler* tazR_makeAssembler( tazE_Engine* eng, tazR_Str name, taz_Scope s
     as->base.base.finl      = finlAssembler;
     as->base.base.scan      = scanAssembler;
     as->base.base.size      = sizeofAssembler;
+    as->base.base.owned     = ownedByAssembler;
+    as->base.base.save      = NULL;
+    as->base.base.load      = NULL;
     as->base.addLabel       = addLabel;
     as->base.addInstr       = addInstr;
     as->base.addConst       = addConst;
@@ -491,6 +502,17 @@ void _tazR_scanCode( tazE_Engine* eng, tazR_Code* code, bool full ) {
     }
 }
 
+size_t _tazR_ownedCode( tazE_Engine* eng, tazR_Code* code ) {
+    if( code->type != tazR_CodeType_BYTE )
+        return 0;
+    
+    tazR_ByteCode* bcode = (tazR_ByteCode*)code;
+    return
+        sizeof(tazR_TVal)*bcode->numConsts +
+        sizeof(tazR_Label)*bcode->numLabels +
+        sizeof(ulongest)*bcode->numWords;
+}
+
 void _tazR_finlCode( tazE_Engine* eng, tazR_Code* code ) {
     if( code->type != tazR_CodeType_BYTE )
         return;
@@ -499,4 +521,91 @@ void _tazR_finlCode( tazE_Engine* eng, tazR_Code* code ) {
     tazE_freeRaw( eng, (void*)bcode->constBuf, sizeof(tazR_TVal)*bcode->numConsts );
     tazE_freeRaw( eng, (void*)bcode->labelBuf, sizeof(tazR_Label)*bcode->numLabels );
     tazE_freeRaw( eng, (void*)bcode->wordBuf, sizeof(ulongest)*bcode->numWords );
+}
+
+void _tazR_saveCode( tazE_Engine* eng, tazE_Image* img, tazR_Code* code ) {
+    tazE_saveWord( eng, img, code->type );
+    tazE_saveWord( eng, img, code->scope );
+    tazE_saveStr( eng, img, code->name );
+    tazE_saveWord( eng, img, code->numFixedParams );
+    tazE_saveRef( eng, img, code->varParamsIdx );
+    tazE_saveRef( eng, img, code->upvalIdx );
+    tazE_saveWord( eng, img, code->numUpvals );
+    tazE_saveRef( eng, img, code->localIdx );
+    tazE_saveWord( eng, img, code->numLocals );
+    
+    if( code->type == tazR_CodeType_HOST ) {
+        tazR_HostCode* hcode = (tazR_HostCode*)code;
+        tazE_saveWord( eng, img, hcode->cSize );
+        tazE_saveWord( eng, img, hcode->fSize );
+        tazE_saveHook( eng, img, (tazE_Hook)hcode->callback );
+        return;
+    }
+    
+    // Label addresses are still word offsets, so they're saved as is.
+    tazR_ByteCode* bcode = (tazR_ByteCode*)code;
+    tazE_saveWord( eng, img, bcode->numConsts );
+    for( unsigned i = 0 ; i < bcode->numConsts ; i++ )
+        tazE_saveVal( eng, img, bcode->constBuf[i] );
+    tazE_saveWord( eng, img, bcode->numLabels );
+    for( unsigned i = 0 ; i < bcode->numLabels ; i++ ) {
+        tazE_saveWord( eng, img, (uintptr_t)bcode->labelBuf[i].addr );
+        tazE_saveWord( eng, img, bcode->labelBuf[i].shift );
+    }
+    tazE_saveWord( eng, img, bcode->numWords );
+    for( unsigned i = 0 ; i < bcode->numWords ; i++ )
+        tazE_saveWord( eng, img, bcode->wordBuf[i] );
+}
+
+void _tazR_loadCode( tazE_Engine* eng, tazE_Image* img, tazR_Code* code ) {
+    code->type           = tazE_loadWord( eng, img );
+    code->scope          = tazE_loadWord( eng, img );
+    code->name           = tazE_loadStr( eng, img );
+    code->numFixedParams = tazE_loadWord( eng, img );
+    code->varParamsIdx   = tazE_loadRef( eng, img );
+    code->upvalIdx       = tazE_loadRef( eng, img );
+    code->numUpvals      = tazE_loadWord( eng, img );
+    code->localIdx       = tazE_loadRef( eng, img );
+    code->numLocals      = tazE_loadWord( eng, img );
+    
+    if( code->type == tazR_CodeType_HOST ) {
+        tazR_HostCode* hcode = (tazR_HostCode*)code;
+        hcode->cSize    = tazE_loadWord( eng, img );
+        hcode->fSize    = tazE_loadWord( eng, img );
+        hcode->callback = (taz_FunCb)tazE_loadHook( eng, img );
+        return;
+    }
+    if( code->type != tazR_CodeType_BYTE )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    tazR_ByteCode* bcode = (tazR_ByteCode*)code;
+    tazE_RawAnchor constsA, labelsA, wordsA;
+    
+    unsigned   numConsts = tazE_loadWord( eng, img );
+    tazR_TVal* consts    = tazE_mallocRaw( eng, &constsA, sizeof(tazR_TVal)*numConsts );
+    for( unsigned i = 0 ; i < numConsts ; i++ )
+        consts[i] = tazE_loadVal( eng, img );
+    
+    unsigned    numLabels = tazE_loadWord( eng, img );
+    tazR_Label* labels    = tazE_mallocRaw( eng, &labelsA, sizeof(tazR_Label)*numLabels );
+    for( unsigned i = 0 ; i < numLabels ; i++ ) {
+        labels[i].addr  = (ulongest*)(uintptr_t)tazE_loadWord( eng, img );
+        labels[i].shift = tazE_loadWord( eng, img );
+    }
+    
+    unsigned  numWords = tazE_loadWord( eng, img );
+    ulongest* words    = tazE_mallocRaw( eng, &wordsA, sizeof(ulongest)*numWords );
+    for( unsigned i = 0 ; i < numWords ; i++ )
+        words[i] = tazE_loadWord( eng, img );
+    
+    bcode->constBuf  = (tazR_TVal const*)consts;
+    bcode->numConsts = numConsts;
+    bcode->labelBuf  = (tazR_Label const*)labels;
+    bcode->numLabels = numLabels;
+    bcode->wordBuf   = (ulongest const*)words;
+    bcode->numWords  = numWords;
+    
+    tazE_commitRaw( eng, &wordsA );
+    tazE_commitRaw( eng, &labelsA );
+    tazE_commitRaw( eng, &constsA );
 }
\ No newline at end of file
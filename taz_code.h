@@ -65,10 +65,19 @@ void _tazR_scanCode( tazE_Engine* eng, tazR_Code* code, bool full );
 #define tazR_sizeofCode( ENG, CODE ) (                                                  \
     ((tazR_Code*)(CODE))->type == tazR_CodeType_HOST                                    \
         ? sizeof(tazR_HostCode)                                                         \
-        : sizeof(tazR_ByteCode) + ((tazR_ByteCode*)(CODE))->numWords*sizeof(ulongest)   \
+        : sizeof(tazR_ByteCode)                                                         \
 )
 
+#define tazR_ownedCode _tazR_ownedCode
+size_t _tazR_ownedCode( tazE_Engine* eng, tazR_Code* code );
+
 #define tazR_finlCode _tazR_finlCode
 void _tazR_finlCode( tazE_Engine* eng, tazR_Code* code );
 
+#define tazR_saveCode _tazR_saveCode
+void _tazR_saveCode( tazE_Engine* eng, tazE_Image* img, tazR_Code* code );
+
+#define tazR_loadCode _tazR_loadCode
+void _tazR_loadCode( tazE_Engine* eng, tazE_Image* img, tazR_Code* code );
+
 #endif
\ No newline at end of file
@@ -97,6 +97,7 @@ typedef struct tazR_Fun   tazR_Fun;
 typedef struct tazR_Fib   tazR_Fib;
 
 typedef struct tazE_Engine    tazE_Engine;
+typedef struct tazE_Image     tazE_Image;
 typedef struct tazC_Assembler tazC_Assembler;
 typedef enum   tazR_OpCode    tazR_OpCode;
 
@@ -128,6 +129,14 @@ struct tazR_Obj {
     #define tazR_OBJ_TAG_MARK_MASK  (0x1 << tazR_OBJ_TAG_MARK_SHIFT)
     #define tazR_OBJ_TAG_DEAD_SHIFT (5)
     #define tazR_OBJ_TAG_DEAD_MASK  (0x1 << tazR_OBJ_TAG_DEAD_SHIFT)
+    #define tazR_OBJ_TAG_OLD_SHIFT  (6)
+    #define tazR_OBJ_TAG_OLD_MASK   (0x1 << tazR_OBJ_TAG_OLD_SHIFT)
+    #define tazR_OBJ_TAG_REM_SHIFT  (7)
+    #define tazR_OBJ_TAG_REM_MASK   (0x1 << tazR_OBJ_TAG_REM_SHIFT)
+    #define tazR_OBJ_TAG_PAGE_SHIFT (8)
+    #define tazR_OBJ_TAG_PAGE_MASK  (0x1 << tazR_OBJ_TAG_PAGE_SHIFT)
+    #define tazR_OBJ_TAG_SAMP_SHIFT (9)
+    #define tazR_OBJ_TAG_SAMP_MASK  (0x1 << tazR_OBJ_TAG_SAMP_SHIFT)
 };
 #define tazR_getObjType( OBJ ) \
     tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_TYPE_MASK, tazR_OBJ_TAG_TYPE_SHIFT )
@@ -135,10 +144,16 @@ struct tazR_Obj {
     (tazR_Obj*)tazR_getPtrAddr( (OBJ)->next_and_tag )
 #define tazR_getObjData( OBJ ) \
     ((void*)(OBJ) + sizeof(tazR_Obj))
-#define tazR_isObjMarked( OBJ ) \
-    !!tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_MARK_MASK, tazR_OBJ_TAG_MARK_SHIFT )
 #define tazR_isObjDead( OBJ ) \
     !!tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_DEAD_MASK, tazR_OBJ_TAG_DEAD_SHIFT )
+#define tazR_isObjOld( OBJ ) \
+    !!tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_OLD_MASK, tazR_OBJ_TAG_OLD_SHIFT )
+#define tazR_isObjRemembered( OBJ ) \
+    !!tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_REM_MASK, tazR_OBJ_TAG_REM_SHIFT )
+#define tazR_isObjPaged( OBJ ) \
+    !!tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_PAGE_MASK, tazR_OBJ_TAG_PAGE_SHIFT )
+#define tazR_isObjSampled( OBJ ) \
+    !!tazR_getPtrTagBits( (OBJ)->next_and_tag, tazR_OBJ_TAG_SAMP_MASK, tazR_OBJ_TAG_SAMP_SHIFT )
 #define tazR_toObj( PTR ) \
     (tazR_Obj*)((void*)(PTR) - sizeof(tazR_Obj))
 
@@ -150,11 +165,23 @@ rather than an external vtable since these will generally just be used for
 maintaining the state of certain runtime subsystems; so there usually won't
 be enough of them for the memory overhead to be significant, and avoiding
 the extra dereference will improve GC time by a bit.
+
+The `size` callback gives the size the state was allocated with, while `owned`
+gives the size of any raw memory the state owns; it may be NULL if the state
+doesn't own any.
+
+The `save` and `load` callbacks write a state's contents to a heap image and
+read them back; `save` may be NULL, in which case engines holding the state
+can't be imaged.  Since the state is loaded into uninitialized memory, `load`
+must set all of the callbacks itself, including its own.
 */
 struct tazR_State {
     void   (*scan)( tazE_Engine* eng, tazR_State* self, bool full );
     void   (*finl)( tazE_Engine* eng, tazR_State* self );
     size_t (*size)( tazE_Engine* eng, tazR_State* self );
+    size_t (*owned)( tazE_Engine* eng, tazR_State* self );
+    void   (*save)( tazE_Engine* eng, tazR_State* self, tazE_Image* img );
+    void   (*load)( tazE_Engine* eng, tazR_State* self, tazE_Image* img );
 };
 
 typedef enum {
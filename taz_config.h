@@ -26,8 +26,96 @@
     #define taz_CONFIG_GC_FULL_CYCLE_INTERVAL (5)
 #endif
 
+#ifndef taz_CONFIG_GC_FULL_MIN_ALLOC
+    #define taz_CONFIG_GC_FULL_MIN_ALLOC (0)
+#endif
+
+#ifndef taz_CONFIG_GC_HEAP_TARGET
+    #define taz_CONFIG_GC_HEAP_TARGET (64*1024)
+#endif
+
+#ifndef taz_CONFIG_GC_HEAP_GROWTH
+    #define taz_CONFIG_GC_HEAP_GROWTH (0.5)
+#endif
+
 #ifndef taz_CONFIG_GC_STACK_SEGMENT_SIZE
-    #define taz_CONFIG_GC_STACK_SEGMENT_SIZE (16)
+    #define taz_CONFIG_GC_STACK_SEGMENT_SIZE (1024)
+#endif
+
+#ifndef taz_CONFIG_GC_PREFETCH_DISTANCE
+    #define taz_CONFIG_GC_PREFETCH_DISTANCE (8)
+#endif
+
+#ifndef taz_CONFIG_ALLOC_SAMPLE_DEPTH
+    #define taz_CONFIG_ALLOC_SAMPLE_DEPTH (64)
+#endif
+
+#ifndef taz_CONFIG_GC_PAUSE_PRECISION
+    #define taz_CONFIG_GC_PAUSE_PRECISION (2)
+#endif
+
+#ifndef taz_CONFIG_HEAP_PAGE_SIZE
+    #define taz_CONFIG_HEAP_PAGE_SIZE (8*1024)
+#endif
+
+#ifndef taz_CONFIG_HEAP_CHUNK_SIZE
+    #define taz_CONFIG_HEAP_CHUNK_SIZE (256*1024)
+#endif
+
+#ifndef taz_CONFIG_SCRATCH_CHUNK_SIZE
+    #define taz_CONFIG_SCRATCH_CHUNK_SIZE (64*1024)
+#endif
+
+#ifndef taz_CONFIG_GC_SWEEP_STEP_SIZE
+    #define taz_CONFIG_GC_SWEEP_STEP_SIZE (32)
+#endif
+
+#ifndef taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+    #define taz_CONFIG_ENABLE_GC_PARALLEL_MARK (0)
+#endif
+
+#ifndef taz_CONFIG_GC_MARK_DEQUE_SIZE
+    #define taz_CONFIG_GC_MARK_DEQUE_SIZE (1024)
+#endif
+
+#ifndef taz_CONFIG_GC_PARALLEL_MARK_THRESHOLD
+    #define taz_CONFIG_GC_PARALLEL_MARK_THRESHOLD (4*1024*1024)
+#endif
+
+#ifndef taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+    #define taz_CONFIG_ENABLE_GC_BACKGROUND_FREE (0)
+#endif
+
+#ifndef taz_CONFIG_GC_FREE_BATCH_SIZE
+    #define taz_CONFIG_GC_FREE_BATCH_SIZE (256)
+#endif
+
+#ifndef taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+    #if defined(__linux__)
+        #define taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE (1)
+    #else
+        #define taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE (0)
+    #endif
+#endif
+
+#ifndef taz_CONFIG_ENABLE_IMAGE_MAPPING
+    #if defined(__linux__)
+        #define taz_CONFIG_ENABLE_IMAGE_MAPPING (1)
+    #else
+        #define taz_CONFIG_ENABLE_IMAGE_MAPPING (0)
+    #endif
+#endif
+
+#ifndef taz_CONFIG_ENABLE_PAGE_RELEASE
+    #if defined(__linux__)
+        #define taz_CONFIG_ENABLE_PAGE_RELEASE (1)
+    #else
+        #define taz_CONFIG_ENABLE_PAGE_RELEASE (0)
+    #endif
+#endif
+
+#ifndef taz_CONFIG_LARGE_OBJECT_SIZE
+    #define taz_CONFIG_LARGE_OBJECT_SIZE (256*1024)
 #endif
 
 #ifndef taz_CONFIG_INDEX_IDEAL_STEP_LIMIT_KNOB
@@ -1,3 +1,8 @@
+// Needed for mremap(), this has to come before any system headers.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif
+
 #include "taz_engine.h"
 
 #ifndef taz_TESTING
@@ -6,860 +11,4637 @@
     #include "taz_record.h"
     #include "taz_upvalue.h"
     #include "taz_function.h"
+    
+    // Not all of the fiber hooks `taz_fiber.h` maps are written yet,
+    // so only the ones that are get declared here.
+    #define tazR_sampleFib _tazR_sampleFib
+    #define tazR_ownedFib  _tazR_ownedFib
+    unsigned _tazR_sampleFib( tazE_Engine* eng, tazR_Fib* fib, tazE_Frame* frames, unsigned max );
+    size_t   _tazR_ownedFib( tazE_Engine* eng, tazR_Fib* fib );
 #endif
 
 #include <string.h>
+#include <stdio.h>
 #include <limits.h>
+#include <time.h>
+#include <sched.h>
+
+#if taz_CONFIG_ENABLE_GC_PARALLEL_MARK || taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+    #include <pthread.h>
+#endif
+
+#if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE || taz_CONFIG_ENABLE_IMAGE_MAPPING || taz_CONFIG_ENABLE_PAGE_RELEASE
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#if taz_CONFIG_ENABLE_IMAGE_MAPPING
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#endif
 
 typedef struct EngineFull EngineFull;
 typedef struct StrPool    StrPool;
+typedef struct MarkWorker MarkWorker;
+typedef struct MarkSeg    MarkSeg;
+typedef struct MarkStack  MarkStack;
+typedef struct HeapPage   HeapPage;
+typedef struct HeapChunk  HeapChunk;
+typedef struct HeapCell   HeapCell;
+typedef struct HeapDump   HeapDump;
+typedef struct Sampler    Sampler;
+typedef struct ArenaChunk ArenaChunk;
+typedef struct FreeBatch  FreeBatch;
+typedef struct FreeThread FreeThread;
+
+#define NUM_SIZE_CLASSES (15)
+
+// Gray objects, those marked but not yet scanned, are kept on a stack
+// of segments allocated as needed; so marking a deep structure doesn't
+// recurse on the C stack.  A non-empty stack never has an empty top
+// segment, the one emptied last is kept as a spare so a stack that
+// hovers around a segment boundary doesn't keep allocating.
+struct MarkSeg {
+    MarkSeg*  prev;
+    unsigned  top;
+    tazR_Obj* objs[taz_CONFIG_GC_STACK_SEGMENT_SIZE];
+};
+
+struct MarkStack {
+    MarkSeg* seg;
+    MarkSeg* spare;
+};
+
+typedef enum {
+    GCPhase_IDLE,
+    GCPhase_MARK,
+    GCPhase_SWEEP
+} GCPhase;
 
 struct EngineFull {
     tazE_Engine view;
     taz_MemCb   alloc;
     
+    // In arena mode all memory is bumped out of these chunks, which
+    // are taken from `alloc`; see the Arena section.
+    ArenaChunk* arena;
+    size_t      arenaChunkSize;
+    
+    // Scratch memory for tentative allocations, taken from `alloc`
+    // and given back a barrier at a time; see the Scratch section.
+    ArenaChunk* scratch;
+    ArenaChunk* scratchSpare;
+    
     tazE_Barrier*  barriers;
     tazR_Obj*      objects;
+    tazR_Obj*      nursery;
+    tazR_Obj*      sweepPrev;
+    tazR_Obj*      sweepNext;
     taz_StrLoan*   loans;
     tazR_TVal      errvals[taz_ErrNum_LAST];
     
+    // While a heap dump is being written the marking functions write
+    // out references instead of marking them.
+    HeapDump* heapDump;
+    
+    // The allocation sampler, see its section below; this is NULL
+    // unless sampling has been started.
+    Sampler* sampler;
+    
     bool isGCRunning;
     bool isFullCycle;
     
     unsigned nGCCycles;
     
+    // Running statistics, see the note in the header.  The `memUsed`,
+    // `memLimit` and string counts are only filled in when they're
+    // requested.  `cycleMarkTime` accumulates the mark time of the
+    // cycle in progress.
+    tazE_Stats stats;
+    ulongest   cycleMarkTime;
+    
+    // The raw memory owned by the survivors of a full cycle is tallied by
+    // type as they're swept, then moved into `stats.ownedBytes` once the
+    // sweep is done.  What the survivors come to in all is `oldSize`, and
+    // `oldGrowth` what's been promoted since; once that's grown past the
+    // heap growth factor of the old size, the next cycle is a full one.
+    size_t ownedTally[tazR_Type_LAST_OBJECT + 1];
+    size_t oldSize;
+    size_t oldGrowth;
+    
+    // When `gcStepSize` is non-zero full cycles are run incrementally,
+    // with the marking phase being spread over subsequent allocations;
+    // while `gcPhase` is GCPhase_MARK the mutator must keep the write
+    // barrier's invariant: marked objects never reference unmarked ones.
+    // Once marked the old generation is swept lazily, a little on each
+    // object allocation; in the GCPhase_SWEEP phase `sweepNext` is the
+    // next old object to be swept and `sweepPrev` the one before it.
+    // 
+    GCPhase  gcPhase;
+    unsigned gcStepSize;
+    
+    // The marking threads are started the first time they're needed,
+    // then wait on `gcMarkWake` for `gcMarkRound` to change; whoever
+    // started the round waits on `gcMarkDone` for `gcMarkBusy` threads
+    // to finish it.
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        unsigned        gcMarkThreads;
+        unsigned        gcMarkIdle;
+        MarkWorker*     gcMarkWorkers;
+        pthread_mutex_t gcMarkLock;
+        pthread_cond_t  gcMarkWake;
+        pthread_cond_t  gcMarkDone;
+        unsigned        gcMarkRound;
+        unsigned        gcMarkBusy;
+        bool            gcMarkStop;
+    #endif
+    
+    // The next cycle runs once `memUsed` passes `memLimit`, which is
+    // set after each one by `adjustHeap()`.  See the Heap Limits note
+    // in the header for the soft and hard limits; `inPressure` is set
+    // while the pressure callback runs, to keep it from being called
+    // again by anything it does.  `sinceFull` counts the bytes allocated
+    // since the last full cycle started, which has to reach
+    // `gcFullMinAlloc` before the GC will start another by itself.
     size_t memUsed;
     size_t memLimit;
+    size_t memTarget;
     double memGrowth;
+    size_t memSoftLimit;
+    size_t memHardLimit;
+    unsigned       gcFullInterval;
+    size_t         gcFullMinAlloc;
+    size_t         sinceFull;
+    taz_PressureCb onPressure;
+    void*          pressureData;
+    bool           inPressure;
+    
+    // The large object space, see its section below.  `largeUsed` is
+    // the part of `memUsed` that's mapped directly, the spare mapping
+    // isn't counted at all since its pages have been given back.
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE || taz_CONFIG_ENABLE_PAGE_RELEASE
+        size_t osPageSize;
+    #endif
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        size_t largeMin;
+        size_t largeUsed;
+        void*  largeSpare;
+        size_t largeSpareSize;
+    #endif
     
-    unsigned   gcStackTop;
-    tazR_Obj** gcStackBuf;
-    bool       gcDisabled;
+    // If a mark stack segment can't be allocated then the serial marker
+    // falls back on `gcReserveSeg`; past that the object is left marked
+    // but unscanned and `gcStackOverflow` is set, then once the stack
+    // is drained every marked object is scanned again to pick up
+    // anything that was missed.
+    MarkStack gcStack;
+    MarkSeg   gcReserveSeg;
+    bool      gcReserveUsed;
+    bool      gcStackOverflow;
+    bool      gcDisabled;
     
-    tazR_Obj* gcFirstStackBuf[taz_CONFIG_GC_STACK_SEGMENT_SIZE];
+    // Set while an engine is being reset with `tazE_Keep_STRS`, so the
+    // cycle leaves the string pool alone.
+    bool gcKeepStrs;
+    
+    // Set once the engine is frozen for sharing, after which it's only
+    // read; see `tazE_freezeEngine()`.
+    bool frozen;
+    
+    // Dead state objects waiting for their finalizers to be run, linked
+    // through their `next` pointers; see `tazE_runFinalizers()`.
+    tazR_Obj* finlQueue;
+    size_t    finlPending;
+    bool      deferFinl;
+    
+    // With `taz_Config.gcFreeThread` set the memory released while the
+    // GC runs is queued on `freeBatch`, to be freed by the helper; see
+    // the Background Freeing section.
+    #if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+        FreeThread* freeThread;
+        FreeBatch*  freeBatch;
+    #endif
+    
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        bool gcMarkAllocLock;
+    #endif
+    
+    // The remembered set, this keeps track of old objects which
+    // may reference young ones; see the Generations note in the
+    // header.  If we fail to grow the set then the overflow flag
+    // is set to force the next cycle to be a full one.
+    unsigned   remSetTop;
+    unsigned   remSetCap;
+    tazR_Obj** remSetBuf;
+    bool       remSetOverflow;
+    
+    // Objects with weak references which were scanned this cycle, these
+    // are traced and cleared by `processWeak()` once everything else has
+    // been marked.  If we fail to grow the buffer then the object is
+    // told to mark its references as usual instead.
+    unsigned   weakTop;
+    unsigned   weakCap;
+    tazR_Obj** weakBuf;
+    
+    // Pages of small object cells, see the Object Heap section.  The
+    // pages in `heapAvail` have free cells, those in `heapEmpty` have
+    // yet to be assigned a size class.  With `rawPages` set small raw
+    // buffers get pages of their own, those with free cells are kept
+    // in `rawAvail`; see the Compaction section.
+    HeapPage*  heapAvail[NUM_SIZE_CLASSES];
+    HeapPage*  rawAvail[NUM_SIZE_CLASSES];
+    HeapPage*  heapEmpty;
+    HeapChunk* heapChunks;
+    bool       rawPages;
+    bool       compactDue;
     
     StrPool* strPool;
 };
 
-/********************** Memory Management Helpers *****************************/
+/********************************** Arena *************************************/
 
-static void collect( EngineFull* eng, size_t nsz, bool full );
+// An engine made with a non-zero `taz_Config.arenaChunkSize` serves all
+// of its memory from a bump allocator over chunks of at least that size.
+// Nothing is given back until the engine is freed, except the most recent
+// allocation in the current chunk, which can be resized or released in
+// place; then the chunks are released whole, without visiting any of the
+// objects or strings.  Requests too big to leave much of a chunk over get
+// a chunk of their own, so the current one isn't wasted.
+//
+// Each block is preceded by its capacity; a block that has to move to
+// grow is given twice its old capacity, so buffers grown a little at a
+// time (like the string pool's maps) don't leave a trail of copies.
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t      size;
+    char*       bump;
+    char*       end;
+};
 
-static void* reallocMem( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
-    assert( !eng->isGCRunning || nsz == 0 );
-    if( osz == nsz )
-        return old;
+#define ARENA_ALIGN        (16)
+#define ARENA_HEADER_SIZE  ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define arenaRound( SZ )   (((SZ) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define arenaCap( MEM )    (*(size_t*)((char*)(MEM) - ARENA_ALIGN))
+
+static ArenaChunk* makeArenaChunk( taz_MemCb alloc, size_t sz ) {
+    ArenaChunk* chunk = alloc( NULL, 0, ARENA_HEADER_SIZE + sz );
+    if( !chunk )
+        return NULL;
     
-    if( eng->memUsed - osz + nsz > eng->memLimit  )
-        collect( eng, nsz, false );
+    chunk->next = NULL;
+    chunk->size = ARENA_HEADER_SIZE + sz;
+    chunk->bump = (char*)chunk + ARENA_HEADER_SIZE;
+    chunk->end  = (char*)chunk + chunk->size;
+    return chunk;
+}
+
+static void freeArena( taz_MemCb alloc, ArenaChunk* chunk ) {
+    while( chunk ) {
+        ArenaChunk* next = chunk->next;
+        alloc( chunk, chunk->size, 0 );
+        chunk = next;
+    }
+}
+
+static void* bumpArena( EngineFull* eng, size_t sz ) {
+    ArenaChunk* chunk = eng->arena;
+    size_t      rsz   = ARENA_ALIGN + arenaRound( sz );
+    char*       mem;
+    if( (size_t)(chunk->end - chunk->bump) >= rsz ) {
+        mem = chunk->bump;
+        chunk->bump += rsz;
+        goto found;
+    }
     
-    void* mem = eng->alloc( old, osz, nsz );
-    if( !mem && nsz > 0 ) {
-        collect( eng, nsz, false );
-        if( !mem )
-            tazE_error( (tazE_Engine*)eng, taz_ErrNum_MEMORY );
+    ArenaChunk* nchunk;
+    if( rsz > eng->arenaChunkSize/4 ) {
+        nchunk = makeArenaChunk( eng->alloc, rsz );
+        if( !nchunk )
+            return NULL;
+        nchunk->next = chunk->next;
+        chunk->next  = nchunk;
+    }
+    else {
+        nchunk = makeArenaChunk( eng->alloc, eng->arenaChunkSize );
+        if( !nchunk )
+            return NULL;
+        nchunk->next = chunk;
+        eng->arena   = nchunk;
     }
     
-    eng->memUsed -= osz;
-    eng->memUsed += nsz;
+    mem = nchunk->bump;
+    nchunk->bump += rsz;
+
+found:
+    mem += ARENA_ALIGN;
+    arenaCap( mem ) = rsz - ARENA_ALIGN;
     return mem;
 }
 
-static void* mallocMem( EngineFull* eng, size_t nsz ) {
-    return reallocMem( eng, NULL, 0, nsz );
+static void* arenaAlloc( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
+    if( !old )
+        return nsz > 0 ? bumpArena( eng, nsz ) : NULL;
+    
+    ArenaChunk* chunk = eng->arena;
+    size_t      cap   = arenaCap( old );
+    bool        last  = (char*)old + cap == chunk->bump;
+    if( nsz == 0 ) {
+        if( last )
+            chunk->bump = (char*)old - ARENA_ALIGN;
+        return NULL;
+    }
+    if( nsz <= cap )
+        return old;
+    if( last && arenaRound( nsz ) <= (size_t)(chunk->end - (char*)old) ) {
+        arenaCap( old ) = arenaRound( nsz );
+        chunk->bump     = (char*)old + arenaRound( nsz );
+        return old;
+    }
+    
+    void* mem = bumpArena( eng, nsz > 2*cap ? nsz : 2*cap );
+    if( mem )
+        memcpy( mem, old, osz );
+    return mem;
 }
 
-static void  freeMem( EngineFull* eng, void* old, size_t osz ) {
-    reallocMem( eng, old, osz, 0 );
-}
+/********************************* Scratch ************************************/
 
-#ifndef tazR_finlIdx
-    #define tazR_finlIdx( ENG, OBJ )
-#endif
-#ifndef tazR_finlRec
-    #define tazR_finlRec( ENG, OBJ )
-#endif
-#ifndef tazR_finlCode
-    #define tazR_finlCode( ENG, OBJ )
-#endif
-#ifndef tazR_finlFun
-    #define tazR_finlFun( ENG, OBJ )
-#endif
-#ifndef tazR_finlFib
-    #define tazR_finlFib( ENG, OBJ )
-#endif
-#ifndef tazR_finlUpv
-    #define tazR_finlUpv( ENG, OBJ )
-#endif
+// Raw allocations made by `tazE_scratchRaw()` are bumped out of these
+// chunks, newest first.  Pushing a barrier notes where the bump pointer
+// stands, and clearing it winds the pointer back there; so whatever the
+// barrier's scratch allocations took is given back in one step, however
+// many there were.  Chunks emptied by the rewind are freed, except for
+// one kept as a spare so a barrier that runs into a second chunk doesn't
+// allocate it on every call.  Requests bigger than a quarter of a chunk
+// would waste too much of it, so they're taken from the heap instead.
+//
+// Scratch anchors aren't linked into the barrier's list, as there's
+// nothing to do for them one by one; their `link` is set to the address
+// of `scratchLink` instead, so committing them knows to copy them out.
+#define SCRATCH_MAX  (taz_CONFIG_SCRATCH_CHUNK_SIZE/4)
 
-static void destructObj( EngineFull* eng, tazR_Obj* obj ) {
-    void* data = tazR_getObjData( obj );
-    switch( tazR_getObjType( obj ) ) {
-        case tazR_Type_IDX:
-            tazR_finlIdx( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_REC:
-            tazR_finlRec( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_CODE:
-            tazR_finlCode( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_FUN:
-            tazR_finlFun( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_FIB:
-            tazR_finlFib( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_UPV:
-            tazR_finlUpv( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_STATE:
-            if( ((tazR_State*)data)->finl )
-                ((tazR_State*)data)->finl( (tazE_Engine*)eng, data );
-        break;
-        default:
-            assert( false );
-        break;
-    }
-}
+static tazE_RawAnchor* scratchLink;
 
+#define isScratch( ANC ) ((ANC)->link == &scratchLink)
 
-#ifndef tazR_sizeofIdx
-    #define tazR_sizeofIdx( ENG, OBJ ) 1
-#endif
-#ifndef tazR_sizeofRec
-    #define tazR_sizeofRec( ENG, OBJ ) 1
-#endif
-#ifndef tazR_sizeofCode
-    #define tazR_sizeofCode( ENG, OBJ ) 1
-#endif
-#ifndef tazR_sizeofFun
-    #define tazR_sizeofFun( ENG, OBJ ) 1
-#endif
-#ifndef tazR_sizeofFib
-    #define tazR_sizeofFib( ENG, OBJ ) 1
-#endif
-#ifndef tazR_sizeofUpv
-    #define tazR_sizeofUpv( ENG, OBJ ) 1
-#endif
+static void* bumpScratch( EngineFull* eng, size_t sz ) {
+    ArenaChunk* chunk = eng->scratch;
+    size_t      rsz   = arenaRound( sz );
+    if( !chunk || (size_t)(chunk->end - chunk->bump) < rsz ) {
+        chunk = eng->scratchSpare;
+        eng->scratchSpare = NULL;
+        if( !chunk )
+            chunk = makeArenaChunk( eng->alloc, taz_CONFIG_SCRATCH_CHUNK_SIZE );
+        if( !chunk )
+            return NULL;
+        
+        chunk->next  = eng->scratch;
+        eng->scratch = chunk;
+    }
+    
+    void* mem = chunk->bump;
+    chunk->bump += rsz;
+    return mem;
+}
 
-static void releaseObj( EngineFull* eng, tazR_Obj* obj ) {
-    size_t size = sizeof(tazR_Obj);
-    void*  data = tazR_getObjData( obj );
-    switch( tazR_getObjType( obj ) ) {
-        case tazR_Type_IDX:
-            size += tazR_sizeofIdx( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_REC:
-            size += tazR_sizeofRec( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_CODE:
-            size += tazR_sizeofCode( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_FUN:
-            size += tazR_sizeofFun( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_FIB:
-            size += tazR_sizeofFib( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_UPV:
-            size += tazR_sizeofUpv( (tazE_Engine*)eng, data );
-        break;
-        case tazR_Type_STATE:
-            if( ((tazR_State*)data)->size )
-                size += ((tazR_State*)data)->size( (tazE_Engine*)eng, data );
-        break;
-        default:
-            assert( false );
-        break;
+static void rewindScratch( EngineFull* eng, ArenaChunk* chunk, char* bump ) {
+    while( eng->scratch != chunk ) {
+        ArenaChunk* top = eng->scratch;
+        eng->scratch = top->next;
+        
+        top->next = NULL;
+        if( eng->scratchSpare ) {
+            freeArena( eng->alloc, top );
+        }
+        else {
+            top->bump = (char*)top + ARENA_HEADER_SIZE;
+            eng->scratchSpare = top;
+        }
     }
-    freeMem( eng, obj, size );
+    if( chunk )
+        chunk->bump = bump;
 }
 
+// All of the engine's memory comes through here.
+static void* sysAlloc( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
+    if( eng->arena )
+        return arenaAlloc( eng, old, osz, nsz );
+    return eng->alloc( old, osz, nsz );
+}
 
+/***************************** Large Object Space *****************************/
 
-#ifndef tazR_scanIdx
-    #define tazR_scanIdx( ENG, OBJ, FULL )
-#endif
-#ifndef tazR_scanRec
-    #define tazR_scanRec( ENG, OBJ, FULL )
-#endif
-#ifndef tazR_scanCode
-    #define tazR_scanCode( ENG, OBJ, FULL )
-#endif
-#ifndef tazR_scanFun
-    #define tazR_scanFun( ENG, OBJ, FULL )
-#endif
-#ifndef tazR_scanFib
-    #define tazR_scanFib( ENG, OBJ, FULL )
-#endif
-#ifndef tazR_scanUpv
-    #define tazR_scanUpv( ENG, OBJ, FULL )
-#endif
+// Buffers of `taz_CONFIG_LARGE_OBJECT_SIZE` bytes or more (long strings,
+// big record value arrays and index tables) are mapped directly rather
+// than taken from the allocator callback; so they don't fragment the
+// general heap, can be grown in place or moved without a copy, and go
+// straight back to the system when released.  The last mapping to be
+// released is kept as a spare, with its pages discarded, since a big
+// buffer is often freed just before a replacement is allocated.
+//
+// Fresh or discarded anonymous pages read as zero, so large buffers
+// needn't be cleared by `tazE_zallocRaw()`.  Arena engines keep their
+// large buffers in the arena with everything else, so `largeMin` is set
+// past any size for them.
+#if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
 
-static void scanObj( EngineFull* eng, tazR_Obj* obj, bool full ) {
-    void*  data = tazR_getObjData( obj );
-    switch( tazR_getObjType( obj ) ) {
-        case tazR_Type_IDX:
-            tazR_scanIdx( (tazE_Engine*)eng, data, full );
-        break;
-        case tazR_Type_REC:
-            tazR_scanRec( (tazE_Engine*)eng, data, full );
-        break;
-        case tazR_Type_CODE:
-            tazR_scanCode( (tazE_Engine*)eng, data, full );
-        break;
-        case tazR_Type_FUN:
-            tazR_scanFun( (tazE_Engine*)eng, data, full );
-        break;
-        case tazR_Type_FIB:
-            tazR_scanFib( (tazE_Engine*)eng, data, full );
-        break;
-        case tazR_Type_UPV:
-            tazR_scanUpv( (tazE_Engine*)eng, data, full );
-        break;
-        case tazR_Type_STATE:
-            if( ((tazR_State*)data)->scan )
-                ((tazR_State*)data)->scan( (tazE_Engine*)eng, data, full );
-        break;
-        default:
-            assert( false );
-        break;
-    }
+#define isLarge( ENG, SZ ) ((SZ) >= (ENG)->largeMin)
+
+static size_t largeSize( EngineFull* eng, size_t sz ) {
+    return (sz + eng->osPageSize - 1) & ~(eng->osPageSize - 1);
 }
 
-static void clearBarrier( EngineFull* eng, tazE_Barrier* bar ) {
-    tazE_ObjAnchor* oIt = bar->objAnchors;
-    while( oIt ) {
-        tazE_ObjAnchor* anc = oIt;
-        oIt = oIt->next;
-        
-        tazE_cancelObj( (tazE_Engine*)eng, anc );
-    }
+static void* mapLarge( EngineFull* eng, size_t sz ) {
+    size_t msz = largeSize( eng, sz );
+    void*  mem = MAP_FAILED;
     
-    tazE_RawAnchor* rIt = bar->rawAnchors;
-    while( rIt ) {
-        tazE_RawAnchor* anc = rIt;
-        rIt = rIt->next;
-        
-        tazE_cancelRaw( (tazE_Engine*)eng, anc );
+    if( eng->largeSpare ) {
+        mem = mremap( eng->largeSpare, eng->largeSpareSize, msz, MREMAP_MAYMOVE );
+        if( mem == MAP_FAILED )
+            munmap( eng->largeSpare, eng->largeSpareSize );
+        eng->largeSpare = NULL;
     }
+    if( mem == MAP_FAILED )
+        mem = mmap( NULL, msz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( mem == MAP_FAILED )
+        return NULL;
     
-    bar->buckets = NULL;
-}
-
-static struct {
-    tazE_Bucket base;
-    tazR_TVal   val1;
-    tazR_TVal   val2;
-} const DMY_BUCKET;
-static size_t const FIRST_BUCKET_OFFSET = (void*)&DMY_BUCKET.val1 - (void*)&DMY_BUCKET;
-static size_t const NEXT_BUCKET_OFFSET  = (void*)&DMY_BUCKET.val2 - (void*)&DMY_BUCKET.val1;
-
-static void adjustHeap( EngineFull* eng, size_t nsz ) {
-    assert( eng->memGrowth > 0.0 && eng->memGrowth <= 1.0 );
-    double mul = 1.0 + eng->memGrowth;
-    eng->memLimit = (double)(eng->memLimit + nsz) * mul;
+    eng->largeUsed += msz;
+    return mem;
 }
 
-static void startStringGC( tazE_Engine* eng );
-static void finishStringGC( tazE_Engine* eng );
-
-static void collect( EngineFull* eng, size_t nsz, bool full ) {
-    if( eng->gcDisabled ) {
-        adjustHeap( eng, nsz );
+static void unmapLarge( EngineFull* eng, void* mem, size_t sz ) {
+    size_t msz = largeSize( eng, sz );
+    eng->largeUsed -= msz;
+    
+    if( eng->largeSpare || madvise( mem, msz, MADV_DONTNEED ) != 0 ) {
+        munmap( mem, msz );
         return;
     }
+    eng->largeSpare     = mem;
+    eng->largeSpareSize = msz;
+}
+
+static void* remapLarge( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
+    size_t omsz = largeSize( eng, osz );
+    size_t nmsz = largeSize( eng, nsz );
+    if( omsz == nmsz )
+        return old;
     
-    eng->isGCRunning = true;
+    void* mem = mremap( old, omsz, nmsz, MREMAP_MAYMOVE );
+    if( mem == MAP_FAILED )
+        return NULL;
     
-    if( eng->nGCCycles++ % taz_CONFIG_GC_FULL_CYCLE_INTERVAL == 0 || full ) {
+    eng->largeUsed -= omsz;
+    eng->largeUsed += nmsz;
+    return mem;
+}
+
+// Same contract as the allocator callback, for when either the old or
+// new size is large.  Buffers crossing the threshold are copied between
+// the callback's heap and a mapping.
+static void* allocLarge( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
+    if( nsz == 0 ) {
+        unmapLarge( eng, old, osz );
+        return NULL;
+    }
+    if( osz == 0 )
+        return mapLarge( eng, nsz );
+    if( isLarge( eng, osz ) && isLarge( eng, nsz ) )
+        return remapLarge( eng, old, osz, nsz );
+    
+    void* mem = isLarge( eng, nsz ) ? mapLarge( eng, nsz ) : sysAlloc( eng, NULL, 0, nsz );
+    if( !mem )
+        return NULL;
+    
+    memcpy( mem, old, osz < nsz ? osz : nsz );
+    if( isLarge( eng, osz ) )
+        unmapLarge( eng, old, osz );
+    else
+        sysAlloc( eng, old, osz, 0 );
+    return mem;
+}
+
+static void freeLargeSpare( EngineFull* eng ) {
+    if( eng->largeSpare )
+        munmap( eng->largeSpare, eng->largeSpareSize );
+    eng->largeSpare = NULL;
+}
+
+#endif
+
+/***************************** Background Freeing *****************************/
+
+// With `taz_Config.gcFreeThread` set the memory released while the GC is
+// running, the raw buffers of dead objects and those objects too big for
+// the pages, isn't given back on the spot.  It's taken off `memUsed` as
+// usual, then queued in batches for a helper thread to pass back to the
+// allocator callback, or unmap; so the mutator only pays for appending to
+// the batch.  A batch is handed over when it fills up, and at the end of
+// each sweep.  Large mappings are always unmapped rather than kept as the
+// spare, since the spare belongs to the mutator.
+//
+// The thread is started the first time there's something for it.  If it
+// can't be, or a batch can't be allocated, memory is freed in place as it
+// would be otherwise.
+#if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+
+struct FreeBatch {
+    FreeBatch* next;
+    unsigned   top;
+    struct {
+        void*  mem;
+        size_t sz;
+        bool   mapped;
+    } items[taz_CONFIG_GC_FREE_BATCH_SIZE];
+};
+
+struct FreeThread {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    taz_MemCb       alloc;
+    FreeBatch*      queue;
+    bool            started;
+    bool            stop;
+};
+
+static FreeThread* makeFreeThread( taz_MemCb alloc ) {
+    FreeThread* ft = alloc( NULL, 0, sizeof(FreeThread) );
+    if( !ft )
+        return NULL;
+    
+    pthread_mutex_init( &ft->lock, NULL );
+    pthread_cond_init( &ft->wake, NULL );
+    ft->alloc   = alloc;
+    ft->queue   = NULL;
+    ft->started = false;
+    ft->stop    = false;
+    return ft;
+}
+
+static void freeBatches( taz_MemCb alloc, FreeBatch* batch ) {
+    while( batch ) {
+        FreeBatch* next = batch->next;
+        for( unsigned i = 0 ; i < batch->top ; i++ ) {
+            #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+                if( batch->items[i].mapped ) {
+                    munmap( batch->items[i].mem, batch->items[i].sz );
+                    continue;
+                }
+            #endif
+            alloc( batch->items[i].mem, batch->items[i].sz, 0 );
+        }
+        alloc( batch, sizeof(FreeBatch), 0 );
+        batch = next;
+    }
+}
+
+static void* freeThreadMain( void* arg ) {
+    FreeThread* ft = arg;
+    
+    pthread_mutex_lock( &ft->lock );
+    for( ;; ) {
+        while( !ft->queue && !ft->stop )
+            pthread_cond_wait( &ft->wake, &ft->lock );
+        if( !ft->queue )
+            break;
+        
+        FreeBatch* batch = ft->queue;
+        ft->queue = NULL;
+        pthread_mutex_unlock( &ft->lock );
+        freeBatches( ft->alloc, batch );
+        pthread_mutex_lock( &ft->lock );
+    }
+    pthread_mutex_unlock( &ft->lock );
+    return NULL;
+}
+
+// Hands the current batch to the helper thread.
+static void flushFrees( EngineFull* eng ) {
+    FreeBatch*  batch = eng->freeBatch;
+    FreeThread* ft    = eng->freeThread;
+    if( !batch )
+        return;
+    eng->freeBatch = NULL;
+    
+    if( !ft->started )
+        ft->started = !pthread_create( &ft->thread, NULL, freeThreadMain, ft );
+    if( !ft->started ) {
+        freeBatches( ft->alloc, batch );
+        return;
+    }
+    
+    pthread_mutex_lock( &ft->lock );
+    batch->next = ft->queue;
+    ft->queue   = batch;
+    pthread_cond_signal( &ft->wake );
+    pthread_mutex_unlock( &ft->lock );
+}
+
+// Queues memory to be freed by the helper thread, returns false if it
+// has to be freed in place instead.
+static bool freeLater( EngineFull* eng, void* mem, size_t sz ) {
+    FreeBatch* batch = eng->freeBatch;
+    if( batch && batch->top == taz_CONFIG_GC_FREE_BATCH_SIZE ) {
+        flushFrees( eng );
+        batch = NULL;
+    }
+    if( !batch ) {
+        batch = eng->alloc( NULL, 0, sizeof(FreeBatch) );
+        if( !batch )
+            return false;
+        batch->next    = NULL;
+        batch->top     = 0;
+        eng->freeBatch = batch;
+    }
+    
+    bool mapped = false;
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        if( isLarge( eng, sz ) ) {
+            mapped = true;
+            sz     = largeSize( eng, sz );
+            eng->largeUsed -= sz;
+        }
+    #endif
+    batch->items[batch->top].mem    = mem;
+    batch->items[batch->top].sz     = sz;
+    batch->items[batch->top].mapped = mapped;
+    batch->top++;
+    return true;
+}
+
+// Waits for the helper thread to free everything it's been given.
+static void freeFreeThread( EngineFull* eng ) {
+    FreeThread* ft = eng->freeThread;
+    if( !ft )
+        return;
+    
+    flushFrees( eng );
+    if( ft->started ) {
+        pthread_mutex_lock( &ft->lock );
+        ft->stop = true;
+        pthread_cond_signal( &ft->wake );
+        pthread_mutex_unlock( &ft->lock );
+        pthread_join( ft->thread, NULL );
+    }
+    pthread_mutex_destroy( &ft->lock );
+    pthread_cond_destroy( &ft->wake );
+    eng->alloc( ft, sizeof(FreeThread), 0 );
+    eng->freeThread = NULL;
+}
+
+#else
+
+#define flushFrees( ENG )
+
+#endif
+
+/********************** Memory Management Helpers *****************************/
+
+static void collect( EngineFull* eng, size_t nsz, bool full );
+static void stepGC( EngineFull* eng, size_t nsz );
+static bool isRawCell( EngineFull* eng, size_t sz );
+static void* reallocCell( EngineFull* eng, void* old, size_t osz, size_t nsz );
+
+// The amount of memory actually taken by an allocation of the given
+// size; large buffers are rounded up to whole pages.
+static size_t memSize( EngineFull* eng, size_t sz ) {
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        if( isLarge( eng, sz ) )
+            return largeSize( eng, sz );
+    #endif
+    return sz;
+}
+
+static void notifyPressure( EngineFull* eng, taz_Pressure level ) {
+    if( !eng->onPressure || eng->inPressure )
+        return;
+    
+    eng->inPressure = true;
+    eng->onPressure( eng->pressureData, level, eng->memUsed );
+    eng->inPressure = false;
+}
+
+static bool isFullDue( EngineFull* eng ) {
+    return eng->sinceFull >= eng->gcFullMinAlloc;
+}
+
+// Gives the GC a chance to run before an allocation grows the heap.
+// Past the soft limit whole collections are run instead of steps, as
+// long as the last full cycle isn't too recent; and an allocation that
+// would take the heap past its hard limit fails if a collection, and
+// then the host, can't make room for it.
+static void paceGC( EngineFull* eng, size_t osz, size_t nsz ) {
+    if( nsz <= osz )
+        return;
+    
+    eng->sinceFull += nsz - osz;
+    size_t need = eng->memUsed - osz + nsz;
+    if( need > eng->memHardLimit ) {
+        collect( eng, nsz, true );
+        if( eng->memUsed - osz + nsz <= eng->memHardLimit )
+            return;
+        
+        if( eng->onPressure && !eng->inPressure ) {
+            notifyPressure( eng, taz_Pressure_HARD );
+            collect( eng, nsz, true );
+        }
+        if( eng->memUsed - osz + nsz > eng->memHardLimit )
+            tazE_error( (tazE_Engine*)eng, taz_ErrNum_HEAP_LIMIT );
+        return;
+    }
+    
+    if( need > eng->memLimit && need > eng->memSoftLimit && isFullDue( eng ) ) {
+        collect( eng, nsz, true );
+        if( eng->memUsed - osz + nsz > eng->memSoftLimit )
+            notifyPressure( eng, taz_Pressure_SOFT );
+    }
+    else
+    if( eng->gcPhase == GCPhase_MARK || need > eng->memLimit )
+        stepGC( eng, nsz );
+}
+
+static void* reallocMem( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
+    assert( !eng->isGCRunning || nsz == 0 );
+    if( osz == nsz )
+        return old;
+    
+    if( isRawCell( eng, osz ) || isRawCell( eng, nsz ) )
+        return reallocCell( eng, old, osz, nsz );
+    
+    #if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+        if( eng->isGCRunning && eng->freeThread && freeLater( eng, old, osz ) ) {
+            eng->memUsed -= memSize( eng, osz );
+            return NULL;
+        }
+    #endif
+    
+    paceGC( eng, memSize( eng, osz ), memSize( eng, nsz ) );
+    
+    void* mem;
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        if( isLarge( eng, osz ) || isLarge( eng, nsz ) )
+            mem = allocLarge( eng, old, osz, nsz );
+        else
+    #endif
+            mem = sysAlloc( eng, old, osz, nsz );
+    if( !mem && nsz > 0 ) {
+        collect( eng, nsz, true );
+        #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+            if( isLarge( eng, osz ) || isLarge( eng, nsz ) )
+                mem = allocLarge( eng, old, osz, nsz );
+            else
+        #endif
+                mem = sysAlloc( eng, old, osz, nsz );
+        if( !mem )
+            tazE_error( (tazE_Engine*)eng, taz_ErrNum_MEMORY );
+    }
+    
+    eng->memUsed -= memSize( eng, osz );
+    eng->memUsed += memSize( eng, nsz );
+    return mem;
+}
+
+static void* mallocMem( EngineFull* eng, size_t nsz ) {
+    return reallocMem( eng, NULL, 0, nsz );
+}
+
+static void  freeMem( EngineFull* eng, void* old, size_t osz ) {
+    reallocMem( eng, old, osz, 0 );
+}
+
+// Some of the GC's own bookkeeping buffers need to grow at points
+// where a collection can't be allowed to happen, so these bypass
+// `reallocMem()` and report failure instead of raising an error.
+static bool growSideBuf( EngineFull* eng, void** buf, unsigned* cap, size_t elem ) {
+    unsigned ncap = *cap > 0 ? *cap*2 : 32;
+    void*    nbuf = sysAlloc( eng, *buf, elem*(*cap), elem*ncap );
+    if( !nbuf )
+        return false;
+    
+    eng->memUsed += elem*(ncap - *cap);
+    *buf = nbuf;
+    *cap = ncap;
+    return true;
+}
+
+static void freeSideBuf( EngineFull* eng, void* buf, unsigned cap, size_t elem ) {
+    if( !buf )
+        return;
+    
+    sysAlloc( eng, buf, elem*cap, 0 );
+    eng->memUsed -= elem*cap;
+}
+
+/******************************* Mark Stack ***********************************/
+
+#if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+    static __thread MarkWorker* currWorker = NULL;
+#endif
+
+// Marking threads each have their own stack, but they share the
+// allocator callback; which needn't be thread safe.
+static void lockMarkAlloc( EngineFull* eng ) {
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        if( currWorker ) {
+            while( __atomic_test_and_set( &eng->gcMarkAllocLock, __ATOMIC_ACQUIRE ) )
+                sched_yield();
+        }
+    #endif
+}
+
+static void unlockMarkAlloc( EngineFull* eng ) {
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        if( currWorker )
+            __atomic_clear( &eng->gcMarkAllocLock, __ATOMIC_RELEASE );
+    #endif
+}
+
+// Segments are allocated directly, since a collection can't be allowed
+// to start while we're marking.
+static MarkSeg* allocMarkSeg( EngineFull* eng ) {
+    lockMarkAlloc( eng );
+    MarkSeg* seg = sysAlloc( eng, NULL, 0, sizeof(MarkSeg) );
+    if( seg )
+        eng->memUsed += sizeof(MarkSeg);
+    unlockMarkAlloc( eng );
+    
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        if( currWorker )
+            return seg;
+    #endif
+    if( !seg && !eng->gcReserveUsed ) {
+        eng->gcReserveUsed = true;
+        seg = &eng->gcReserveSeg;
+    }
+    return seg;
+}
+
+static void freeMarkSeg( EngineFull* eng, MarkSeg* seg ) {
+    if( seg == &eng->gcReserveSeg ) {
+        eng->gcReserveUsed = false;
+        return;
+    }
+    
+    lockMarkAlloc( eng );
+    sysAlloc( eng, seg, sizeof(MarkSeg), 0 );
+    eng->memUsed -= sizeof(MarkSeg);
+    unlockMarkAlloc( eng );
+}
+
+// Returns false if the stack needed another segment and we couldn't
+// get one.
+static bool pushGray( EngineFull* eng, MarkStack* stack, tazR_Obj* obj ) {
+    MarkSeg* seg = stack->seg;
+    if( !seg || seg->top == taz_CONFIG_GC_STACK_SEGMENT_SIZE ) {
+        MarkSeg* nseg = stack->spare;
+        stack->spare = NULL;
+        if( !nseg )
+            nseg = allocMarkSeg( eng );
+        if( !nseg )
+            return false;
+        
+        nseg->prev = seg;
+        nseg->top  = 0;
+        stack->seg = seg = nseg;
+    }
+    seg->objs[seg->top++] = obj;
+    return true;
+}
+
+static tazR_Obj* popGray( EngineFull* eng, MarkStack* stack ) {
+    MarkSeg* seg = stack->seg;
+    if( !seg )
+        return NULL;
+    
+    tazR_Obj* obj = seg->objs[--seg->top];
+    if( seg->top == 0 ) {
+        stack->seg = seg->prev;
+        if( stack->spare )
+            freeMarkSeg( eng, seg );
+        else
+            stack->spare = seg;
+    }
+    return obj;
+}
+
+static void freeMarkStack( EngineFull* eng, MarkStack* stack ) {
+    while( stack->seg ) {
+        MarkSeg* seg = stack->seg;
+        stack->seg = seg->prev;
+        freeMarkSeg( eng, seg );
+    }
+    if( stack->spare )
+        freeMarkSeg( eng, stack->spare );
+    stack->spare = NULL;
+}
+
+/******************************* Object Heap **********************************/
+
+// Objects up to 256 bytes are allocated from pages of fixed size cells,
+// each page being dedicated to a single size class.  Pages are carved
+// out of larger chunks obtained from the allocator callback, aligned to
+// their own size so an object's page can be found by masking its
+// address.  Larger objects just go through the callback.
+struct HeapCell {
+    HeapCell* next;
+};
+
+struct HeapPage {
+    HeapPage*  next;
+    HeapPage** link;
+    HeapChunk* chunk;
+    HeapCell*  free;
+    char*      bump;
+    unsigned   cls;
+    unsigned   nused;
+    bool       raw;
+    bool       evac;
+};
+
+struct HeapChunk {
+    HeapChunk*  next;
+    HeapChunk** link;
+    void*       raw;
+    unsigned    npages;
+    unsigned    nbusy;
+    ulongest    marks[];
+};
+
+#if (taz_CONFIG_HEAP_PAGE_SIZE & (taz_CONFIG_HEAP_PAGE_SIZE - 1)) != 0
+    #error "taz_CONFIG_HEAP_PAGE_SIZE must be a power of two"
+#endif
+
+#define PAGE_CELLS_OFFSET ((sizeof(HeapPage) + 15) & ~(size_t)15)
+#define MAX_CLASS_SIZE    (256)
+#define NO_CLASS          (NUM_SIZE_CLASSES)
+
+// Cells are at least this big, so each gets its own mark bit.
+#define MARK_GRANULE (16)
+#define MARK_WORDS   ((taz_CONFIG_HEAP_CHUNK_SIZE/MARK_GRANULE + 63)/64)
+#define CHUNK_HEADER_SIZE (sizeof(HeapChunk) + sizeof(ulongest)*MARK_WORDS)
+
+static unsigned const classSizeTable[NUM_SIZE_CLASSES] = {
+    16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256
+};
+
+// Indexed by size in 8 byte units, rounded up.
+static uchar const sizeClassTable[MAX_CLASS_SIZE/8 + 1] = {
+    0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+    11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14
+};
+
+static unsigned sizeClassOf( size_t sz ) {
+    if( sz > MAX_CLASS_SIZE )
+        return NO_CLASS;
+    return sizeClassTable[(sz + 7)/8];
+}
+
+static HeapPage* pageOf( void* cell ) {
+    return (HeapPage*)((uintptr_t)cell & ~(uintptr_t)(taz_CONFIG_HEAP_PAGE_SIZE - 1));
+}
+
+static bool addChunk( EngineFull* eng ) {
+    HeapChunk* chunk = sysAlloc( eng, NULL, 0, CHUNK_HEADER_SIZE );
+    if( !chunk )
+        return false;
+    
+    chunk->raw = sysAlloc( eng, NULL, 0, taz_CONFIG_HEAP_CHUNK_SIZE );
+    if( !chunk->raw ) {
+        sysAlloc( eng, chunk, CHUNK_HEADER_SIZE, 0 );
+        return false;
+    }
+    memset( chunk->marks, 0, sizeof(ulongest)*MARK_WORDS );
+    
+    // The callback doesn't give us any alignment guarantees beyond
+    // those of malloc(), so we lose part of a page at either end.
+    uintptr_t mask  = taz_CONFIG_HEAP_PAGE_SIZE - 1;
+    uintptr_t start = ((uintptr_t)chunk->raw + mask) & ~mask;
+    uintptr_t end   = (uintptr_t)chunk->raw + taz_CONFIG_HEAP_CHUNK_SIZE;
+    chunk->npages = (end - start)/taz_CONFIG_HEAP_PAGE_SIZE;
+    chunk->nbusy  = 0;
+    
+    for( unsigned i = 0 ; i < chunk->npages ; i++ ) {
+        HeapPage* page = (HeapPage*)(start + i*taz_CONFIG_HEAP_PAGE_SIZE);
+        page->chunk = chunk;
+        page->cls   = NO_CLASS;
+        page->raw   = false;
+        page->evac  = false;
+        tazR_linkWithNextAndLink( &eng->heapEmpty, page );
+    }
+    tazR_linkWithNextAndLink( &eng->heapChunks, chunk );
+    return true;
+}
+
+static void freeChunk( EngineFull* eng, HeapChunk* chunk ) {
+    uintptr_t mask  = taz_CONFIG_HEAP_PAGE_SIZE - 1;
+    uintptr_t start = ((uintptr_t)chunk->raw + mask) & ~mask;
+    for( unsigned i = 0 ; i < chunk->npages ; i++ ) {
+        HeapPage* page = (HeapPage*)(start + i*taz_CONFIG_HEAP_PAGE_SIZE);
+        tazR_unlinkWithNextAndLink( page );
+    }
+    tazR_unlinkWithNextAndLink( chunk );
+    
+    sysAlloc( eng, chunk->raw, taz_CONFIG_HEAP_CHUNK_SIZE, 0 );
+    sysAlloc( eng, chunk, CHUNK_HEADER_SIZE, 0 );
+}
+
+static HeapPage** availOf( EngineFull* eng, unsigned cls, bool raw ) {
+    return raw ? &eng->rawAvail[cls] : &eng->heapAvail[cls];
+}
+
+static void* cutCell( HeapPage* page ) {
+    size_t csz = classSizeTable[page->cls];
+    void*  cell;
+    if( page->free ) {
+        cell = page->free;
+        page->free = page->free->next;
+    }
+    else {
+        cell = page->bump;
+        page->bump += csz;
+    }
+    page->nused++;
+    
+    // Full pages are kept out of the list until a cell is freed.
+    char* end = (char*)page + taz_CONFIG_HEAP_PAGE_SIZE;
+    if( !page->free && page->bump + csz > end ) {
+        tazR_unlinkWithNextAndLink( page );
+        page->link = NULL;
+    }
+    return cell;
+}
+
+static void* takeCell( EngineFull* eng, unsigned cls, bool raw ) {
+    HeapPage* page = *availOf( eng, cls, raw );
+    if( !page ) {
+        if( !eng->heapEmpty && !addChunk( eng ) )
+            return NULL;
+        
+        page = eng->heapEmpty;
+        tazR_unlinkWithNextAndLink( page );
+        page->cls   = cls;
+        page->free  = NULL;
+        page->bump  = (char*)page + PAGE_CELLS_OFFSET;
+        page->nused = 0;
+        page->raw   = raw;
+        page->evac  = false;
+        page->chunk->nbusy++;
+        tazR_linkWithNextAndLink( availOf( eng, cls, raw ), page );
+    }
+    return cutCell( page );
+}
+
+// Only takes a cell from a page that's already in use, or NULL if
+// none has one free.
+static void* takeUsedCell( EngineFull* eng, unsigned cls, bool raw ) {
+    HeapPage* page = *availOf( eng, cls, raw );
+    return page ? cutCell( page ) : NULL;
+}
+
+// Gives the memory of an empty page back to the system, all but the
+// OS page its header is on, which has to stay valid while it's in the
+// empty list.  The rest reads as zeros when it's next touched.  The
+// chunk came from the allocator callback, so this relies on it giving
+// out private anonymous memory; see `taz_Config.gcCompact`.
+static void releasePage( EngineFull* eng, HeapPage* page ) {
+    #if taz_CONFIG_ENABLE_PAGE_RELEASE
+        uintptr_t mask  = eng->osPageSize - 1;
+        uintptr_t start = ((uintptr_t)page + PAGE_CELLS_OFFSET + mask) & ~mask;
+        uintptr_t end   = ((uintptr_t)page + taz_CONFIG_HEAP_PAGE_SIZE) & ~mask;
+        if( start < end && madvise( (void*)start, end - start, MADV_DONTNEED ) == 0 )
+            eng->stats.pagesReleased++;
+    #endif
+}
+
+static void giveCell( EngineFull* eng, void* cell ) {
+    HeapPage* page = pageOf( cell );
+    
+    HeapCell* hc = cell;
+    hc->next   = page->free;
+    page->free = hc;
+    page->nused--;
+    
+    // Pages being evacuated by compaction are left out of the lists, so
+    // nothing new is put in them; see `compactRaw()`.
+    if( page->nused > 0 ) {
+        if( !page->link && !page->evac )
+            tazR_linkWithNextAndLink( availOf( eng, page->cls, page->raw ), page );
+        return;
+    }
+    
+    // Empty pages go back to the shared pool, and whole chunks back
+    // to the callback; though we keep the last chunk around so an
+    // engine that's idling near empty doesn't keep reallocating it.
+    // Arena engines keep all of theirs, since freeing one gives nothing
+    // back to the arena.
+    // Pages emptied by compaction are given back to the system if their
+    // chunk is staying.
+    if( page->link )
+        tazR_unlinkWithNextAndLink( page );
+    bool evac = page->evac;
+    page->cls  = NO_CLASS;
+    page->evac = false;
+    tazR_linkWithNextAndLink( &eng->heapEmpty, page );
+    
+    HeapChunk* chunk = page->chunk;
+    if( --chunk->nbusy == 0 && (eng->heapChunks != chunk || chunk->next) && !eng->arena )
+        freeChunk( eng, chunk );
+    else
+    if( evac )
+        releasePage( eng, page );
+}
+
+// The mark bits of paged objects are kept in their chunk's header, which
+// is allocated apart from the chunk itself.  So marking doesn't write to
+// object memory, and pages shared with a forked process stay shared.
+// The headers of live objects are still written in a few places: those
+// too big for the pages keep their mark bit there, a survivor's link is
+// rewritten when the object after it is unlinked, and promotion, the
+// remembered set and the sampler all set tag bits.
+static ulongest* markWordOf( tazR_Obj* obj, ulongest* bit ) {
+    HeapChunk* chunk = pageOf( obj )->chunk;
+    size_t     i     = ((char*)obj - (char*)chunk->raw)/MARK_GRANULE;
+    *bit = 1LLU << i%64;
+    return &chunk->marks[i/64];
+}
+
+static bool isObjMarked( tazR_Obj* obj ) {
+    if( !tazR_isObjPaged( obj ) )
+        return tazR_getPtrTag( obj->next_and_tag ) & tazR_OBJ_TAG_MARK_MASK;
+    
+    ulongest  bit;
+    ulongest* word = markWordOf( obj, &bit );
+    return *word & bit;
+}
+
+// Marks the object, returns true if it was already marked.  Nothing is
+// written if it was, since the objects of a frozen engine are marked
+// for good and may be read by other threads at the same time.
+static bool setObjMark( tazR_Obj* obj ) {
+    if( !tazR_isObjPaged( obj ) ) {
+        unsigned tag = tazR_getPtrTag( obj->next_and_tag );
+        if( tag & tazR_OBJ_TAG_MARK_MASK )
+            return true;
+        obj->next_and_tag = tazR_makeTPtr(
+            tag | tazR_OBJ_TAG_MARK_MASK,
+            tazR_getPtrAddr( obj->next_and_tag )
+        );
+        return false;
+    }
+    
+    ulongest  bit;
+    ulongest* word = markWordOf( obj, &bit );
+    if( *word & bit )
+        return true;
+    *word |= bit;
+    return false;
+}
+
+static void clearObjMark( tazR_Obj* obj ) {
+    if( !tazR_isObjPaged( obj ) ) {
+        obj->next_and_tag = tazR_makeTPtr(
+            tazR_getPtrTag( obj->next_and_tag ) & ~tazR_OBJ_TAG_MARK_MASK,
+            tazR_getPtrAddr( obj->next_and_tag )
+        );
+        return;
+    }
+    
+    ulongest  bit;
+    ulongest* word = markWordOf( obj, &bit );
+    *word &= ~bit;
+}
+
+static void* mallocCell( EngineFull* eng, unsigned cls, bool raw ) {
+    assert( !eng->isGCRunning );
+    size_t csz = classSizeTable[cls];
+    paceGC( eng, 0, csz );
+    
+    void* cell = takeCell( eng, cls, raw );
+    if( !cell ) {
+        collect( eng, csz, true );
+        cell = takeCell( eng, cls, raw );
+        if( !cell )
+            tazE_error( (tazE_Engine*)eng, taz_ErrNum_MEMORY );
+    }
+    
+    eng->memUsed += csz;
+    return cell;
+}
+
+static void* mallocObjMem( EngineFull* eng, size_t sz ) {
+    unsigned cls = sizeClassOf( sz );
+    if( cls == NO_CLASS )
+        return mallocMem( eng, sz );
+    return mallocCell( eng, cls, false );
+}
+
+static void freeObjMem( EngineFull* eng, void* obj, size_t sz ) {
+    unsigned cls = sizeClassOf( sz );
+    if( cls == NO_CLASS ) {
+        freeMem( eng, obj, sz );
+        return;
+    }
+    
+    assert( pageOf( obj )->cls == cls );
+    giveCell( eng, obj );
+    eng->memUsed -= classSizeTable[cls];
+}
+
+static void freeHeap( EngineFull* eng ) {
+    while( eng->heapChunks )
+        freeChunk( eng, eng->heapChunks );
+}
+
+#ifndef tazR_finlIdx
+    #define tazR_finlIdx( ENG, OBJ )
+#endif
+#ifndef tazR_finlRec
+    #define tazR_finlRec( ENG, OBJ )
+#endif
+#ifndef tazR_finlCode
+    #define tazR_finlCode( ENG, OBJ )
+#endif
+#ifndef tazR_finlFun
+    #define tazR_finlFun( ENG, OBJ )
+#endif
+#ifndef tazR_finlFib
+    #define tazR_finlFib( ENG, OBJ )
+#endif
+#ifndef tazR_finlUpv
+    #define tazR_finlUpv( ENG, OBJ )
+#endif
+
+static void destructObj( EngineFull* eng, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_IDX:
+            tazR_finlIdx( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_REC:
+            tazR_finlRec( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_CODE:
+            tazR_finlCode( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_FUN:
+            tazR_finlFun( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_FIB:
+            tazR_finlFib( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_UPV:
+            tazR_finlUpv( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_STATE:
+            if( ((tazR_State*)data)->finl )
+                ((tazR_State*)data)->finl( (tazE_Engine*)eng, data );
+        break;
+        default:
+            assert( false );
+        break;
+    }
+}
+
+
+#ifndef tazR_sizeofIdx
+    #define tazR_sizeofIdx( ENG, OBJ ) 1
+#endif
+#ifndef tazR_sizeofRec
+    #define tazR_sizeofRec( ENG, OBJ ) 1
+#endif
+#ifndef tazR_sizeofCode
+    #define tazR_sizeofCode( ENG, OBJ ) 1
+#endif
+#ifndef tazR_sizeofFun
+    #define tazR_sizeofFun( ENG, OBJ ) 1
+#endif
+#ifndef tazR_sizeofFib
+    #define tazR_sizeofFib( ENG, OBJ ) 1
+#endif
+#ifndef tazR_sizeofUpv
+    #define tazR_sizeofUpv( ENG, OBJ ) 1
+#endif
+
+#ifndef tazR_ownedIdx
+    #define tazR_ownedIdx( ENG, OBJ ) 0
+#endif
+#ifndef tazR_ownedRec
+    #define tazR_ownedRec( ENG, OBJ ) 0
+#endif
+#ifndef tazR_ownedCode
+    #define tazR_ownedCode( ENG, OBJ ) 0
+#endif
+#ifndef tazR_ownedFun
+    #define tazR_ownedFun( ENG, OBJ ) 0
+#endif
+#ifndef tazR_ownedFib
+    #define tazR_ownedFib( ENG, OBJ ) 0
+#endif
+#ifndef tazR_ownedUpv
+    #define tazR_ownedUpv( ENG, OBJ ) 0
+#endif
+
+static size_t sizeofObj( EngineFull* eng, tazR_Obj* obj ) {
+    size_t size = sizeof(tazR_Obj);
+    void*  data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_IDX:
+            size += tazR_sizeofIdx( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_REC:
+            size += tazR_sizeofRec( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_CODE:
+            size += tazR_sizeofCode( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_FUN:
+            size += tazR_sizeofFun( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_FIB:
+            size += tazR_sizeofFib( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_UPV:
+            size += tazR_sizeofUpv( (tazE_Engine*)eng, data );
+        break;
+        case tazR_Type_STATE:
+            if( ((tazR_State*)data)->size )
+                size += ((tazR_State*)data)->size( (tazE_Engine*)eng, data );
+        break;
+        default:
+            assert( false );
+        break;
+    }
+    return size;
+}
+
+// The raw memory an object owns apart from its own allocation.
+static size_t ownedByObj( EngineFull* eng, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_IDX:
+            return tazR_ownedIdx( (tazE_Engine*)eng, data );
+        case tazR_Type_REC:
+            return tazR_ownedRec( (tazE_Engine*)eng, data );
+        case tazR_Type_CODE:
+            return tazR_ownedCode( (tazE_Engine*)eng, data );
+        case tazR_Type_FUN:
+            return tazR_ownedFun( (tazE_Engine*)eng, data );
+        case tazR_Type_FIB:
+            return tazR_ownedFib( (tazE_Engine*)eng, data );
+        case tazR_Type_UPV:
+            return tazR_ownedUpv( (tazE_Engine*)eng, data );
+        case tazR_Type_STATE:
+            if( ((tazR_State*)data)->owned )
+                return ((tazR_State*)data)->owned( (tazE_Engine*)eng, data );
+            return 0;
+        default:
+            assert( false );
+            return 0;
+    }
+}
+
+// The memory actually taken up by an object of the given size, which
+// is that of its size class if it's kept in the pages.
+static size_t footprintOf( EngineFull* eng, size_t sz ) {
+    unsigned cls = sizeClassOf( sz );
+    return cls == NO_CLASS ? memSize( eng, sz ) : classSizeTable[cls];
+}
+
+static void dropSample( EngineFull* eng, tazR_Obj* obj );
+static void updateLiveSamples( EngineFull* eng );
+
+static void releaseObj( EngineFull* eng, tazR_Obj* obj ) {
+    if( tazR_isObjSampled( obj ) )
+        dropSample( eng, obj );
+    
+    size_t    sz   = sizeofObj( eng, obj );
+    tazR_Type type = tazR_getObjType( obj );
+    eng->stats.liveObjects[type]--;
+    eng->stats.liveBytes[type] -= footprintOf( eng, sz );
+    freeObjMem( eng, obj, sz );
+}
+
+
+
+#ifndef tazR_scanIdx
+    #define tazR_scanIdx( ENG, OBJ, FULL )
+#endif
+#ifndef tazR_scanRec
+    #define tazR_scanRec( ENG, OBJ, FULL )
+#endif
+#ifndef tazR_scanCode
+    #define tazR_scanCode( ENG, OBJ, FULL )
+#endif
+#ifndef tazR_scanFun
+    #define tazR_scanFun( ENG, OBJ, FULL )
+#endif
+#ifndef tazR_scanFib
+    #define tazR_scanFib( ENG, OBJ, FULL )
+#endif
+#ifndef tazR_scanUpv
+    #define tazR_scanUpv( ENG, OBJ, FULL )
+#endif
+
+static void scanObj( EngineFull* eng, tazR_Obj* obj, bool full ) {
+    void*  data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_IDX:
+            tazR_scanIdx( (tazE_Engine*)eng, data, full );
+        break;
+        case tazR_Type_REC:
+            tazR_scanRec( (tazE_Engine*)eng, data, full );
+        break;
+        case tazR_Type_CODE:
+            tazR_scanCode( (tazE_Engine*)eng, data, full );
+        break;
+        case tazR_Type_FUN:
+            tazR_scanFun( (tazE_Engine*)eng, data, full );
+        break;
+        case tazR_Type_FIB:
+            tazR_scanFib( (tazE_Engine*)eng, data, full );
+        break;
+        case tazR_Type_UPV:
+            tazR_scanUpv( (tazE_Engine*)eng, data, full );
+        break;
+        case tazR_Type_STATE:
+            if( ((tazR_State*)data)->scan )
+                ((tazR_State*)data)->scan( (tazE_Engine*)eng, data, full );
+        break;
+        default:
+            assert( false );
+        break;
+    }
+}
+
+
+#ifndef tazR_traceRec
+    #define tazR_traceRec( ENG, OBJ ) false
+#endif
+#ifndef tazR_clearRec
+    #define tazR_clearRec( ENG, OBJ )
+#endif
+
+// Only records can hold weak references for now.
+static bool traceObj( EngineFull* eng, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_REC:
+            return tazR_traceRec( (tazE_Engine*)eng, data );
+        default:
+            assert( false );
+            return false;
+    }
+}
+
+static void clearObj( EngineFull* eng, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_REC:
+            tazR_clearRec( (tazE_Engine*)eng, data );
+        break;
+        default:
+            assert( false );
+        break;
+    }
+}
+
+static void clearBarrier( EngineFull* eng, tazE_Barrier* bar ) {
+    rewindScratch( eng, bar->scratchChunk, bar->scratchBump );
+    
+    tazE_ObjAnchor* oIt = bar->objAnchors;
+    while( oIt ) {
+        tazE_ObjAnchor* anc = oIt;
+        oIt = oIt->next;
+        
+        tazE_cancelObj( (tazE_Engine*)eng, anc );
+    }
+    
+    tazE_RawAnchor* rIt = bar->rawAnchors;
+    while( rIt ) {
+        tazE_RawAnchor* anc = rIt;
+        rIt = rIt->next;
+        
+        tazE_cancelRaw( (tazE_Engine*)eng, anc );
+    }
+    
+    bar->buckets = NULL;
+}
+
+static struct {
+    tazE_Bucket base;
+    tazR_TVal   val1;
+    tazR_TVal   val2;
+} const DMY_BUCKET;
+static size_t const FIRST_BUCKET_OFFSET = (void*)&DMY_BUCKET.val1 - (void*)&DMY_BUCKET;
+static size_t const NEXT_BUCKET_OFFSET  = (void*)&DMY_BUCKET.val2 - (void*)&DMY_BUCKET.val1;
+
+// Sets the heap size that the next cycle runs at, in proportion to what
+// survived the last one; but holding it at the soft limit until that's
+// been passed, so the collection run there can try to keep under it.
+// Until the old generation has been swept `memUsed` still counts its
+// dead objects, so this is done again once the sweep is finished.
+static void adjustHeap( EngineFull* eng, size_t nsz ) {
+    assert( eng->memGrowth > 0.0 );
+    size_t used  = eng->memUsed + nsz;
+    size_t limit = (double)used * (1.0 + eng->memGrowth);
+    if( limit < eng->memTarget )
+        limit = eng->memTarget;
+    if( limit > eng->memSoftLimit && used <= eng->memSoftLimit )
+        limit = eng->memSoftLimit;
+    eng->memLimit = limit;
+}
+
+static bool startStringGC( tazE_Engine* eng );
+static void finishStringGC( tazE_Engine* eng, bool sweep );
+
+// State and fiber objects are mutated without write barriers, so once
+// promoted they stay in the remembered set until they die.
+static bool isSticky( tazR_Obj* obj ) {
+    tazR_Type type = tazR_getObjType( obj );
+    return type == tazR_Type_STATE || type == tazR_Type_FIB;
+}
+
+static bool remember( EngineFull* eng, tazR_Obj* obj ) {
+    if( eng->remSetTop >= eng->remSetCap ) {
+        void* buf = eng->remSetBuf;
+        if( !growSideBuf( eng, &buf, &eng->remSetCap, sizeof(tazR_Obj*) ) )
+            return false;
+        eng->remSetBuf = buf;
+    }
+    
+    obj->next_and_tag = tazR_makeTPtr(
+        tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_REM_MASK,
+        tazR_getPtrAddr( obj->next_and_tag )
+    );
+    eng->remSetBuf[eng->remSetTop++] = obj;
+    return true;
+}
+
+static void forget( EngineFull* eng, tazR_Obj* obj ) {
+    obj->next_and_tag = tazR_makeTPtr(
+        tazR_getPtrTag( obj->next_and_tag ) & ~tazR_OBJ_TAG_REM_MASK,
+        tazR_getPtrAddr( obj->next_and_tag )
+    );
+}
+
+// Once marking is done every young survivor will be promoted, so old
+// objects can't reference young ones anymore; thus only the sticky
+// entries need to be kept, and only if they survived the cycle.
+static void filterRemSet( EngineFull* eng ) {
+    unsigned top = 0;
+    for( unsigned i = 0 ; i < eng->remSetTop ; i++ ) {
+        tazR_Obj* obj = eng->remSetBuf[i];
+        if( isSticky( obj ) ) {
+            if( !eng->isFullCycle || isObjMarked( obj ) )
+                eng->remSetBuf[top++] = obj;
+        }
+        else {
+            forget( eng, obj );
+        }
+    }
+    eng->remSetTop      = top;
+    eng->remSetOverflow = false;
+}
+
+// With `gcDeferFinalizers` set dead state objects with finalizers are
+// queued instead of being destructed, see `tazE_runFinalizers()`.
+static bool deferFinl( EngineFull* eng, tazR_Obj* obj ) {
+    if( !eng->deferFinl || tazR_getObjType( obj ) != tazR_Type_STATE )
+        return false;
+    if( !((tazR_State*)tazR_getObjData( obj ))->finl )
+        return false;
+    
+    if( tazR_isObjSampled( obj ) )
+        dropSample( eng, obj );
+    obj->next_and_tag = tazR_makeTPtr(
+        tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_DEAD_MASK,
+        eng->finlQueue
+    );
+    eng->finlQueue = obj;
+    eng->finlPending++;
+    return true;
+}
+
+static void sweepObj( EngineFull* eng, tazR_Obj* obj, tazR_Obj** dead ) {
+    if( !isObjMarked( obj ) ) {
+        if( deferFinl( eng, obj ) )
+            return;
+        
+        destructObj( eng, obj );
+        obj->next_and_tag = tazR_makeTPtr(
+            tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_DEAD_MASK,
+            *dead
+        );
+        *dead = obj;
+        return;
+    }
+    
+    clearObjMark( obj );
+    unsigned tag = tazR_getPtrTag( obj->next_and_tag );
+    if( eng->isFullCycle )
+        eng->ownedTally[tazR_getObjType( obj )] += ownedByObj( eng, obj );
+    
+    // Survivors are promoted, unless they're sticky and we can't fit
+    // them in the remembered set; in which case they can stay in the
+    // nursery, where they'll be traced like any other young object.
+    if( !(tag & tazR_OBJ_TAG_OLD_MASK) ) {
+        obj->next_and_tag = tazR_makeTPtr( tag, NULL );
+        if( isSticky( obj ) && !remember( eng, obj ) ) {
+            obj->next_and_tag = tazR_makeTPtr( tag, eng->nursery );
+            eng->nursery = obj;
+            return;
+        }
+        tag = tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_OLD_MASK;
+        
+        if( !eng->isFullCycle )
+            eng->oldGrowth += footprintOf( eng, sizeofObj( eng, obj ) ) + ownedByObj( eng, obj );
+    }
+    
+    obj->next_and_tag = tazR_makeTPtr( tag, eng->objects );
+    eng->objects = obj;
+}
+
+static void sweepList( EngineFull* eng, tazR_Obj* list, tazR_Obj** dead ) {
+    tazR_Obj* it = list;
+    while( it ) {
+        tazR_Obj* obj = it;
+        it = tazR_getPtrAddr( it->next_and_tag );
+        
+        sweepObj( eng, obj, dead );
+    }
+}
+
+// Called once a full cycle's sweep is done, when the tally is complete.
+static void finishTally( EngineFull* eng ) {
+    eng->oldSize   = 0;
+    eng->oldGrowth = 0;
+    for( unsigned i = 0 ; i <= tazR_Type_LAST_OBJECT ; i++ ) {
+        eng->stats.ownedBytes[i] = eng->ownedTally[i];
+        eng->oldSize += eng->stats.liveBytes[i] + eng->stats.ownedBytes[i];
+    }
+    if( eng->rawPages )
+        eng->compactDue = true;
+}
+
+static void releaseList( EngineFull* eng, tazR_Obj* dead ) {
+    tazR_Obj* it = dead;
+    while( it ) {
+        tazR_Obj* obj = it;
+        it = tazR_getPtrAddr( it->next_and_tag );
+        
+        releaseObj( eng, obj );
+    }
+}
+
+// Sweeps up to `budget` objects left over from the last full cycle,
+// or all of them if the budget is zero.  The old generation is swept
+// in place, so the only live objects written to are those followed
+// by dead ones, which need to be unlinked.
+static void sweepSome( EngineFull* eng, unsigned budget ) {
+    bool running = eng->isGCRunning;
+    eng->isGCRunning = true;
+    
+    size_t    used = eng->memUsed;
+    tazR_Obj* dead = NULL;
+    unsigned  n    = 0;
+    while( eng->sweepNext && (budget == 0 || n++ < budget) ) {
+        tazR_Obj* obj  = eng->sweepNext;
+        tazR_Obj* next = tazR_getObjNext( obj );
+        eng->sweepNext = next;
+        
+        if( isObjMarked( obj ) ) {
+            clearObjMark( obj );
+            eng->ownedTally[tazR_getObjType( obj )] += ownedByObj( eng, obj );
+            eng->sweepPrev = obj;
+            continue;
+        }
+        
+        tazR_Obj* prev = eng->sweepPrev;
+        if( prev )
+            prev->next_and_tag = tazR_makeTPtr( tazR_getPtrTag( prev->next_and_tag ), next );
+        else
+            eng->objects = next;
+        
+        if( deferFinl( eng, obj ) )
+            continue;
+        
+        destructObj( eng, obj );
+        obj->next_and_tag = tazR_makeTPtr(
+            tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_DEAD_MASK,
+            dead
+        );
+        dead = obj;
+    }
+    releaseList( eng, dead );
+    flushFrees( eng );
+    eng->stats.bytesFreed += used - eng->memUsed;
+    
+    if( !eng->sweepNext && eng->gcPhase == GCPhase_SWEEP ) {
+        eng->gcPhase = GCPhase_IDLE;
+        adjustHeap( eng, 0 );
+        finishTally( eng );
+    }
+    eng->isGCRunning = running;
+}
+
+#if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+
+#if (taz_CONFIG_GC_MARK_DEQUE_SIZE & (taz_CONFIG_GC_MARK_DEQUE_SIZE - 1)) != 0
+    #error "taz_CONFIG_GC_MARK_DEQUE_SIZE must be a power of two"
+#endif
+
+// Each marking thread owns a Chase-Lev work stealing deque, the owner
+// pushes and pops at the bottom while other threads steal from the top.
+// The deques are fixed size, when one is full the overflow goes to its
+// owner's private mark stack; which is only taken from once the deque
+// is empty, so the children of those objects can be stolen in turn.
+struct MarkWorker {
+    EngineFull* eng;
+    pthread_t   thread;
+    bool        started;
+    
+    long      top;
+    long      bottom;
+    tazR_Obj* deque[taz_CONFIG_GC_MARK_DEQUE_SIZE];
+    
+    MarkStack stack;
+};
+
+#define DEQUE_MASK (taz_CONFIG_GC_MARK_DEQUE_SIZE - 1)
+
+// Only the tag bits are updated while marking in parallel, so that's
+// all we need to access atomically.
+#if taz_CONFIG_DISABLE_PTR_TAGGING
+    #define objTagWord( OBJ ) (&(OBJ)->next_and_tag.tag)
+#else
+    #define objTagWord( OBJ ) (&(OBJ)->next_and_tag)
+#endif
+
+static bool pushWork( MarkWorker* w, tazR_Obj* obj ) {
+    long b = __atomic_load_n( &w->bottom, __ATOMIC_RELAXED );
+    long t = __atomic_load_n( &w->top, __ATOMIC_ACQUIRE );
+    if( b - t >= taz_CONFIG_GC_MARK_DEQUE_SIZE )
+        return false;
+    
+    __atomic_store_n( &w->deque[b & DEQUE_MASK], obj, __ATOMIC_RELAXED );
+    __atomic_store_n( &w->bottom, b + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+static tazR_Obj* popWork( MarkWorker* w ) {
+    long b = __atomic_load_n( &w->bottom, __ATOMIC_RELAXED ) - 1;
+    __atomic_store_n( &w->bottom, b, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    long t = __atomic_load_n( &w->top, __ATOMIC_RELAXED );
+    
+    if( t > b ) {
+        __atomic_store_n( &w->bottom, b + 1, __ATOMIC_RELAXED );
+        return NULL;
+    }
+    
+    // If this is the last entry then we have to race the
+    // thieves for it.
+    tazR_Obj* obj = __atomic_load_n( &w->deque[b & DEQUE_MASK], __ATOMIC_RELAXED );
+    if( t == b ) {
+        if( !__atomic_compare_exchange_n( &w->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ) )
+            obj = NULL;
+        __atomic_store_n( &w->bottom, b + 1, __ATOMIC_RELAXED );
+    }
+    return obj;
+}
+
+static tazR_Obj* stealWork( MarkWorker* w ) {
+    long t = __atomic_load_n( &w->top, __ATOMIC_ACQUIRE );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    long b = __atomic_load_n( &w->bottom, __ATOMIC_ACQUIRE );
+    if( t >= b )
+        return NULL;
+    
+    tazR_Obj* obj = __atomic_load_n( &w->deque[t & DEQUE_MASK], __ATOMIC_RELAXED );
+    if( !__atomic_compare_exchange_n( &w->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ) )
+        return NULL;
+    return obj;
+}
+
+static void markShared( MarkWorker* w, tazR_Obj* obj ) {
+    EngineFull* eng = w->eng;
+    
+    unsigned tag = __atomic_load_n( objTagWord( obj ), __ATOMIC_RELAXED );
+    if( (tag & tazR_OBJ_TAG_OLD_MASK) && !eng->isFullCycle )
+        return;
+    
+    // Whichever thread sets the mark bit gets to scan the object.
+    if( tag & tazR_OBJ_TAG_PAGE_MASK ) {
+        ulongest  bit;
+        ulongest* word = markWordOf( obj, &bit );
+        if( __atomic_load_n( word, __ATOMIC_RELAXED ) & bit )
+            return;
+        if( __atomic_fetch_or( word, bit, __ATOMIC_RELAXED ) & bit )
+            return;
+    }
+    else {
+        if( tag & tazR_OBJ_TAG_MARK_MASK )
+            return;
+        tag = __atomic_fetch_or( objTagWord( obj ), tazR_OBJ_TAG_MARK_MASK, __ATOMIC_RELAXED );
+        if( tag & tazR_OBJ_TAG_MARK_MASK )
+            return;
+    }
+    
+    if( pushWork( w, obj ) || pushGray( eng, &w->stack, obj ) )
+        return;
+    __atomic_store_n( &eng->gcStackOverflow, true, __ATOMIC_RELAXED );
+}
+
+static tazR_Obj* findWork( MarkWorker* w ) {
+    EngineFull* eng = w->eng;
+    
+    tazR_Obj* obj = popWork( w );
+    if( !obj )
+        obj = popGray( eng, &w->stack );
+    if( obj )
+        return obj;
+    
+    unsigned    n   = eng->gcMarkThreads;
+    unsigned    off = w - eng->gcMarkWorkers;
+    for( unsigned i = 1 ; i < n && !obj ; i++ )
+        obj = stealWork( &eng->gcMarkWorkers[(off + i) % n] );
+    return obj;
+}
+
+static bool anyWork( EngineFull* eng ) {
+    for( unsigned i = 0 ; i < eng->gcMarkThreads ; i++ ) {
+        MarkWorker* w = &eng->gcMarkWorkers[i];
+        if( __atomic_load_n( &w->top, __ATOMIC_ACQUIRE ) < __atomic_load_n( &w->bottom, __ATOMIC_ACQUIRE ) )
+            return true;
+    }
+    return false;
+}
+
+// Marking is done once every thread is idle at the same time, since
+// an idle thread's deque is empty and only its owner can push to it.
+static void markInWorker( MarkWorker* w ) {
+    EngineFull* eng = w->eng;
+    currWorker = w;
+    
+    while( true ) {
+        tazR_Obj* obj = findWork( w );
+        if( obj ) {
+            scanObj( eng, obj, eng->isFullCycle );
+            continue;
+        }
+        
+        __atomic_add_fetch( &eng->gcMarkIdle, 1, __ATOMIC_SEQ_CST );
+        while( __atomic_load_n( &eng->gcMarkIdle, __ATOMIC_SEQ_CST ) < eng->gcMarkThreads ) {
+            if( anyWork( eng ) )
+                break;
+            sched_yield();
+        }
+        if( __atomic_load_n( &eng->gcMarkIdle, __ATOMIC_SEQ_CST ) == eng->gcMarkThreads )
+            break;
+        __atomic_sub_fetch( &eng->gcMarkIdle, 1, __ATOMIC_SEQ_CST );
+    }
+    
+    currWorker = NULL;
+}
+
+static void* markThreadMain( void* arg ) {
+    MarkWorker* w     = arg;
+    EngineFull* eng   = w->eng;
+    unsigned    round = 0;
+    
+    pthread_mutex_lock( &eng->gcMarkLock );
+    for( ;; ) {
+        while( eng->gcMarkRound == round && !eng->gcMarkStop )
+            pthread_cond_wait( &eng->gcMarkWake, &eng->gcMarkLock );
+        if( eng->gcMarkStop )
+            break;
+        round = eng->gcMarkRound;
+        
+        pthread_mutex_unlock( &eng->gcMarkLock );
+        markInWorker( w );
+        pthread_mutex_lock( &eng->gcMarkLock );
+        
+        if( --eng->gcMarkBusy == 0 )
+            pthread_cond_signal( &eng->gcMarkDone );
+    }
+    pthread_mutex_unlock( &eng->gcMarkLock );
+    return NULL;
+}
+
+// Allocates the workers and starts their threads.  A thread that fails
+// to start is counted as idle for good, its share of the work will be
+// stolen by the others.
+static bool makeMarkWorkers( EngineFull* eng ) {
+    unsigned n = eng->gcMarkThreads;
+    eng->gcMarkWorkers = sysAlloc( eng, NULL, 0, sizeof(MarkWorker)*n );
+    if( !eng->gcMarkWorkers )
+        return false;
+    eng->memUsed += sizeof(MarkWorker)*n;
+    
+    pthread_mutex_init( &eng->gcMarkLock, NULL );
+    pthread_cond_init( &eng->gcMarkWake, NULL );
+    pthread_cond_init( &eng->gcMarkDone, NULL );
+    eng->gcMarkRound = 0;
+    eng->gcMarkBusy  = 0;
+    eng->gcMarkStop  = false;
+    
+    for( unsigned i = 0 ; i < n ; i++ ) {
+        MarkWorker* w = &eng->gcMarkWorkers[i];
+        w->eng     = eng;
+        w->stack   = (MarkStack){ NULL, NULL };
+        w->started = i > 0 && !pthread_create( &w->thread, NULL, markThreadMain, w );
+    }
+    return true;
+}
+
+static void freeMarkWorkers( EngineFull* eng ) {
+    unsigned n = eng->gcMarkThreads;
+    if( !eng->gcMarkWorkers )
+        return;
+    
+    pthread_mutex_lock( &eng->gcMarkLock );
+    eng->gcMarkStop = true;
+    pthread_cond_broadcast( &eng->gcMarkWake );
+    pthread_mutex_unlock( &eng->gcMarkLock );
+    for( unsigned i = 1 ; i < n ; i++ ) {
+        if( eng->gcMarkWorkers[i].started )
+            pthread_join( eng->gcMarkWorkers[i].thread, NULL );
+    }
+    pthread_mutex_destroy( &eng->gcMarkLock );
+    pthread_cond_destroy( &eng->gcMarkWake );
+    pthread_cond_destroy( &eng->gcMarkDone );
+    
+    for( unsigned i = 0 ; i < n ; i++ )
+        freeMarkStack( eng, &eng->gcMarkWorkers[i].stack );
+    freeSideBuf( eng, eng->gcMarkWorkers, n, sizeof(MarkWorker) );
+}
+
+// Splits the gray stack across the worker deques and drains them with
+// `gcMarkThreads` threads, the calling thread being one of them.  This
+// is only done in full cycles, a minor cycle doesn't have enough to
+// mark to make up for waking the threads.  Returns false if parallel
+// marking isn't worthwhile or possible.
+static bool drainParallel( EngineFull* eng ) {
+    unsigned n = eng->gcMarkThreads;
+    if( n < 2 || !eng->gcStack.seg || !eng->isFullCycle )
+        return false;
+    #if taz_CONFIG_GC_PARALLEL_MARK_THRESHOLD > 0
+        if( eng->memUsed < taz_CONFIG_GC_PARALLEL_MARK_THRESHOLD )
+            return false;
+    #endif
+    
+    if( !eng->gcMarkWorkers && !makeMarkWorkers( eng ) )
+        return false;
+    
+    for( unsigned i = 0 ; i < n ; i++ ) {
+        MarkWorker* w = &eng->gcMarkWorkers[i];
+        w->top    = 0;
+        w->bottom = 0;
+    }
+    
+    // The other threads are parked, so it's fine to push to their
+    // deques.  Whatever doesn't fit stays on the engine's stack for
+    // the serial marker.
+    unsigned  i = 0;
+    tazR_Obj* obj;
+    while( (obj = popGray( eng, &eng->gcStack )) ) {
+        MarkWorker* w = &eng->gcMarkWorkers[i++ % n];
+        if( !pushWork( w, obj ) ) {
+            if( !pushGray( eng, &eng->gcStack, obj ) )
+                eng->gcStackOverflow = true;
+            break;
+        }
+    }
+    
+    // The deques can't be touched again until every thread is done
+    // with the round.
+    pthread_mutex_lock( &eng->gcMarkLock );
+    eng->gcMarkIdle = 0;
+    eng->gcMarkBusy = 0;
+    for( unsigned i = 1 ; i < n ; i++ ) {
+        if( eng->gcMarkWorkers[i].started )
+            eng->gcMarkBusy++;
+        else
+            eng->gcMarkIdle++;
+    }
+    eng->gcMarkRound++;
+    pthread_cond_broadcast( &eng->gcMarkWake );
+    pthread_mutex_unlock( &eng->gcMarkLock );
+    
+    markInWorker( &eng->gcMarkWorkers[0] );
+    
+    pthread_mutex_lock( &eng->gcMarkLock );
+    while( eng->gcMarkBusy > 0 )
+        pthread_cond_wait( &eng->gcMarkDone, &eng->gcMarkLock );
+    pthread_mutex_unlock( &eng->gcMarkLock );
+    return true;
+}
+
+#endif
+
+// Monotonic time in nanoseconds, for the statistics.
+static ulongest nanoTime( void ) {
+    #if defined(CLOCK_MONOTONIC)
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return (ulongest)ts.tv_sec*1000000000 + ts.tv_nsec;
+    #else
+        return (ulongest)clock()*(1000000000/CLOCKS_PER_SEC);
+    #endif
+}
+
+// The bucket index is the pause's exponent followed by its top few
+// mantissa bits, with the exponent offset so that the smallest pauses
+// map onto themselves.
+static unsigned pauseBucket( ulongest us ) {
+    unsigned const p = taz_CONFIG_GC_PAUSE_PRECISION;
+    if( us >= 1LLU << 32 )
+        return tazE_PAUSE_BUCKETS - 1;
+    if( us < 1U << p )
+        return us;
+    
+    unsigned e = 0;
+    while( us >> (e + 1) )
+        e++;
+    return ((e - p + 1) << p) + (us >> (e - p)) - (1U << p);
+}
+
+static void recordPause( EngineFull* eng, ulongest start ) {
+    ulongest ns = nanoTime() - start;
+    eng->stats.pauses[pauseBucket( ns/1000 )]++;
+    if( ns > eng->stats.maxPause )
+        eng->stats.maxPause = ns;
+}
+
+static void markRoots( EngineFull* eng ) {
+    for( unsigned i = 0 ; i < taz_ErrNum_LAST ; i++ )
+        tazE_markVal( &eng->view, eng->errvals[i] );
+
+    if( eng->view.envState )
+        tazE_markObj( (tazE_Engine*)eng, eng->view.envState );
+    if( eng->view.apiState )
+        tazE_markObj( (tazE_Engine*)eng, eng->view.apiState );
+    if( eng->view.fiber )
+        tazE_markObj( (tazE_Engine*)eng, eng->view.fiber );
+    
+    tazE_Barrier* barIt = eng->barriers;
+    while( barIt ) {
+        tazE_Barrier* bar = barIt;
+        barIt = barIt->prev;
+        
+        tazE_Bucket* bucIt = bar->buckets;
+        while( bucIt ) {
+            tazE_Bucket* buc = bucIt;
+            bucIt = bucIt->next;
+            
+            void* ptr = (void*)buc + FIRST_BUCKET_OFFSET;
+            for( unsigned i = 0 ; i < buc->size ; i++, ptr += NEXT_BUCKET_OFFSET ) {
+                tazR_TVal* val = ptr;
+                tazE_markVal( (tazE_Engine*)eng, *val );
+            }
+        }
+        
+        tazE_markVal( (tazE_Engine*)eng, bar->errval );
+    }
+}
+
+#if defined(__GNUC__)
+    #define prefetch( PTR ) __builtin_prefetch( (PTR) )
+#else
+    #define prefetch( PTR ) ((void)(PTR))
+#endif
+
+// Pops and scans up to `max` gray objects, or until the stack is empty
+// if `max` is zero.  Scanning an object right after popping it would
+// have us wait on a cache miss for nearly every object, so instead it's
+// prefetched and put in a small ring; to be scanned only after another
+// `taz_CONFIG_GC_PREFETCH_DISTANCE` have been popped.  Objects pushed
+// by those scans are popped in turn, so this is a little less depth
+// first than the stack alone would be.  Returns the number scanned.
+static unsigned scanGray( EngineFull* eng, unsigned max ) {
+    #if taz_CONFIG_GC_PREFETCH_DISTANCE > 0
+        tazR_Obj* ring[taz_CONFIG_GC_PREFETCH_DISTANCE];
+        unsigned  n = 0;
+        
+        tazR_Obj* obj;
+        while( (max == 0 || n < max) && (obj = popGray( eng, &eng->gcStack )) ) {
+            prefetch( obj );
+            
+            unsigned slot = n++ % taz_CONFIG_GC_PREFETCH_DISTANCE;
+            if( n > taz_CONFIG_GC_PREFETCH_DISTANCE )
+                scanObj( eng, ring[slot], eng->isFullCycle );
+            ring[slot] = obj;
+        }
+        
+        // Whatever's still in the ring may push more work, the caller
+        // should check the stack again.
+        unsigned i = n > taz_CONFIG_GC_PREFETCH_DISTANCE ? n - taz_CONFIG_GC_PREFETCH_DISTANCE : 0;
+        for( ; i < n ; i++ )
+            scanObj( eng, ring[i % taz_CONFIG_GC_PREFETCH_DISTANCE], eng->isFullCycle );
+        return n;
+    #else
+        unsigned n = 0;
+        
+        tazR_Obj* obj;
+        while( (max == 0 || n < max) && (obj = popGray( eng, &eng->gcStack )) ) {
+            scanObj( eng, obj, eng->isFullCycle );
+            n++;
+        }
+        return n;
+    #endif
+}
+
+// Scans every marked object again, which pushes whatever they reference
+// that was missed because the gray stack overflowed.  The stack is
+// drained as we go, so we get as far as we can on each pass.  Old
+// objects are only marked in full cycles.
+static void rescanMarked( EngineFull* eng ) {
+    eng->gcStackOverflow = false;
+    
+    tazR_Obj* lists[] = { eng->nursery, eng->isFullCycle ? eng->objects : NULL };
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+            if( !isObjMarked( obj ) )
+                continue;
+            
+            scanObj( eng, obj, eng->isFullCycle );
+            while( eng->gcStack.seg )
+                scanGray( eng, 0 );
+        }
+    }
+}
+
+// Scans up to `budget` objects from the gray stack, or all of them if
+// the budget is zero.  Returns true if the stack was emptied.
+static bool drainGray( EngineFull* eng, unsigned budget ) {
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        if( budget == 0 )
+            drainParallel( eng );
+    #endif
+    
+    unsigned n = 0;
+    while( true ) {
+        if( !eng->gcStack.seg ) {
+            if( !eng->gcStackOverflow )
+                return true;
+            rescanMarked( eng );
+            continue;
+        }
+        if( budget > 0 && n >= budget )
+            return false;
+        n += scanGray( eng, budget > 0 ? budget - n : 0 );
+    }
+}
+
+static void startCycle( EngineFull* eng, bool full ) {
+    ulongest start = nanoTime();
+    
+    // The GC's own reasons for a full cycle wait for `gcFullMinAlloc`,
+    // but those of the caller and an overflowed remembered set can't.
+    size_t oldMin = eng->oldSize > eng->memTarget ? eng->oldSize : eng->memTarget;
+    if( eng->nGCCycles++ % eng->gcFullInterval == 0 && isFullDue( eng ) )
+        eng->isFullCycle = true;
+    if( eng->oldGrowth > (double)oldMin * eng->memGrowth && isFullDue( eng ) )
         eng->isFullCycle = true;
-        startStringGC( (tazE_Engine*)eng );
+    if( full || eng->remSetOverflow )
+        eng->isFullCycle = true;
+    if( eng->isFullCycle ) {
+        memset( eng->ownedTally, 0, sizeof(eng->ownedTally) );
+        eng->sinceFull = 0;
+    }
+    
+    markRoots( eng );
+    
+    // Old objects aren't traced in minor cycles, so the remembered
+    // set stands in for them.
+    if( !eng->isFullCycle ) {
+        for( unsigned i = 0 ; i < eng->remSetTop ; i++ )
+            scanObj( eng, eng->remSetBuf[i], false );
+    }
+    
+    eng->cycleMarkTime = nanoTime() - start;
+}
+
+// Roots and sticky objects are mutated without a barrier, so if they
+// were scanned earlier in an incremental cycle they may have picked up
+// unmarked references since; these need another look before the
+// cycle can be finished.
+static void remarkSticky( EngineFull* eng ) {
+    markRoots( eng );
+    
+    for( unsigned i = 0 ; i < eng->remSetTop ; i++ ) {
+        tazR_Obj* obj = eng->remSetBuf[i];
+        if( isSticky( obj ) && isObjMarked( obj ) )
+            scanObj( eng, obj, true );
+    }
+    
+    tazR_Obj* it = eng->nursery;
+    while( it ) {
+        if( isSticky( it ) && isObjMarked( it ) )
+            scanObj( eng, it, true );
+        it = tazR_getPtrAddr( it->next_and_tag );
+    }
+}
+
+// Ephemerons only keep the values whose keys are alive, and marking
+// those values may bring more keys to life; so they're traced over and
+// over until nothing new is marked, including any further ephemerons
+// that are found along the way.  Whatever's still unmarked after that
+// is cleared from the weak objects, before the sweep can free it.
+static void processWeak( EngineFull* eng ) {
+    bool again = eng->weakTop > 0;
+    while( again ) {
+        unsigned top = eng->weakTop;
+        
+        again = false;
+        for( unsigned i = 0 ; i < top ; i++ )
+            again = traceObj( eng, eng->weakBuf[i] ) || again;
+        
+        drainGray( eng, 0 );
+        again = again || eng->weakTop > top;
+    }
+    
+    for( unsigned i = 0 ; i < eng->weakTop ; i++ )
+        clearObj( eng, eng->weakBuf[i] );
+    eng->weakTop = 0;
+}
+
+static void finishCycle( EngineFull* eng, size_t nsz ) {
+    ulongest start = nanoTime();
+    
+    if( eng->gcPhase == GCPhase_MARK )
+        remarkSticky( eng );
+    drainGray( eng, 0 );
+    processWeak( eng );
+    if( eng->sampler )
+        updateLiveSamples( eng );
+    
+    ulongest marked = nanoTime();
+    size_t   used   = eng->memUsed;
+    
+    // Loans made while marking could point into strings that weren't
+    // marked, so they're copied out only once marking is done.
+    bool sweepStrings = false;
+    if( eng->isFullCycle && !eng->gcKeepStrs )
+        sweepStrings = startStringGC( (tazE_Engine*)eng );
+    
+    // Sweep.
+    filterRemSet( eng );
+    
+    // The nursery is swept right away, since it's bounded in size; but
+    // the old generation is left for `sweepSome()`.
+    tazR_Obj* dead  = NULL;
+    tazR_Obj* young = eng->nursery;
+    tazR_Obj* old   = NULL;
+    eng->nursery = NULL;
+    
+    if( eng->isFullCycle ) {
+        old = eng->objects;
+        eng->objects = NULL;
+    }
+    sweepList( eng, young, &dead );
+    releaseList( eng, dead );
+    flushFrees( eng );
+    
+    // Put the old generation back after the promoted objects, that's
+    // where the lazy sweep starts.
+    if( old ) {
+        tazR_Obj* tail = eng->objects;
+        while( tail && tazR_getObjNext( tail ) )
+            tail = tazR_getObjNext( tail );
+        
+        if( tail )
+            tail->next_and_tag = tazR_makeTPtr( tazR_getPtrTag( tail->next_and_tag ), old );
+        else
+            eng->objects = old;
+        
+        eng->sweepPrev = tail;
+        eng->sweepNext = old;
+    }
+    
+    // Finish up.
+    adjustHeap( eng, nsz );
+    
+    eng->gcPhase     = eng->sweepNext ? GCPhase_SWEEP : GCPhase_IDLE;
+    eng->isGCRunning = false;
+    
+    if( eng->isFullCycle ) {
+        eng->isFullCycle = false;
+        finishStringGC( (tazE_Engine*)eng, sweepStrings );
+        eng->stats.fullCycles++;
+        if( eng->gcPhase == GCPhase_IDLE )
+            finishTally( eng );
+    }
+    else {
+        eng->stats.minorCycles++;
+    }
+    
+    // Promoted sticky objects may have grown the remembered set, which
+    // is taken out of the count; or all of it, if the set grew more.
+    if( eng->memUsed < used )
+        eng->stats.bytesFreed += used - eng->memUsed;
+    
+    ulongest done = nanoTime();
+    eng->cycleMarkTime += marked - start;
+    eng->stats.lastMarkTime   = eng->cycleMarkTime;
+    eng->stats.lastSweepTime  = done - marked;
+    eng->stats.markTime      += eng->cycleMarkTime;
+    eng->stats.sweepTime     += done - marked;
+}
+
+// Finishes the last cycle's sweep, counting it towards that cycle.
+static void finishSweep( EngineFull* eng ) {
+    ulongest start = nanoTime();
+    sweepSome( eng, 0 );
+    
+    ulongest time = nanoTime() - start;
+    eng->stats.lastSweepTime += time;
+    eng->stats.sweepTime     += time;
+}
+
+// Runs a cycle to completion, finishing up any that's already in
+// progress first.
+static void collect( EngineFull* eng, size_t nsz, bool full ) {
+    if( eng->gcDisabled ) {
+        adjustHeap( eng, nsz );
+        return;
+    }
+    
+    ulongest start = nanoTime();
+    
+    // An interrupted cycle may have kept objects which died while it
+    // was running, so an explicit full collection runs a fresh one
+    // afterwards.  Either way everything is swept before returning,
+    // since the caller wants the memory now.
+    bool fresh = true;
+    if( eng->gcPhase == GCPhase_MARK ) {
+        eng->isGCRunning = true;
+        finishCycle( eng, nsz );
+        fresh = full;
+    }
+    finishSweep( eng );
+    
+    if( fresh ) {
+        eng->isGCRunning = true;
+        startCycle( eng, full );
+        finishCycle( eng, nsz );
+        finishSweep( eng );
+    }
+    recordPause( eng, start );
+}
+
+// Called when an allocation would grow the heap either past its limit
+// or while an incremental cycle is in progress.  Minor cycles are
+// bounded by the size of the nursery, so only full cycles are split
+// up into steps.
+static void stepGC( EngineFull* eng, size_t nsz ) {
+    if( eng->gcDisabled ) {
+        adjustHeap( eng, nsz );
+        return;
+    }
+    
+    ulongest start = nanoTime();
+    
+    // The last cycle's sweep has to be done before we can start marking.
+    if( eng->gcPhase == GCPhase_SWEEP )
+        finishSweep( eng );
+    
+    eng->isGCRunning = true;
+    
+    if( eng->gcPhase == GCPhase_IDLE ) {
+        startCycle( eng, false );
+        if( !eng->isFullCycle || eng->gcStepSize == 0 ) {
+            finishCycle( eng, nsz );
+            recordPause( eng, start );
+            return;
+        }
+        eng->gcPhase = GCPhase_MARK;
+    }
+    
+    ulongest step = nanoTime();
+    bool     done = drainGray( eng, eng->gcStepSize );
+    eng->cycleMarkTime += nanoTime() - step;
+    
+    if( done )
+        finishCycle( eng, nsz );
+    else
+        eng->isGCRunning = false;
+    recordPause( eng, start );
+}
+
+/******************************** Compaction **********************************/
+
+// Engines made with `taz_Config.gcCompact` keep raw buffers small enough
+// for the cells apart from the objects, in pages of their own.  Each of
+// these buffers is owned by a single object, which can be asked to move
+// it; for now that's only records, index tables are always too big for
+// the cells.  So after a full cycle the sparsest raw pages of each size class
+// are evacuated into the fullest, for as many as the rest can take in,
+// and the emptied pages given back to the system.
+//
+// Any allocation can start a full cycle, and runtime code holds on to
+// buffer addresses across allocations; so compaction is left for the
+// next point where nothing can be holding on to one, which is when the
+// outermost barrier is popped, or an explicit `tazE_compact()`.
+#ifndef tazR_moveRec
+    #define tazR_moveRec( ENG, OBJ )
+#endif
+
+static bool isRawCell( EngineFull* eng, size_t sz ) {
+    return eng->rawPages && sz > 0 && sz <= MAX_CLASS_SIZE;
+}
+
+// Resizes a raw buffer where either the old or new size fits in a cell,
+// so it may have to move between the pages and the allocator callback.
+static void* reallocCell( EngineFull* eng, void* old, size_t osz, size_t nsz ) {
+    unsigned ocls = isRawCell( eng, osz ) ? sizeClassOf( osz ) : NO_CLASS;
+    unsigned ncls = isRawCell( eng, nsz ) ? sizeClassOf( nsz ) : NO_CLASS;
+    if( osz > 0 && ocls == ncls )
+        return old;
+    
+    void* mem = NULL;
+    if( nsz > 0 ) {
+        mem = ncls == NO_CLASS ? mallocMem( eng, nsz ) : mallocCell( eng, ncls, true );
+        if( osz > 0 )
+            memcpy( mem, old, osz < nsz ? osz : nsz );
+    }
+    if( osz > 0 ) {
+        if( ocls == NO_CLASS ) {
+            freeMem( eng, old, osz );
+        }
+        else {
+            giveCell( eng, old );
+            eng->memUsed -= classSizeTable[ocls];
+        }
+    }
+    return mem;
+}
+
+static int compareNUsed( void const* a, void const* b ) {
+    unsigned na = (*(HeapPage**)a)->nused;
+    unsigned nb = (*(HeapPage**)b)->nused;
+    return na < nb ? -1 : na > nb ? 1 : 0;
+}
+
+// Picks which raw pages of a size class to evacuate, the sparsest ones
+// whose cells all fit in the free cells of the rest.  Full pages are
+// as compact as they'll get, so only those with free cells are looked
+// at.  The picked pages are taken out of the list, so the cells moved
+// out of them are put in the others.
+static unsigned pickEvacuees( EngineFull* eng, unsigned cls ) {
+    unsigned npages = 0;
+    for( HeapPage* page = eng->rawAvail[cls] ; page ; page = page->next )
+        npages++;
+    if( npages < 2 )
+        return 0;
+    
+    HeapPage** pages = sysAlloc( eng, NULL, 0, sizeof(HeapPage*)*npages );
+    if( !pages )
+        return 0;
+    
+    unsigned i     = 0;
+    size_t   avail = 0;
+    unsigned cap   = (taz_CONFIG_HEAP_PAGE_SIZE - PAGE_CELLS_OFFSET)/classSizeTable[cls];
+    for( HeapPage* page = eng->rawAvail[cls] ; page ; page = page->next ) {
+        pages[i++] = page;
+        avail += cap - page->nused;
+    }
+    qsort( pages, npages, sizeof(HeapPage*), compareNUsed );
+    
+    unsigned nevac = 0;
+    size_t   moved = 0;
+    while( nevac < npages ) {
+        HeapPage* page = pages[nevac];
+        if( moved + page->nused > avail - (cap - page->nused) )
+            break;
+        moved += page->nused;
+        avail -= cap - page->nused;
+        nevac++;
+    }
+    for( i = 0 ; i < nevac ; i++ ) {
+        tazR_unlinkWithNextAndLink( pages[i] );
+        pages[i]->link = NULL;
+        pages[i]->evac = true;
+    }
+    
+    sysAlloc( eng, pages, sizeof(HeapPage*)*npages, 0 );
+    return nevac;
+}
+
+static void moveObjRaw( EngineFull* eng, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_REC:
+            tazR_moveRec( (tazE_Engine*)eng, data );
+        break;
+        default:
+        break;
+    }
+}
+
+static void compactRaw( EngineFull* eng ) {
+    eng->compactDue = false;
+    
+    unsigned nevac = 0;
+    for( unsigned cls = 0 ; cls < NUM_SIZE_CLASSES ; cls++ )
+        nevac += pickEvacuees( eng, cls );
+    if( nevac == 0 )
+        return;
+    
+    // Objects whose finalizers have been deferred are left be, they'll
+    // be freeing their buffers soon enough.
+    tazR_Obj* lists[] = { eng->nursery, eng->objects };
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) )
+            moveObjRaw( eng, obj );
+    }
+    
+    // Whatever is left in the evacuated pages couldn't be moved, so
+    // those pages go back in the lists.
+    for( HeapChunk* chunk = eng->heapChunks ; chunk ; chunk = chunk->next ) {
+        uintptr_t mask  = taz_CONFIG_HEAP_PAGE_SIZE - 1;
+        uintptr_t start = ((uintptr_t)chunk->raw + mask) & ~mask;
+        for( unsigned i = 0 ; i < chunk->npages ; i++ ) {
+            HeapPage* page = (HeapPage*)(start + i*taz_CONFIG_HEAP_PAGE_SIZE);
+            if( !page->evac )
+                continue;
+            page->evac = false;
+            tazR_linkWithNextAndLink( &eng->rawAvail[page->cls], page );
+        }
+    }
+}
+
+/**************************** String Pooling **********************************/
+
+
+typedef struct StrNode       StrNode;
+typedef struct StrNodeLong  StrNodeLong;
+typedef struct StrNodeMedium StrNodeMedium;
+
+struct StrNode {
+    unsigned  hash  : 30;
+    unsigned  large : 1;
+    unsigned  id;
+};
+
+struct StrNodeLong {
+    StrNode base;
+    size_t  len;
+    char    buf[];
+};
+
+struct StrNodeMedium {
+    StrNode  base;
+    
+    size_t len;
+    char   buf[];
+};
+
+typedef StrNode* StrNodeBlock[sizeof(unsigned)];
+
+struct StrPool {
+    
+    // This part makes up the hashmap used for interning medium
+    // length strings, see `findMediumStr()`.
+    unsigned        hcap;
+    unsigned        hcnt;
+    unsigned        hbits;
+    StrNodeMedium** hmap;
+    
+    // This keeps a direct mapping from string handles to nodes,
+    // it's used for both medium and long strings.
+    size_t        ncap;
+    StrNodeBlock* nmap;
+    
+    // This is a bitmap to keep track of which slots in nmap are
+    // being used and which are free.  It'll always have the
+    // same capacity as nmap.
+    unsigned* bmap;
+    
+    // Blocks with free slots are kept on a stack, linked through
+    // `flink` by index plus one so zero can end it; so a new ID is
+    // found without searching.  The blocks from `ntop` on have never
+    // been used, and aren't on the stack.  Same capacity as nmap.
+    unsigned* flink;
+    unsigned  fhead;
+    size_t    ntop;
+    
+    // And this one holds the GC marks, it's kept apart from the nodes
+    // so marking doesn't write to string memory.  Same layout as bmap.
+    unsigned* gmap;
+    
+    // The pool of the frozen engine this one shares, if any.  Its IDs
+    // all come before `base`, which is where this pool's own start;
+    // so the maps above are indexed by `id - base`.
+    StrPool* shared;
+    unsigned base;
+};
+
+// Medium strings are interned in an open addressed table, with linear
+// probing from a slot picked by Fibonacci hashing; so its capacity is a
+// power of two.  It's doubled before it gets more than three quarters
+// full, and halved after string collection leaves it less than an
+// eighth full.  Removal shifts the entries following a string back
+// into its place, so there are no tombstones to clear out.
+//
+// The table is only resized while no string is being looked up in it;
+// but since that includes during collection, it bypasses `reallocMem()`
+// like the GC's side buffers do.
+#define STR_MAP_MIN_CAP (64)
+
+static unsigned strMapSlot( StrPool* pool, unsigned h ) {
+    return (h*2654435769U) >> (32 - pool->hbits);
+}
+
+static void insertMediumStr( StrPool* pool, StrNodeMedium* node ) {
+    unsigned mask = pool->hcap - 1;
+    unsigned i    = strMapSlot( pool, node->base.hash );
+    while( pool->hmap[i] )
+        i = (i + 1) & mask;
+    
+    pool->hmap[i] = node;
+    pool->hcnt++;
+}
+
+static void removeMediumStr( StrPool* pool, StrNodeMedium* node ) {
+    unsigned mask = pool->hcap - 1;
+    unsigned i    = strMapSlot( pool, node->base.hash );
+    while( pool->hmap[i] != node )
+        i = (i + 1) & mask;
+    
+    // Each following entry is moved back if the hole lies between its
+    // home slot and where it is now.
+    for( unsigned j = (i + 1) & mask ; pool->hmap[j] ; j = (j + 1) & mask ) {
+        unsigned home = strMapSlot( pool, pool->hmap[j]->base.hash );
+        if( ((j - home) & mask) >= ((j - i) & mask) ) {
+            pool->hmap[i] = pool->hmap[j];
+            i = j;
+        }
+    }
+    pool->hmap[i] = NULL;
+    pool->hcnt--;
+}
+
+static StrNodeMedium* findMediumStr( StrPool* pool, char const* str, size_t len, unsigned h ) {
+    unsigned mask = pool->hcap - 1;
+    for( unsigned i = strMapSlot( pool, h ) ; pool->hmap[i] ; i = (i + 1) & mask ) {
+        StrNodeMedium* it = pool->hmap[i];
+        if( it->base.hash == h && it->len == len && !memcmp( it->buf, str, len ) )
+            return it;
+    }
+    return NULL;
+}
+
+static bool resizeStrMap( EngineFull* eng, StrPool* pool, unsigned ncap ) {
+    StrNodeMedium** map = sysAlloc( eng, NULL, 0, sizeof(StrNodeMedium*)*ncap );
+    if( !map )
+        return false;
+    memset( map, 0, sizeof(StrNodeMedium*)*ncap );
+    eng->memUsed += sizeof(StrNodeMedium*)*ncap;
+    
+    StrNodeMedium** omap = pool->hmap;
+    unsigned        ocap = pool->hcap;
+    pool->hmap  = map;
+    pool->hcap  = ncap;
+    pool->hcnt  = 0;
+    pool->hbits = 0;
+    while( (1U << pool->hbits) < ncap )
+        pool->hbits++;
+    
+    for( unsigned i = 0 ; i < ocap ; i++ ) {
+        if( omap[i] )
+            insertMediumStr( pool, omap[i] );
+    }
+    if( omap ) {
+        sysAlloc( eng, omap, sizeof(StrNodeMedium*)*ocap, 0 );
+        eng->memUsed -= sizeof(StrNodeMedium*)*ocap;
+    }
+    return true;
+}
+
+static void shrinkStrMap( EngineFull* eng, StrPool* pool ) {
+    // Halving at under an eighth full leaves the table under a quarter
+    // full, well short of the three quarters that would grow it again.
+    unsigned ncap = pool->hcap;
+    while( ncap/2 >= STR_MAP_MIN_CAP && pool->hcnt*8 < ncap )
+        ncap /= 2;
+    if( ncap < pool->hcap )
+        resizeStrMap( eng, pool, ncap );
+}
+
+static void freeStrMap( EngineFull* eng, StrPool* pool ) {
+    sysAlloc( eng, pool->hmap, sizeof(StrNodeMedium*)*pool->hcap, 0 );
+    eng->memUsed -= sizeof(StrNodeMedium*)*pool->hcap;
+}
+
+static StrPool* makeStrPool( tazE_Engine* eng, StrPool* shared ) {
+    tazE_RawAnchor poolA, nmapA, bmapA, gmapA, flinkA;
+    
+    unsigned      ncap = 1;
+    StrNodeBlock* nmap = tazE_zallocRaw( eng, &nmapA, sizeof(StrNodeBlock)*ncap );
+    unsigned*     bmap = tazE_zallocRaw( eng, &bmapA, sizeof(unsigned)*ncap );
+    unsigned*     gmap = tazE_zallocRaw( eng, &gmapA, sizeof(unsigned)*ncap );
+    unsigned*    flink = tazE_zallocRaw( eng, &flinkA, sizeof(unsigned)*ncap );
+    
+    StrPool* pool = tazE_mallocRaw( eng, &poolA, sizeof(StrPool) );
+    pool->hcap   = 0;
+    pool->hcnt   = 0;
+    pool->hbits  = 0;
+    pool->hmap   = NULL;
+    pool->ncap   = ncap;
+    pool->nmap   = nmap;
+    pool->bmap   = bmap;
+    pool->gmap   = gmap;
+    pool->flink  = flink;
+    pool->fhead  = 0;
+    pool->ntop   = 0;
+    pool->shared = shared;
+    pool->base   = shared ? shared->base + shared->ncap*sizeof(unsigned) : 0;
+    
+    // Done last, since it isn't anchored.
+    if( !resizeStrMap( (EngineFull*)eng, pool, STR_MAP_MIN_CAP ) )
+        tazE_error( eng, taz_ErrNum_MEMORY );
+    
+    tazE_commitRaw( eng, &poolA );
+    tazE_commitRaw( eng, &nmapA );
+    tazE_commitRaw( eng, &bmapA );
+    tazE_commitRaw( eng, &gmapA );
+    tazE_commitRaw( eng, &flinkA );
+    return pool;
+}
+
+static void freeStrPool( tazE_Engine* eng, StrPool* pool ) {
+    for( unsigned i = 0 ; i < pool->ntop ; i++ ) {
+        for( unsigned j = 0 ; j < elemsof( pool->nmap[i] ) ; j++ ) {
+            StrNode* node = pool->nmap[i][j];
+            if( node ) {
+                if( node->large ) {
+                    StrNodeLong* nodeL = (StrNodeLong*)node;
+                    tazE_freeRaw( eng, pool->nmap[i][j], sizeof(StrNodeLong) + nodeL->len + 1 );
+                }
+                else {
+                    StrNodeMedium* nodeM = (StrNodeMedium*)node;
+                    tazE_freeRaw( eng, pool->nmap[i][j], sizeof(StrNodeMedium) + nodeM->len + 1 );
+                }
+            }
+        }
+    }
+    
+    freeStrMap( (EngineFull*)eng, pool );
+    tazE_freeRaw( eng, pool->nmap, sizeof(StrNodeBlock)*pool->ncap );
+    tazE_freeRaw( eng, pool->bmap, sizeof(unsigned)*pool->ncap );
+    tazE_freeRaw( eng, pool->gmap, sizeof(unsigned)*pool->ncap );
+    tazE_freeRaw( eng, pool->flink, sizeof(unsigned)*pool->ncap );
+    tazE_freeRaw( eng, pool, sizeof(StrPool) );
+}
+
+/* Note: String Format
+Strings can be either short, medium, or long; and are represented in a integral
+type (tazR_Str) differently depending on the type.  The topmost byte of the
+6 bytes the string is allowed to use (only 6 since the top 2 are used for value
+meta data) is reserved for string meta data.  The topmost two bits indicate the
+string type.  If the type matches STR_SHORT then the rest of the bits give the
+short string's size (the number of bytes it uses), any unused bytes (at the lower
+end of the integral) must be zero.  If for other string types the rest of the
+meta bits should be cleared.
+*/
+
+#define STR_SIZE_MASK  (0x3FLLU << 40)
+#define STR_SIZE_SHIFT (40)
+#define STR_TYPE_MASK  (0x3LLU << 46)
+#define STR_SHORT      (0x0LLU << 46)
+#define STR_MEDIUM     (0x1LLU << 46)
+#define STR_LONG       (0x2LLU << 46)
+
+#define SHORT_STR_MAX_LEN  (5)
+#define MEDIUM_STR_MAX_LEN (16)
+
+static tazR_Str makeShortStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
+    tazR_Str ss = 0;
+    for( unsigned i = 0 ; i < len ; i++ )
+        ss = (ss << 8) | str[i];
+    
+    ss |= STR_SHORT | (len << STR_SIZE_SHIFT);
+    return ss;
+}
+
+#if defined(__GNUC__)
+    #define lowestBit( U ) __builtin_ctz( (U) )
+#else
+    static unsigned lowestBit( unsigned u ) {
+        unsigned k = 0;
+        while( !(u & (1U << k)) )
+            k++;
+        return k;
+    }
+#endif
+
+// The maps are doubled when they're full, so interning a lot of strings
+// doesn't keep reallocating them.
+static void growStrPool( tazE_Engine* eng, StrPool* pool ) {
+    size_t          ncap   = pool->ncap*2;
+    tazE_RawAnchor  nmapA  = { .raw = pool->nmap, .sz = sizeof(StrNodeBlock)*pool->ncap };
+    tazE_RawAnchor  bmapA  = { .raw = pool->bmap, .sz = sizeof(unsigned)*pool->ncap };
+    tazE_RawAnchor  gmapA  = { .raw = pool->gmap, .sz = sizeof(unsigned)*pool->ncap };
+    tazE_RawAnchor  flinkA = { .raw = pool->flink, .sz = sizeof(unsigned)*pool->ncap };
+    
+    pool->nmap  = tazE_reallocRaw( eng, &nmapA, sizeof(StrNodeBlock)*ncap );
+    pool->bmap  = tazE_reallocRaw( eng, &bmapA, sizeof(unsigned)*ncap );
+    pool->gmap  = tazE_reallocRaw( eng, &gmapA, sizeof(unsigned)*ncap );
+    pool->flink = tazE_reallocRaw( eng, &flinkA, sizeof(unsigned)*ncap );
+    memset( pool->nmap + pool->ncap, 0, sizeof(StrNodeBlock)*(ncap - pool->ncap) );
+    memset( pool->bmap + pool->ncap, 0, sizeof(unsigned)*(ncap - pool->ncap) );
+    memset( pool->gmap + pool->ncap, 0, sizeof(unsigned)*(ncap - pool->ncap) );
+    pool->ncap = ncap;
+    
+    tazE_commitRaw( eng, &nmapA );
+    tazE_commitRaw( eng, &bmapA );
+    tazE_commitRaw( eng, &gmapA );
+    tazE_commitRaw( eng, &flinkA );
+}
+
+static tazR_Str makeStrId( tazE_Engine* eng, StrPool* pool ) {
+    // Only the low bits of each unit are used, one for each slot
+    // in the block.
+    unsigned full = (1U << elemsof(pool->nmap[0])) - 1;
+    
+    // Take a block from the free stack if there is one, or else a
+    // fresh one.  Growing can run a collection, which may free some.
+    if( !pool->fhead && pool->ntop == pool->ncap )
+        growStrPool( eng, pool );
+    if( !pool->fhead ) {
+        pool->flink[pool->ntop] = 0;
+        pool->fhead = ++pool->ntop;
+    }
+    
+    size_t   i = pool->fhead - 1;
+    unsigned k = lowestBit( ~pool->bmap[i] );
+    pool->bmap[i] |= 1U << k;
+    if( pool->bmap[i] == full )
+        pool->fhead = pool->flink[i];
+    return pool->base + i*sizeof(unsigned) + k;
+}
+
+static unsigned hash( char const* str, size_t len ) {
+    unsigned h = 0;
+    for( unsigned i = 0 ; i < len && i < 16 ; i++ )
+        h = h*37 + str[i];
+    return h;
+}
+
+static tazR_Str makeMediumStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
+    unsigned h = hash( str, len ) & 0x3FFFFFFF;
+    
+    // Shared pools are frozen, so they can be searched from any thread.
+    for( StrPool* it = pool ; it ; it = it->shared ) {
+        StrNodeMedium* node = findMediumStr( it, str, len, h );
+        if( node )
+            return node->base.id | STR_MEDIUM;
+    }
+    
+    // The table is grown before anything else is allocated, which may
+    // shrink it again; but only if it's left near empty.  Failing to
+    // grow it just makes for longer probes, until it's nearly full.
+    EngineFull* engFull = (EngineFull*)eng;
+    if( (pool->hcnt + 1)*4 > pool->hcap*3 && !resizeStrMap( engFull, pool, pool->hcap*2 ) ) {
+        if( (pool->hcnt + 1)*8 > pool->hcap*7 ) {
+            collect( engFull, 0, true );
+            if( !resizeStrMap( engFull, pool, pool->hcap*2 ) )
+                tazE_error( eng, taz_ErrNum_MEMORY );
+        }
+    }
+    
+    tazR_Str id = makeStrId( eng, pool );
+    
+    unsigned  arrayOffset = (id - pool->base) / sizeof(unsigned);
+    unsigned  blockOffset = (id - pool->base) % sizeof(unsigned);
+    StrNode** place       = &pool->nmap[arrayOffset][blockOffset];
+    
+    tazE_RawAnchor nodeA;
+    StrNodeMedium* node = tazE_mallocRaw( eng, &nodeA, sizeof(StrNodeMedium) + len + 1 );
+    node->base.hash  = h;
+    node->base.large = 0;
+    node->base.id    = id;
+    node->len = len;
+    memcpy( node->buf, str, len + 1 );
+    
+    *place = (StrNode*)node;
+    insertMediumStr( pool, node );
+    
+    tazE_commitRaw( eng, &nodeA );
+    return id | STR_MEDIUM;
+}
+
+static tazR_Str makeLongStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
+    tazR_Str id = makeStrId( eng, pool );
+    
+    unsigned  arrayOffset = (id - pool->base) / sizeof(unsigned);
+    unsigned  blockOffset = (id - pool->base) % sizeof(unsigned);
+    StrNode** place       = &pool->nmap[arrayOffset][blockOffset];
+    
+    tazE_RawAnchor nodeA;
+    StrNodeLong* node = tazE_mallocRaw( eng, &nodeA, sizeof(StrNodeLong) + len + 1 );
+    node->base.hash  = hash( str, len ) & 0x3FFFFFFF;
+    node->base.large = 1;
+    node->base.id    = id;
+    node->len = len;
+    memcpy( node->buf, str, len + 1 );
+    
+    *place = (StrNode*)node;
+    
+    tazE_commitRaw( eng, &nodeA );
+    
+    return id | STR_LONG;
+}
+
+static tazR_Str makeStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
+    if( len <= SHORT_STR_MAX_LEN )
+        return makeShortStr( eng, pool, str, len );
+    if( len <= MEDIUM_STR_MAX_LEN )
+        return makeMediumStr( eng, pool, str, len );
+    
+    return makeLongStr( eng, pool, str, len );
+}
+
+static StrNode* getStrNode( tazE_Engine* eng, StrPool* pool, tazR_Str id ) {
+    while( id < pool->base )
+        pool = pool->shared;
+    
+    unsigned  arrayOffset = (id - pool->base) / sizeof(unsigned);
+    unsigned  blockOffset = (id - pool->base) % sizeof(unsigned);
+    return pool->nmap[arrayOffset][blockOffset];
+}
+
+static void borrowShortStr( tazE_Engine* eng, StrPool* pool, tazR_Str s, taz_StrLoan* loan ) {
+    size_t len = (s & STR_SIZE_MASK) >> STR_SIZE_SHIFT;
+    
+    tazE_RawAnchor strA;
+    char*  str = tazE_mallocRaw( eng, &strA, len + 1 );
+    size_t end = len;
+    str[end--] = '\0';
+    for( unsigned i = 0 ; i < len ; i++ ) {
+        str[end--] = s & 0xFF;
+        s >>= 8;
+    }
+    
+    loan->next = NULL;
+    loan->link = NULL;
+    loan->str  = str;
+    loan->len  = len;
+    
+    tazE_commitRaw( eng, &strA );
+}
+
+static void borrowLongStr( tazE_Engine* eng, StrPool* pool, tazR_Str id, taz_StrLoan* loan ) {
+    StrNodeLong* node = (StrNodeLong*)getStrNode( eng, pool, id );
+    assert( node );
+    
+    tazR_linkWithNextAndLink( &((EngineFull*)eng)->loans, loan );
+    loan->len = node->len;
+    loan->str = node->buf;
+}
+
+static void borrowMediumStr( tazE_Engine* eng, StrPool* pool, tazR_Str id, taz_StrLoan* loan ) {
+    StrNodeMedium* node = (StrNodeMedium*)getStrNode( eng, pool, id );
+    assert( node );
+    
+    tazR_linkWithNextAndLink( &((EngineFull*)eng)->loans, loan );
+    loan->len = node->len;
+    loan->str = node->buf;
+}
+
+
+// Copies out all the loaned strings, this is done while the GC is
+// running so the copies are allocated directly.  If we run out of
+// memory the remaining loans are left in place and the caller is
+// told not to release unmarked strings this cycle.
+static bool startStringGC( tazE_Engine* _eng ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    while( eng->loans ) {
+        taz_StrLoan* loan = eng->loans;
+        char*        cpy  = sysAlloc( eng, NULL, 0, loan->len + 1 );
+        if( !cpy )
+            return false;
+        eng->memUsed += loan->len + 1;
+        
+        memcpy( cpy, loan->str, loan->len + 1 );
+        loan->str = cpy;
+        
+        tazR_unlinkWithNextAndLink( loan );
+        loan->link = NULL;
+        loan->next = NULL;
+    }
+    return true;
+}
+
+static size_t sizeofStrNode( StrNode* node ) {
+    if( node->large )
+        return sizeof(StrNodeLong) + ((StrNodeLong*)node)->len + 1;
+    else
+        return sizeof(StrNodeMedium) + ((StrNodeMedium*)node)->len + 1;
+}
+
+static void collectNode( tazE_Engine* eng, StrPool* pool, StrNode* node ) {
+    unsigned arrayOffset = (node->id - pool->base) / sizeof(unsigned);
+    unsigned blockOffset = (node->id - pool->base) % sizeof(unsigned);
+    pool->nmap[arrayOffset][blockOffset] = NULL;
+    
+    // Full blocks go back on the free stack when they lose a string.
+    unsigned full = (1U << elemsof(pool->nmap[0])) - 1;
+    if( pool->bmap[arrayOffset] == full ) {
+        pool->flink[arrayOffset] = pool->fhead;
+        pool->fhead = arrayOffset + 1;
+    }
+    pool->bmap[arrayOffset] &= ~(1 << blockOffset);
+    
+    if( node->large ) {
+        StrNodeLong* nodeL = (StrNodeLong*)node;
+        tazE_freeRaw( eng, nodeL, sizeof(StrNodeLong) + nodeL->len + 1 );
+    }
+    else {
+        StrNodeMedium* nodeM = (StrNodeMedium*)node;
+        removeMediumStr( pool, nodeM );
+        tazE_freeRaw( eng, nodeM, sizeof(StrNodeMedium) + nodeM->len + 1 );
+    }
+}
+
+static void finishStringGC( tazE_Engine* _eng, bool sweep ) {
+    EngineFull* eng  = (EngineFull*)_eng;
+    StrPool*    pool = eng->strPool;
+    
+    // Figure out how many blocks we actually need to scan.
+    unsigned end = pool->ntop;
+    while( end > 0 && pool->bmap[end-1] == 0 )
+        end--;
+    
+    for( unsigned i = 0 ; i < end && sweep ; i++ ) {
+        for( unsigned j = 0 ; j < elemsof(pool->nmap[i]) ; j++ ) {
+            StrNode* node = pool->nmap[i][j];
+            if( node && !(pool->gmap[i] & (1U << j)) )
+                collectNode( _eng, pool, node );
+        }
+    }
+    memset( pool->gmap, 0, sizeof(unsigned)*pool->ncap );
+    if( sweep )
+        shrinkStrMap( eng, pool );
+}
+
+/****************************** Heap Dumps ************************************/
+
+struct HeapDump {
+    taz_Writer* writer;
+    bool        failed;
+};
+
+#define DUMP_STR_FLAG (1LLU << 63)
+
+// Everything is written little endian, in fixed size fields.
+static void dumpWord( HeapDump* dump, ulongest u, unsigned bytes ) {
+    for( unsigned i = 0 ; i < bytes && !dump->failed ; i++ ) {
+        if( !dump->writer->write( dump->writer, (char)(u >> i*8) ) )
+            dump->failed = true;
+    }
+}
+
+static void dumpRef( HeapDump* dump, ulongest id ) {
+    dumpWord( dump, id, 8 );
+}
+
+static void dumpObj( EngineFull* eng, HeapDump* dump, tazR_Obj* obj ) {
+    dumpWord( dump, 'O', 1 );
+    dumpRef( dump, (ulongest)(uintptr_t)obj );
+    dumpWord( dump, tazR_getObjType( obj ), 1 );
+    dumpWord( dump, footprintOf( eng, sizeofObj( eng, obj ) ) + ownedByObj( eng, obj ), 4 );
+    scanObj( eng, obj, true );
+    dumpRef( dump, 0 );
+}
+
+static void dumpStrs( EngineFull* eng, HeapDump* dump ) {
+    StrPool* pool = eng->strPool;
+    for( size_t i = 0 ; i < pool->ncap ; i++ ) {
+        for( unsigned j = 0 ; j < elemsof(pool->nmap[i]) ; j++ ) {
+            StrNode* node = pool->nmap[i][j];
+            if( !node )
+                continue;
+            
+            dumpWord( dump, 'S', 1 );
+            dumpRef( dump, DUMP_STR_FLAG | node->id );
+            dumpWord( dump, sizeofStrNode( node ), 4 );
+        }
+    }
+}
+
+/****************************** Heap Images ***********************************/
+
+// An image is written as a stream of little endian words, with objects
+// referred to by their place in the image and strings by the ID they
+// had in the saving engine; so it can be loaded anywhere, by copying
+// each object into a fresh engine and mapping its references over.
+// Code pointers are saved relative to `tazE_saveImage()` itself.
+#define IMAGE_MAGIC   "TAZIMG"
+#define IMAGE_VERSION (1)
+
+typedef struct ImageSlot ImageSlot;
+
+struct ImageSlot {
+    tazR_Obj* obj;
+    ulongest  ref;
+};
+
+struct tazE_Image {
+    tazE_Engine* eng;
+    ulongest     sum;
+    
+    // Saving.
+    taz_Writer* writer;
+    bool        failed;
+    ImageSlot*  slots;
+    unsigned    slotCap;
+    
+    // Loading.
+    uchar const* buf;
+    size_t       len;
+    size_t       pos;
+    tazR_Obj**   objs;
+    ulongest     numObjs;
+    size_t       objSize;
+    tazR_Str*    strs;
+    ulongest     numStrs;
+};
+
+// FNV-1a, over everything but the trailing sum itself.
+#define IMAGE_SUM_BASIS (0xCBF29CE484222325LLU)
+#define IMAGE_SUM_PRIME (0x100000001B3LLU)
+
+static ulongest imageFingerprint( void ) {
+    ulongest span = (char*)(void*)tazE_loadImage - (char*)(void*)tazE_saveImage;
+    return span << 16 ^ sizeof(EngineFull) ^ (ulongest)sizeof(tazR_TVal) << 56;
+}
+
+static unsigned hashObjPtr( tazR_Obj* obj ) {
+    uintptr_t u = (uintptr_t)obj >> 4;
+    return u ^ u >> 17;
+}
+
+static ImageSlot* findSlot( tazE_Image* img, tazR_Obj* obj ) {
+    unsigned i = hashObjPtr( obj ) & (img->slotCap - 1);
+    while( img->slots[i].obj && img->slots[i].obj != obj )
+        i = (i + 1) & (img->slotCap - 1);
+    return &img->slots[i];
+}
+
+// Objects that can't be saved would leave dangling references in the
+// image, so they fail it up front.
+static bool canSaveObj( tazR_Obj* obj ) {
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_FIB:
+            return false;
+        case tazR_Type_STATE:
+        {
+            tazR_State* state = tazR_getObjData( obj );
+            return state->save && state->load;
+        }
+        default:
+            return true;
+    }
+}
+
+#ifndef tazR_saveIdx
+    #define tazR_saveIdx( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_saveRec
+    #define tazR_saveRec( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_saveCode
+    #define tazR_saveCode( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_saveFun
+    #define tazR_saveFun( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_saveUpv
+    #define tazR_saveUpv( ENG, IMG, OBJ )
+#endif
+
+static void saveObj( EngineFull* eng, tazE_Image* img, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_IDX:
+            tazR_saveIdx( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_REC:
+            tazR_saveRec( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_CODE:
+            tazR_saveCode( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_FUN:
+            tazR_saveFun( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_UPV:
+            tazR_saveUpv( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_STATE:
+            tazE_saveHook( (tazE_Engine*)eng, img, (tazE_Hook)((tazR_State*)data)->load );
+            ((tazR_State*)data)->save( (tazE_Engine*)eng, data, img );
+        break;
+        default:
+            assert( false );
+        break;
     }
-    
-    // Scan.
-    for( unsigned i = 0 ; i < taz_ErrNum_LAST ; i++ )
-        tazE_markVal( &eng->view, eng->errvals[i] );
+}
 
-    if( eng->view.envState )
-        tazE_markObj( (tazE_Engine*)eng, eng->view.envState );
-    if( eng->view.apiState )
-        tazE_markObj( (tazE_Engine*)eng, eng->view.apiState );
-    if( eng->view.fiber )
-        tazE_markObj( (tazE_Engine*)eng, eng->view.fiber );
+#ifndef tazR_loadIdx
+    #define tazR_loadIdx( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_loadRec
+    #define tazR_loadRec( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_loadCode
+    #define tazR_loadCode( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_loadFun
+    #define tazR_loadFun( ENG, IMG, OBJ )
+#endif
+#ifndef tazR_loadUpv
+    #define tazR_loadUpv( ENG, IMG, OBJ )
+#endif
+
+typedef void (*StateLoad)( tazE_Engine* eng, tazR_State* self, tazE_Image* img );
+
+static void loadObj( EngineFull* eng, tazE_Image* img, tazR_Obj* obj ) {
+    void* data = tazR_getObjData( obj );
+    switch( tazR_getObjType( obj ) ) {
+        case tazR_Type_IDX:
+            tazR_loadIdx( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_REC:
+            tazR_loadRec( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_CODE:
+            tazR_loadCode( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_FUN:
+            tazR_loadFun( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_UPV:
+            tazR_loadUpv( (tazE_Engine*)eng, img, data );
+        break;
+        case tazR_Type_STATE: {
+            StateLoad load = (StateLoad)tazE_loadHook( (tazE_Engine*)eng, img );
+            load( (tazE_Engine*)eng, data, img );
+        } break;
+        default:
+            tazE_error( (tazE_Engine*)eng, taz_ErrNum_OTHER );
+        break;
+    }
+}
+
+static void saveByte( tazE_Image* img, uchar b ) {
+    img->sum = (img->sum ^ b)*IMAGE_SUM_PRIME;
+    if( !img->failed && !img->writer->write( img->writer, (char)b ) )
+        img->failed = true;
+}
+
+static uchar loadByte( tazE_Image* img ) {
+    if( img->pos >= img->len )
+        tazE_error( img->eng, taz_ErrNum_OTHER );
+    return img->buf[img->pos++];
+}
+
+static void saveStrs( EngineFull* eng, tazE_Image* img ) {
+    StrPool* pool = eng->strPool;
+    ulongest num  = 0;
+    for( size_t i = 0 ; i < pool->ncap ; i++ ) {
+        for( unsigned u = pool->bmap[i] ; u ; u &= u - 1 )
+            num++;
+    }
+    tazE_saveWord( &eng->view, img, num );
+    tazE_saveWord( &eng->view, img, pool->ncap*elemsof(pool->nmap[0]) );
     
-    tazE_Barrier* barIt = eng->barriers;
-    while( barIt ) {
-        tazE_Barrier* bar = barIt;
-        barIt = barIt->prev;
-        
-        tazE_Bucket* bucIt = bar->buckets;
-        while( bucIt ) {
-            tazE_Bucket* buc = bucIt;
-            bucIt = bucIt->next;
+    for( size_t i = 0 ; i < pool->ncap ; i++ ) {
+        for( unsigned j = 0 ; j < elemsof(pool->nmap[i]) ; j++ ) {
+            StrNode* node = pool->nmap[i][j];
+            if( !node )
+                continue;
             
-            void* ptr = (void*)buc + FIRST_BUCKET_OFFSET;
-            for( unsigned i = 0 ; i < buc->size ; i++, ptr += NEXT_BUCKET_OFFSET ) {
-                tazR_TVal* val = ptr;
-                tazE_markVal( (tazE_Engine*)eng, *val );
+            size_t      len;
+            char const* str;
+            if( node->large ) {
+                len = ((StrNodeLong*)node)->len;
+                str = ((StrNodeLong*)node)->buf;
+            }
+            else {
+                len = ((StrNodeMedium*)node)->len;
+                str = ((StrNodeMedium*)node)->buf;
             }
+            tazE_saveWord( &eng->view, img, node->id );
+            tazE_saveWord( &eng->view, img, len );
+            tazE_saveBytes( &eng->view, img, str, len );
         }
+    }
+}
+
+// Interned strings are made again in the loading engine, which will
+// likely give them different IDs; so `strs` maps the old IDs over.
+static void loadStrs( EngineFull* eng, tazE_Image* img, tazE_RawAnchor* strsA ) {
+    ulongest num   = tazE_loadWord( &eng->view, img );
+    ulongest maxId = tazE_loadWord( &eng->view, img );
+    if( num > maxId || maxId > img->len )
+        tazE_error( &eng->view, taz_ErrNum_OTHER );
+    
+    img->strs    = tazE_zallocRaw( &eng->view, strsA, sizeof(tazR_Str)*maxId );
+    img->numStrs = maxId;
+    for( ulongest i = 0 ; i < num ; i++ ) {
+        ulongest id  = tazE_loadWord( &eng->view, img );
+        ulongest len = tazE_loadWord( &eng->view, img );
+        if( id >= maxId || len > img->len - img->pos )
+            tazE_error( &eng->view, taz_ErrNum_OTHER );
         
-        tazE_markVal( (tazE_Engine*)eng, bar->errval );
+        img->strs[id] = tazE_makeStr( &eng->view, (char const*)img->buf + img->pos, len );
+        img->pos += len;
+    }
+}
+
+/**************************** Allocation Sampling *****************************/
+
+// Each distinct stack is kept once, as its folded text, in a chained
+// hash table; along with the bytes attributed to it.  Sampled objects
+// are tagged and listed in `objs`, so the live profile can be worked
+// out at the end of each cycle; they're taken off the list when they
+// are released.
+typedef struct SampleStack SampleStack;
+typedef struct Sample      Sample;
+
+struct SampleStack {
+    SampleStack* next;
+    unsigned     hash;
+    ulongest     allocBytes;
+    ulongest     liveBytes;
+    size_t       len;
+    char         text[];
+};
+
+struct Sample {
+    tazR_Obj*    obj;
+    SampleStack* stack;
+    ulongest     weight;
+};
+
+struct Sampler {
+    size_t   interval;
+    longest  left;
+    ulongest seed;
+    
+    SampleStack** stacks;
+    unsigned      stackCap;
+    unsigned      stackCount;
+    
+    Sample*  objs;
+    unsigned objTop;
+    unsigned objCap;
+};
+
+#define SAMPLE_FRAME_NAME_MAX (64)
+#define SAMPLE_TEXT_MAX       (taz_CONFIG_ALLOC_SAMPLE_DEPTH*(SAMPLE_FRAME_NAME_MAX + 24))
+
+#ifndef tazR_sampleFib
+    #define tazR_sampleFib( ENG, FIB, FRAMES, MAX ) 0
+#endif
+
+// Picks the number of bytes until the next sample, uniformly between
+// half and one and a half times the interval.
+static size_t nextSampleGap( Sampler* sampler ) {
+    ulongest x = sampler->seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sampler->seed = x;
+    return sampler->interval/2 + x % sampler->interval + 1;
+}
+
+// Copies out a string's characters without allocating, so it can be
+// done in the middle of an allocation.
+static size_t copyStr( EngineFull* eng, tazR_Str str, char* buf, size_t cap ) {
+    tazR_Str type = str & STR_TYPE_MASK;
+    if( type == STR_SHORT ) {
+        size_t len = (str & STR_SIZE_MASK) >> STR_SIZE_SHIFT;
+        for( size_t i = len ; i > 0 ; i-- ) {
+            if( i - 1 < cap )
+                buf[i - 1] = str & 0xFF;
+            str >>= 8;
+        }
+        return len < cap ? len : cap;
+    }
+    
+    tazR_Str     id   = str & ~STR_TYPE_MASK & ~STR_SIZE_MASK;
+    StrNode*     node = getStrNode( (tazE_Engine*)eng, eng->strPool, id );
+    char const*  chrs;
+    size_t       len;
+    if( node->large ) {
+        chrs = ((StrNodeLong*)node)->buf;
+        len  = ((StrNodeLong*)node)->len;
+    }
+    else {
+        chrs = ((StrNodeMedium*)node)->buf;
+        len  = ((StrNodeMedium*)node)->len;
+    }
+    if( len > cap )
+        len = cap;
+    memcpy( buf, chrs, len );
+    return len;
+}
+
+static size_t foldStack( EngineFull* eng, char* buf ) {
+    tazE_Frame frames[taz_CONFIG_ALLOC_SAMPLE_DEPTH];
+    unsigned   n = tazR_sampleFib( (tazE_Engine*)eng, eng->view.fiber, frames, elemsof(frames) );
+    if( n == 0 ) {
+        memcpy( buf, "[host]", 6 );
+        return 6;
+    }
+    
+    size_t len = 0;
+    for( unsigned i = n ; i > 0 ; i-- ) {
+        tazE_Frame* frame = &frames[i - 1];
+        if( i < n )
+            buf[len++] = ';';
+        
+        size_t nlen = copyStr( eng, frame->name, buf + len, SAMPLE_FRAME_NAME_MAX );
+        if( nlen == 0 )
+            buf[len + nlen++] = '?';
+        len += nlen;
+        
+        if( frame->offset >= 0 )
+            len += sprintf( buf + len, "+%ld", frame->offset );
+    }
+    return len;
+}
+
+static unsigned hashText( char const* text, size_t len ) {
+    unsigned hash = 2166136261u;
+    for( size_t i = 0 ; i < len ; i++ )
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    return hash;
+}
+
+static bool growStacks( EngineFull* eng, Sampler* sampler ) {
+    unsigned      ncap    = sampler->stackCap*2;
+    SampleStack** nstacks = sysAlloc( eng, NULL, 0, sizeof(SampleStack*)*ncap );
+    if( !nstacks )
+        return false;
+    
+    for( unsigned i = 0 ; i < ncap ; i++ )
+        nstacks[i] = NULL;
+    for( unsigned i = 0 ; i < sampler->stackCap ; i++ ) {
+        SampleStack* it = sampler->stacks[i];
+        while( it ) {
+            SampleStack* next = it->next;
+            it->next = nstacks[it->hash & (ncap - 1)];
+            nstacks[it->hash & (ncap - 1)] = it;
+            it = next;
+        }
+    }
+    
+    sysAlloc( eng, sampler->stacks, sizeof(SampleStack*)*sampler->stackCap, 0 );
+    eng->memUsed += sizeof(SampleStack*)*(ncap - sampler->stackCap);
+    sampler->stacks   = nstacks;
+    sampler->stackCap = ncap;
+    return true;
+}
+
+// Finds or adds the entry for the current stack, returns NULL if
+// there's no memory for a new one; in which case the sample is lost.
+static SampleStack* internStack( EngineFull* eng, Sampler* sampler ) {
+    char     text[SAMPLE_TEXT_MAX];
+    size_t   len  = foldStack( eng, text );
+    unsigned hash = hashText( text, len );
+    
+    SampleStack** slot = &sampler->stacks[hash & (sampler->stackCap - 1)];
+    for( SampleStack* it = *slot ; it ; it = it->next ) {
+        if( it->hash == hash && it->len == len && !memcmp( it->text, text, len ) )
+            return it;
+    }
+    
+    SampleStack* stack = sysAlloc( eng, NULL, 0, sizeof(SampleStack) + len );
+    if( !stack )
+        return NULL;
+    eng->memUsed += sizeof(SampleStack) + len;
+    
+    stack->next       = *slot;
+    stack->hash       = hash;
+    stack->allocBytes = 0;
+    stack->liveBytes  = 0;
+    stack->len        = len;
+    memcpy( stack->text, text, len );
+    *slot = stack;
+    
+    if( ++sampler->stackCount > sampler->stackCap )
+        growStacks( eng, sampler );
+    return stack;
+}
+
+// Counts an allocation of `sz` bytes against the sampling interval,
+// taking a sample if it's used up; `obj` is the object allocated, or
+// NULL for raw buffers.  Allocations larger than the interval may stand
+// in for several samples' worth of bytes.
+static void sampleAlloc( EngineFull* eng, size_t sz, tazR_Obj* obj ) {
+    Sampler* sampler = eng->sampler;
+    sampler->left -= sz;
+    if( sampler->left >= 0 )
+        return;
+    
+    ulongest weight = 0;
+    while( sampler->left < 0 ) {
+        weight += sampler->interval;
+        sampler->left += nextSampleGap( sampler );
+    }
+    
+    SampleStack* stack = internStack( eng, sampler );
+    if( !stack )
+        return;
+    stack->allocBytes += weight;
+    
+    if( !obj )
+        return;
+    if( sampler->objTop == sampler->objCap ) {
+        void* buf = sampler->objs;
+        if( !growSideBuf( eng, &buf, &sampler->objCap, sizeof(Sample) ) )
+            return;
+        sampler->objs = buf;
+    }
+    sampler->objs[sampler->objTop++] = (Sample){ obj, stack, weight };
+    obj->next_and_tag = tazR_makeTPtr(
+        tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_SAMP_MASK,
+        tazR_getPtrAddr( obj->next_and_tag )
+    );
+}
+
+static void dropSample( EngineFull* eng, tazR_Obj* obj ) {
+    Sampler* sampler = eng->sampler;
+    if( !sampler )
+        return;
+    
+    for( unsigned i = 0 ; i < sampler->objTop ; i++ ) {
+        if( sampler->objs[i].obj == obj ) {
+            sampler->objs[i] = sampler->objs[--sampler->objTop];
+            return;
+        }
+    }
+}
+
+// Called once marking is done, old objects are taken to be alive in
+// minor cycles since they weren't traced.
+static void updateLiveSamples( EngineFull* eng ) {
+    Sampler* sampler = eng->sampler;
+    for( unsigned i = 0 ; i < sampler->stackCap ; i++ ) {
+        for( SampleStack* it = sampler->stacks[i] ; it ; it = it->next )
+            it->liveBytes = 0;
+    }
+    
+    for( unsigned i = 0 ; i < sampler->objTop ; i++ ) {
+        Sample*   sample = &sampler->objs[i];
+        tazR_Obj* obj    = sample->obj;
+        if( isObjMarked( obj ) || (!eng->isFullCycle && tazR_isObjOld( obj )) )
+            sample->stack->liveBytes += sample->weight;
+    }
+}
+
+static void freeSampler( EngineFull* eng, Sampler* sampler ) {
+    for( unsigned i = 0 ; i < sampler->stackCap ; i++ ) {
+        SampleStack* it = sampler->stacks[i];
+        while( it ) {
+            SampleStack* next = it->next;
+            eng->memUsed -= sizeof(SampleStack) + it->len;
+            sysAlloc( eng, it, sizeof(SampleStack) + it->len, 0 );
+            it = next;
+        }
+    }
+    sysAlloc( eng, sampler->stacks, sizeof(SampleStack*)*sampler->stackCap, 0 );
+    eng->memUsed -= sizeof(SampleStack*)*sampler->stackCap;
+    
+    freeSideBuf( eng, sampler->objs, sampler->objCap, sizeof(Sample) );
+    sysAlloc( eng, sampler, sizeof(Sampler), 0 );
+    eng->memUsed -= sizeof(Sampler);
+}
+
+/******************************* Engine Pools *********************************/
+
+// Idle engines are kept in a fixed array, guarded by a spin lock since
+// it's only held to push or pop one; making, warming, resetting, and
+// freeing engines are all done outside of it.
+struct tazE_Pool {
+    taz_Config  cfg;
+    unsigned    keep;
+    tazE_WarmCb warm;
+    void*       data;
+    
+    bool         lock;
+    unsigned     size;
+    unsigned     top;
+    tazE_Engine* idle[];
+};
+
+static void lockPool( tazE_Pool* pool ) {
+    while( __atomic_test_and_set( &pool->lock, __ATOMIC_ACQUIRE ) )
+        sched_yield();
+}
+
+static void unlockPool( tazE_Pool* pool ) {
+    __atomic_clear( &pool->lock, __ATOMIC_RELEASE );
+}
+
+static tazE_Engine* makeWarmEngine( tazE_Pool* pool ) {
+    tazE_Engine* eng = tazE_makeEngine( &pool->cfg );
+    if( eng && pool->warm && !pool->warm( pool->data, eng ) ) {
+        tazE_freeEngine( eng );
+        return NULL;
+    }
+    return eng;
+}
+
+/*************************** API Functions ************************************/
+
+tazE_Engine* tazE_makeEngine( taz_Config const* cfg ) {
+    taz_MemCb   alloc = cfg->alloc;
+    ArenaChunk* arena = NULL;
+    EngineFull* eng;
+    
+    // An arena engine lives at the start of its first chunk.
+    if( cfg->arenaChunkSize ) {
+        size_t esz = arenaRound( sizeof(EngineFull) );
+        arena = makeArenaChunk( alloc, cfg->arenaChunkSize > esz ? cfg->arenaChunkSize : esz );
+        if( !arena )
+            return NULL;
+        eng = (EngineFull*)arena->bump;
+        arena->bump += esz;
+    }
+    else {
+        eng = alloc( NULL, 0, sizeof(EngineFull) );
+        if( !eng )
+            return NULL;
+    }
+    
+    eng->view.envState = NULL;
+    eng->view.apiState = NULL;
+    eng->view.fiber    = NULL;
+    eng->alloc         = alloc;
+    eng->arena         = arena;
+    eng->arenaChunkSize = cfg->arenaChunkSize;
+    eng->scratch       = NULL;
+    eng->scratchSpare  = NULL;
+    eng->barriers      = NULL;
+    eng->objects       = NULL;
+    eng->nursery       = NULL;
+    eng->sweepPrev     = NULL;
+    eng->sweepNext     = NULL;
+    eng->heapEmpty     = NULL;
+    eng->heapChunks    = NULL;
+    for( unsigned i = 0 ; i < NUM_SIZE_CLASSES ; i++ )
+        eng->heapAvail[i] = NULL;
+    for( unsigned i = 0 ; i < NUM_SIZE_CLASSES ; i++ )
+        eng->rawAvail[i] = NULL;
+    eng->rawPages      = cfg->gcCompact && !arena;
+    eng->compactDue    = false;
+    eng->loans         = NULL;
+    eng->heapDump      = NULL;
+    eng->sampler       = NULL;
+    eng->isGCRunning   = false;
+    eng->isFullCycle   = false;
+    eng->nGCCycles     = 0;
+    memset( &eng->stats, 0, sizeof(eng->stats) );
+    memset( eng->ownedTally, 0, sizeof(eng->ownedTally) );
+    eng->cycleMarkTime = 0;
+    eng->oldSize       = 0;
+    eng->oldGrowth     = 0;
+    eng->gcPhase       = GCPhase_IDLE;
+    eng->gcStepSize    = cfg->gcStepSize;
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        eng->gcMarkThreads = cfg->gcMarkThreads;
+        eng->gcMarkIdle    = 0;
+        eng->gcMarkWorkers = NULL;
+    #endif
+    eng->memUsed       = sizeof(EngineFull);
+    eng->memTarget     = cfg->gcHeapTarget ? cfg->gcHeapTarget : taz_CONFIG_GC_HEAP_TARGET;
+    eng->memLimit      = eng->memTarget;
+    eng->memGrowth     = cfg->gcHeapGrowth > 0.0 ? cfg->gcHeapGrowth : taz_CONFIG_GC_HEAP_GROWTH;
+    eng->memSoftLimit  = cfg->memSoftLimit ? cfg->memSoftLimit : SIZE_MAX;
+    eng->memHardLimit  = cfg->memHardLimit ? cfg->memHardLimit : SIZE_MAX;
+    eng->gcFullInterval = cfg->gcFullInterval ? cfg->gcFullInterval : taz_CONFIG_GC_FULL_CYCLE_INTERVAL;
+    eng->gcFullMinAlloc = cfg->gcFullMinAlloc ? cfg->gcFullMinAlloc : taz_CONFIG_GC_FULL_MIN_ALLOC;
+    eng->sinceFull      = 0;
+    eng->onPressure    = cfg->onPressure;
+    eng->pressureData  = cfg->pressureData;
+    eng->inPressure    = false;
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE || taz_CONFIG_ENABLE_PAGE_RELEASE
+        eng->osPageSize     = sysconf( _SC_PAGESIZE );
+    #endif
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        eng->largeMin       = arena ? SIZE_MAX : taz_CONFIG_LARGE_OBJECT_SIZE;
+        eng->largeUsed      = 0;
+        eng->largeSpare     = NULL;
+        eng->largeSpareSize = 0;
+    #endif
+    eng->gcStack       = (MarkStack){ NULL, NULL };
+    eng->gcReserveUsed = false;
+    eng->gcStackOverflow = false;
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        eng->gcMarkAllocLock = false;
+    #endif
+    eng->gcDisabled    = true;
+    eng->gcKeepStrs    = false;
+    eng->frozen        = false;
+    eng->finlQueue     = NULL;
+    eng->finlPending   = 0;
+    eng->deferFinl     = cfg->gcDeferFinalizers;
+    #if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+        eng->freeThread = cfg->gcFreeThread && !arena ? makeFreeThread( alloc ) : NULL;
+        eng->freeBatch  = NULL;
+    #endif
+    eng->remSetTop     = 0;
+    eng->remSetCap     = 0;
+    eng->remSetBuf     = NULL;
+    eng->remSetOverflow = false;
+    eng->weakTop       = 0;
+    eng->weakCap       = 0;
+    eng->weakBuf       = NULL;
+    
+    // This should come last, as it relies on the engine being
+    // semi-functional.
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) ) {
+        eng->strPool = NULL;
+        tazE_freeEngine( (tazE_Engine*)eng );
+        return NULL;
+    }
+    
+    tazE_pushBarrier( (tazE_Engine*)eng, &bar );
+    
+    EngineFull* shared = (EngineFull*)cfg->shared;
+    assert( !shared || shared->frozen );
+    eng->strPool = makeStrPool( (tazE_Engine*)eng, shared ? shared->strPool : NULL );
+
+    // These rely on string pool functionality, so must come
+    // after the previous segment.
+    for( unsigned i = 0 ; i < taz_ErrNum_LAST ; i++ )
+        eng->errvals[i] = tazR_udf;
+    
+    #define ERRVAL( WHICH, STR ) \
+        eng->errvals[WHICH] = tazR_strVal( tazE_makeStr( &eng->view, STR, sizeof(STR)-1 ) )
+    ERRVAL( taz_ErrNum_MEMORY, "Memory management error" );
+    ERRVAL( taz_ErrNum_KEY_TYPE, "Invalid type used for record key" );
+    ERRVAL( taz_ErrNum_NUM_LOCALS, "Local variable limit exceeded in function" );
+    ERRVAL( taz_ErrNum_NUM_UPVALS, "Upvalue limit exceeded in function" );
+    ERRVAL( taz_ErrNum_NUM_CONSTS, "Constant value limit exceeded in function" );
+    ERRVAL( taz_ErrNum_PARAM_NAME, "Invalid parameter name" );
+    ERRVAL( taz_ErrNum_UPVAL_NAME, "Invalid upvalue name" );
+    ERRVAL( taz_ErrNum_EXTRA_PARAMS, "Extra parameters given after ellipsis" );
+    ERRVAL( taz_ErrNum_SET_TO_UDF, "Attempt to set record field or variable from `udf` value" );
+    ERRVAL( taz_ErrNum_SET_UNDEFINED, "Attempt to set undefined variable or record field" );
+    ERRVAL( taz_ErrNum_FORMAT_SPEC, "Invalid format specifier" );
+    ERRVAL( taz_ErrNum_CYCLIC_RECORD, "Illegal cyclic record operation" );
+    ERRVAL( taz_ErrNum_TOO_MANY_RETURNS, "Too many return values" );
+    ERRVAL( taz_ErrNum_TOO_FEW_RETURNS, "Too few return values" );
+    ERRVAL( taz_ErrNum_HEAP_LIMIT, "Heap limit exceeded" );
+
+    tazE_popBarrier( (tazE_Engine*)eng, &bar );
+    eng->gcDisabled = cfg->gcDisabled;
+
+    return (tazE_Engine*)eng;
+}
+
+void tazE_freeEngine( tazE_Engine* _eng ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    // Everything in an arena engine, the engine included, lives in its
+    // chunks; so there's nothing to finalize or unlink.
+    if( eng->arena ) {
+        freeArena( eng->alloc, eng->arena );
+        return;
+    }
+    
+    // These should come first, as they rely on having a functional engine.
+    tazE_runFinalizers( _eng, 0 );
+    if( eng->strPool )
+        freeStrPool( _eng, eng->strPool );
+    tazE_stopSampling( _eng );
+    
+    // Now cleanup everything else.
+    tazR_Obj* lists[] = { eng->nursery, eng->objects };
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        tazR_Obj* objIter = lists[i];
+        while( objIter ) {
+            tazR_Obj* obj = objIter;
+            objIter = tazR_getObjNext( obj );
+            
+            destructObj( eng, obj );
+        }
+    }
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        tazR_Obj* objIter = lists[i];
+        while( objIter ) {
+            tazR_Obj* obj = objIter;
+            objIter = tazR_getObjNext( obj );
+            
+            releaseObj( eng, obj );
+        }
+    }
+    
+    // Raw memory can be in the heap pages, so these have to be cleared
+    // before it's freed.
+    while( eng->barriers ) {
+        clearBarrier( eng, eng->barriers );
+        eng->barriers = eng->barriers->prev;
     }
+    freeSideBuf( eng, eng->remSetBuf, eng->remSetCap, sizeof(tazR_Obj*) );
+    freeSideBuf( eng, eng->weakBuf, eng->weakCap, sizeof(tazR_Obj*) );
+    freeHeap( eng );
+    freeMarkStack( eng, &eng->gcStack );
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        freeMarkWorkers( eng );
+    #endif
+    
+    freeArena( eng->alloc, eng->scratch );
+    freeArena( eng->alloc, eng->scratchSpare );
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        freeLargeSpare( eng );
+    #endif
+    #if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+        freeFreeThread( eng );
+    #endif
+    
+    sysAlloc( eng, eng, sizeof(EngineFull), 0 );
+}
 
-    while( eng->gcStackTop > 0 )
-        scanObj( eng, eng->gcStackBuf[--eng->gcStackTop], eng->isFullCycle );
+void tazE_markObj( tazE_Engine* _eng, void* ptr ) {
+    EngineFull* eng = (EngineFull*)_eng;
     
-    // Sweep.
-    tazR_Obj* alive = NULL;
-    tazR_Obj* dead  = NULL;
+    tazR_Obj* obj = tazR_toObj( ptr );
     
-    tazR_Obj* it = eng->objects;
-    while( it ) {
-        tazR_Obj* obj = it;
-        it = tazR_getPtrAddr( it->next_and_tag );
-        
-        if( tazR_isObjMarked( obj ) ) {
-            obj->next_and_tag = tazR_makeTPtr(
-                tazR_getPtrTag( obj->next_and_tag ) & ~tazR_OBJ_TAG_MARK_MASK,
-                alive
-            );
-            alive = obj;
-        }
-        else {
-            destructObj( eng, obj );
-            obj->next_and_tag = tazR_makeTPtr(
-                tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_DEAD_MASK,
-                dead
-            );
-            dead = obj;
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        if( currWorker ) {
+            markShared( currWorker, obj );
+            return;
         }
+    #endif
+    
+    if( eng->heapDump ) {
+        dumpRef( eng->heapDump, (ulongest)(uintptr_t)obj );
+        return;
     }
+    if( tazR_isObjOld( obj ) && !eng->isFullCycle )
+        return;
+    if( setObjMark( obj ) )
+        return;
     
-    it = dead;
-    while( it ) {
-        tazR_Obj* obj = it;
-        it = tazR_getPtrAddr( it->next_and_tag );
-        
-        releaseObj( eng, obj );
+    if( !pushGray( eng, &eng->gcStack, obj ) )
+        eng->gcStackOverflow = true;
+}
+
+void tazE_markStr( tazE_Engine* eng, tazR_Str str ) {
+    tazR_Str type = str & STR_TYPE_MASK;
+    if( type == STR_SHORT )
+        return;
+    if( ((EngineFull*)eng)->heapDump ) {
+        dumpRef( ((EngineFull*)eng)->heapDump, DUMP_STR_FLAG | (str & ~STR_TYPE_MASK) );
+        return;
     }
+    if( !((EngineFull*)eng)->isFullCycle )
+        return;
     
-    eng->objects = alive;
+    StrPool* pool = ((EngineFull*)eng)->strPool;
+    tazR_Str id   = str & ~STR_TYPE_MASK;
+    assert( getStrNode( eng, pool, id ) );
     
-    // Finish up.
-    adjustHeap( eng, nsz );
+    // Shared strings are never collected.
+    if( id < pool->base )
+        return;
+    id -= pool->base;
     
-    eng->isGCRunning = false;
+    unsigned* unit = &pool->gmap[id / sizeof(unsigned)];
+    unsigned  bit  = 1U << (id % sizeof(unsigned));
     
-    if( eng->isFullCycle ) {
-        eng->isFullCycle = false;
-        finishStringGC( (tazE_Engine*)eng );
-    }
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        if( currWorker ) {
+            __atomic_fetch_or( unit, bit, __ATOMIC_RELAXED );
+            return;
+        }
+    #endif
+    
+    *unit |= bit;
 }
 
-/**************************** String Pooling **********************************/
-
+bool tazE_markWeak( tazE_Engine* _eng, void* ptr ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    // Dumps list every reference.
+    if( eng->heapDump )
+        return false;
+    
+    // Marking threads share the buffer, along with the allocator.
+    lockMarkAlloc( eng );
+    if( eng->weakTop >= eng->weakCap ) {
+        void* buf = eng->weakBuf;
+        if( !growSideBuf( eng, &buf, &eng->weakCap, sizeof(tazR_Obj*) ) ) {
+            unlockMarkAlloc( eng );
+            return false;
+        }
+        eng->weakBuf = buf;
+    }
+    eng->weakBuf[eng->weakTop++] = tazR_toObj( ptr );
+    unlockMarkAlloc( eng );
+    return true;
+}
 
-typedef struct StrNode       StrNode;
-typedef struct StrNodeLong  StrNodeLong;
-typedef struct StrNodeMedium StrNodeMedium;
+bool tazE_isValMarked( tazE_Engine* _eng, tazR_TVal val ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    tazR_Type type = tazR_getValType( val );
+    if( type <= tazR_Type_LAST_ATOMIC )
+        return true;
+    
+    // Only interned strings are collected, and only in full cycles; the
+    // same goes for old objects.
+    if( type == tazR_Type_STR ) {
+        tazR_Str str = tazR_getValStr( val );
+        if( (str & STR_TYPE_MASK) == STR_SHORT || !eng->isFullCycle )
+            return true;
+        
+        tazR_Str id = str & ~STR_TYPE_MASK;
+        if( id < eng->strPool->base )
+            return true;
+        id -= eng->strPool->base;
+        return (eng->strPool->gmap[id / sizeof(unsigned)] & (1U << (id % sizeof(unsigned)))) != 0;
+    }
+    
+    tazR_Obj* obj = tazR_toObj( tazR_getValObj( val ) );
+    if( tazR_isObjOld( obj ) && !eng->isFullCycle )
+        return true;
+    return isObjMarked( obj );
+}
 
-struct StrNode {
-    unsigned  hash  : 30;
-    unsigned  mark  : 1;
-    unsigned  large : 1;
-    unsigned  id;
-};
+void tazE_collect( tazE_Engine* eng, bool full ) {
+    collect( (EngineFull*)eng, 0, full );
+}
 
-struct StrNodeLong {
-    StrNode base;
-    size_t  len;
-    char    buf[];
-};
+void tazE_compact( tazE_Engine* _eng ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    assert( !eng->barriers );
+    if( !eng->rawPages )
+        return;
+    
+    collect( eng, 0, true );
+    tazE_runFinalizers( _eng, 0 );
+    compactRaw( eng );
+}
 
-struct StrNodeMedium {
-    StrNode  base;
+void* tazE_moveRaw( tazE_Engine* _eng, void* raw, size_t sz ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    if( !isRawCell( eng, sz ) )
+        return raw;
     
-    StrNodeMedium*  next;
-    StrNodeMedium** link;
+    HeapPage* page = pageOf( raw );
+    if( !page->evac )
+        return raw;
     
-    size_t len;
-    char   buf[];
-};
-
-typedef StrNode* StrNodeBlock[sizeof(unsigned)];
+    // Buffers are only moved into pages already in use, a fresh one
+    // would be no denser than the one being evacuated.  Failing to
+    // move isn't an error, the buffer just stays put.
+    void* cell = takeUsedCell( eng, page->cls, true );
+    if( !cell )
+        return raw;
+    
+    memcpy( cell, raw, sz );
+    eng->stats.bytesCompacted += classSizeTable[page->cls];
+    giveCell( eng, raw );
+    return cell;
+}
 
-struct StrPool {
+unsigned tazE_runFinalizers( tazE_Engine* _eng, unsigned max ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    if( !eng->finlQueue )
+        return 0;
     
-    // This part makes up the hashmap used for interning medium
-    // length strings.
-    unsigned        hcap;
-    unsigned        hcnt;
-    StrNodeMedium** hmap;
+    // Finalizers are still run as part of the GC, as far as the rest
+    // of the engine is concerned; so they can't allocate, and what they
+    // free goes to the helper thread.
+    bool running = eng->isGCRunning;
+    eng->isGCRunning = true;
     
-    // This keeps a direct mapping from string handles to nodes,
-    // it's used for both medium and long strings.
-    size_t        ncap;
-    StrNodeBlock* nmap;
+    size_t   used = eng->memUsed;
+    unsigned n    = 0;
+    while( eng->finlQueue && (max == 0 || n < max) ) {
+        tazR_Obj* obj = eng->finlQueue;
+        eng->finlQueue = tazR_getObjNext( obj );
+        
+        destructObj( eng, obj );
+        releaseObj( eng, obj );
+        n++;
+    }
+    flushFrees( eng );
+    eng->finlPending      -= n;
+    eng->stats.bytesFreed += used - eng->memUsed;
     
-    // This is a bitmap to keep track of which slots in nmap are
-    // being used and which are free.  It'll always have the
-    // same capacity as nmap.
-    unsigned* bmap;
-};
+    eng->isGCRunning = running;
+    return n;
+}
 
-static StrPool* makeStrPool( tazE_Engine* eng ) {
-    tazE_RawAnchor poolA, hmapA, nmapA, bmapA;
+bool tazE_dumpHeap( tazE_Engine* _eng, taz_Writer* writer ) {
+    EngineFull* eng = (EngineFull*)_eng;
     
-    unsigned        hcap = 21;
-    StrNodeMedium** hmap = tazE_zallocRaw( eng, &hmapA, sizeof(StrNodeMedium*)*hcap );
+    // Only live objects are dumped, and the ones left to be swept lazily
+    // may already have been destructed; so collect everything first.
+    collect( eng, 0, true );
     
-    unsigned      ncap = 1;
-    StrNodeBlock* nmap = tazE_zallocRaw( eng, &nmapA, sizeof(StrNodeBlock)*ncap );
-    unsigned*     bmap = tazE_zallocRaw( eng, &bmapA, sizeof(unsigned)*ncap );
+    HeapDump dump = { .writer = writer, .failed = false };
+    eng->heapDump    = &dump;
+    eng->isGCRunning = true;
     
-    StrPool* pool = tazE_mallocRaw( eng, &poolA, sizeof(StrPool) );
-    pool->hcap   = hcap;
-    pool->hcnt   = 0;
-    pool->hmap   = hmap;
-    pool->ncap   = ncap;
-    pool->nmap   = nmap;
-    pool->bmap   = bmap;
+    char const magic[] = "TAZHEAP";
+    for( unsigned i = 0 ; i < sizeof(magic) - 1 ; i++ )
+        dumpWord( &dump, magic[i], 1 );
+    dumpWord( &dump, 1, 1 );
     
-    tazE_commitRaw( eng, &poolA );
-    tazE_commitRaw( eng, &hmapA );
-    tazE_commitRaw( eng, &nmapA );
-    tazE_commitRaw( eng, &bmapA );
-    return pool;
+    dumpWord( &dump, 'R', 1 );
+    markRoots( eng );
+    dumpRef( &dump, 0 );
+    
+    tazR_Obj* lists[] = { eng->nursery, eng->objects };
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) )
+            dumpObj( eng, &dump, obj );
+    }
+    dumpStrs( eng, &dump );
+    dumpWord( &dump, 'E', 1 );
+    
+    eng->heapDump    = NULL;
+    eng->isGCRunning = false;
+    return !dump.failed;
 }
 
-static void freeStrPool( tazE_Engine* eng, StrPool* pool ) {
-    for( unsigned i = 0 ; i < pool->ncap ; i++ ) {
-        for( unsigned j = 0 ; j < elemsof( pool->nmap[i] ) ; j++ ) {
-            StrNode* node = pool->nmap[i][j];
-            if( node ) {
-                if( node->large ) {
-                    StrNodeLong* nodeL = (StrNodeLong*)node;
-                    tazE_freeRaw( eng, pool->nmap[i][j], sizeof(StrNodeLong) + nodeL->len + 1 );
-                }
-                else {
-                    StrNodeMedium* nodeM = (StrNodeMedium*)node;
-                    tazE_freeRaw( eng, pool->nmap[i][j], sizeof(StrNodeMedium) + nodeM->len + 1 );
-                }
-            }
+bool tazE_saveImage( tazE_Engine* _eng, taz_Writer* writer ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    // References into a shared engine have nowhere to go in the image.
+    if( eng->strPool->shared )
+        return false;
+    collect( eng, 0, true );
+    
+    tazR_Obj* lists[] = { eng->nursery, eng->objects };
+    ulongest  num     = 0;
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+            if( !canSaveObj( obj ) )
+                return false;
+            num++;
         }
     }
     
-    tazE_freeRaw( eng, pool->hmap, sizeof(StrNodeMedium*)*pool->hcap );
-    tazE_freeRaw( eng, pool->nmap, sizeof(StrNodeBlock)*pool->ncap );
-    tazE_freeRaw( eng, pool->bmap, sizeof(unsigned)*pool->ncap );
-    tazE_freeRaw( eng, pool, sizeof(StrPool) );
-}
-
-/* Note: String Format
-Strings can be either short, medium, or long; and are represented in a integral
-type (tazR_Str) differently depending on the type.  The topmost byte of the
-6 bytes the string is allowed to use (only 6 since the top 2 are used for value
-meta data) is reserved for string meta data.  The topmost two bits indicate the
-string type.  If the type matches STR_SHORT then the rest of the bits give the
-short string's size (the number of bytes it uses), any unused bytes (at the lower
-end of the integral) must be zero.  If for other string types the rest of the
-meta bits should be cleared.
-*/
-
-#define STR_SIZE_MASK  (0x3FLLU << 40)
-#define STR_SIZE_SHIFT (40)
-#define STR_TYPE_MASK  (0x3LLU << 46)
-#define STR_SHORT      (0x0LLU << 46)
-#define STR_MEDIUM     (0x1LLU << 46)
-#define STR_LONG       (0x2LLU << 46)
-
-#define SHORT_STR_MAX_LEN  (5)
-#define MEDIUM_STR_MAX_LEN (16)
-
-static tazR_Str makeShortStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
-    tazR_Str ss = 0;
-    for( unsigned i = 0 ; i < len ; i++ )
-        ss = (ss << 8) | str[i];
+    unsigned cap = 16;
+    while( cap < 2*num )
+        cap *= 2;
+    ImageSlot* slots = sysAlloc( eng, NULL, 0, sizeof(ImageSlot)*cap );
+    if( !slots )
+        return false;
+    memset( slots, 0, sizeof(ImageSlot)*cap );
+    eng->memUsed += sizeof(ImageSlot)*cap;
     
-    ss |= STR_SHORT | (len << STR_SIZE_SHIFT);
-    return ss;
-}
-
-static tazR_Str makeStrId( tazE_Engine* eng, StrPool* pool ) {
-    for( unsigned i = 0 ; i < pool->ncap ; i++ ) {
-        
-        unsigned unit = pool->bmap[i];
-        
-        // This checks if the full unit of spaces if occupied.
-        if(  unit ^ UINT_MAX )
-            continue;
-        
-        for( unsigned j = 0 ; j < sizeof(unsigned) ; j++ ) {
-            
-            // If the next byte doens't have any empty bits.
-            if( (unit & 0xFF) == 0xFF ) {
-                unit >>= 8;
-                continue;
-            }
-            
-            for( unsigned k = 0 ; k < 8 ; k++ ) {
-                if( unit & 0x1 ) {
-                    unit >>= 1;
-                    continue;
-                }
-                
-                unsigned arrayOffset = i;
-                unsigned bitOffset   = j*8 + k;
-                pool->bmap[arrayOffset] |= 1U << bitOffset;
-                return arrayOffset*sizeof(unsigned) + bitOffset;
-            }
+    tazE_Image img = {
+        .eng     = _eng,
+        .sum     = IMAGE_SUM_BASIS,
+        .writer  = writer,
+        .failed  = false,
+        .slots   = slots,
+        .slotCap = cap
+    };
+    
+    ulongest ref = 0;
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+            ImageSlot* slot = findSlot( &img, obj );
+            slot->obj = obj;
+            slot->ref = ++ref;
         }
     }
     
-    // Couldn't find a place for the new string, so grow the pool.
-    unsigned        id   = pool->ncap * sizeof(unsigned);
-    unsigned        ncap = pool->ncap + 1;
-    tazE_RawAnchor  nmapA = { .raw = pool->nmap, .sz = sizeof(StrNodeBlock)*pool->ncap };
-    tazE_RawAnchor  bmapA = { .raw = pool->bmap, .sz = sizeof(unsigned)*pool->ncap };
+    tazE_saveBytes( _eng, &img, IMAGE_MAGIC, sizeof(IMAGE_MAGIC) - 1 );
+    saveByte( &img, IMAGE_VERSION );
+    tazE_saveWord( _eng, &img, imageFingerprint() );
+    saveStrs( eng, &img );
     
-    pool->nmap = tazE_reallocRaw( eng, &nmapA, sizeof(StrNodeBlock)*ncap );
-    pool->bmap = tazE_reallocRaw( eng, &bmapA, sizeof(unsigned)*ncap );
-    memset( pool->nmap[pool->ncap], 0, sizeof(StrNodeBlock) );
-    pool->bmap[pool->ncap] = 0;
+    // The objects are listed first, so they can all be allocated
+    // before any references to them are loaded.
+    tazE_saveWord( _eng, &img, num );
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+            tazE_saveWord( _eng, &img, tazR_getObjType( obj ) );
+            tazE_saveWord( _eng, &img, sizeofObj( eng, obj ) - sizeof(tazR_Obj) );
+        }
+    }
     
-    pool->bmap[pool->ncap] |= 1;
-    pool->ncap = ncap;
+    // Then the code, which is loaded first, and everything else.
+    for( unsigned pass = 0 ; pass < 2 ; pass++ ) {
+        for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+            for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+                if( (tazR_getObjType( obj ) == tazR_Type_CODE) == (pass == 0) )
+                    saveObj( eng, &img, obj );
+            }
+        }
+    }
+    tazE_saveRef( _eng, &img, eng->view.envState );
+    tazE_saveRef( _eng, &img, eng->view.apiState );
+    tazE_saveWord( _eng, &img, img.sum );
     
-    tazE_commitRaw( eng, &nmapA );
-    tazE_commitRaw( eng, &bmapA );
-    return id;
-}
-
-static unsigned hash( char const* str, size_t len ) {
-    unsigned h = 0;
-    for( unsigned i = 0 ; i < len && i < 16 ; i++ )
-        h = h*37 + str[i];
-    return h;
+    sysAlloc( eng, slots, sizeof(ImageSlot)*cap, 0 );
+    eng->memUsed -= sizeof(ImageSlot)*cap;
+    return !img.failed;
 }
 
-static tazR_Str makeMediumStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
-    unsigned h = hash( str, len ) >> 2;
-    unsigned i = h % pool->hcap;
-    StrNodeMedium* it = pool->hmap[i];
-    while( it ) {
-        if( it->len == len && it->base.hash == h && !memcmp( it->buf, str, len ) )
-            return it->base.id | STR_MEDIUM;
-        it = it->next;
-    }
+// Objects are committed as soon as they're loaded, so if loading fails
+// partway the finished ones are finalized with the engine, and the rest
+// are just released.  Functions look at their code when they're sized
+// or finalized, so the code is all loaded first; that way a committed
+// function never points at code that was released.  The GC is held off
+// until everything is in place.
+tazE_Engine* tazE_loadImage( taz_Config const* cfg, void const* buf, size_t len ) {
+    uchar const* bytes = buf;
+    size_t const head  = sizeof(IMAGE_MAGIC) - 1 + 1;
+    if( len < head + 8 || memcmp( bytes, IMAGE_MAGIC, head - 1 ) || bytes[head - 1] != IMAGE_VERSION )
+        return NULL;
     
-    tazR_Str id = makeStrId( eng, pool );
+    ulongest sum    = IMAGE_SUM_BASIS;
+    ulongest stored = 0;
+    for( size_t i = 0 ; i < len - 8 ; i++ )
+        sum = (sum ^ bytes[i])*IMAGE_SUM_PRIME;
+    for( unsigned i = 0 ; i < 8 ; i++ )
+        stored |= (ulongest)bytes[len - 8 + i] << i*8;
+    if( sum != stored )
+        return NULL;
     
-    unsigned  arrayOffset = id / sizeof(unsigned);
-    unsigned  blockOffset = id % sizeof(unsigned);
-    StrNode** place       = &pool->nmap[arrayOffset][blockOffset];
+    tazE_Engine* eng = tazE_makeEngine( cfg );
+    if( !eng )
+        return NULL;
     
-    tazE_RawAnchor nodeA;
-    StrNodeMedium* node = tazE_mallocRaw( eng, &nodeA, sizeof(StrNodeMedium) + len + 1 );
-    node->base.hash  = h;
-    node->base.mark  = 0;
-    node->base.large = 0;
-    node->base.id    = id;
-    node->len = len;
-    memcpy( node->buf, str, len + 1 );
+    EngineFull* full = (EngineFull*)eng;
+    tazE_Image  img  = { .eng = eng, .buf = bytes, .len = len - 8, .pos = head };
     
-    *place = (StrNode*)node;
-    tazR_linkWithNextAndLink( &pool->hmap[i], node );
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) ) {
+        tazE_freeEngine( eng );
+        return NULL;
+    }
+    tazE_pushBarrier( eng, &bar );
     
-    tazE_commitRaw( eng, &nodeA );
-    return id | STR_MEDIUM;
-}
-
-static tazR_Str makeLongStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
-    tazR_Str id = makeStrId( eng, pool );
+    bool disabled = full->gcDisabled;
+    full->gcDisabled = true;
     
-    unsigned  arrayOffset = id / sizeof(unsigned);
-    unsigned  blockOffset = id % sizeof(unsigned);
-    StrNode** place       = &pool->nmap[arrayOffset][blockOffset];
+    if( tazE_loadWord( eng, &img ) != imageFingerprint() )
+        tazE_error( eng, taz_ErrNum_OTHER );
     
-    tazE_RawAnchor nodeA;
-    StrNodeLong* node = tazE_mallocRaw( eng, &nodeA, sizeof(StrNodeLong) + len + 1 );
-    node->base.hash  = hash( str, len ) >> 2;
-    node->base.mark  = 0;
-    node->base.large = 1;
-    node->base.id    = id;
-    node->len = len;
-    memcpy( node->buf, str, len + 1 );
+    tazE_RawAnchor strsA, objsA, ancsA;
+    loadStrs( full, &img, &strsA );
     
-    *place = (StrNode*)node;
+    ulongest num = tazE_loadWord( eng, &img );
+    if( num > img.len )
+        tazE_error( eng, taz_ErrNum_OTHER );
     
-    tazE_commitRaw( eng, &nodeA );
+    img.objs    = tazE_mallocRaw( eng, &objsA, sizeof(tazR_Obj*)*num );
+    img.numObjs = num;
+    tazE_ObjAnchor* ancs = tazE_mallocRaw( eng, &ancsA, sizeof(tazE_ObjAnchor)*num );
+    for( ulongest i = 0 ; i < num ; i++ ) {
+        ulongest type = tazE_loadWord( eng, &img );
+        ulongest size = tazE_loadWord( eng, &img );
+        if( type < tazR_Type_FIRST_OBJECT || type > tazR_Type_LAST_OBJECT || type == tazR_Type_FIB || size > SIZE_MAX/2 )
+            tazE_error( eng, taz_ErrNum_OTHER );
+        
+        img.objs[i] = tazR_toObj( tazE_mallocObj( eng, &ancs[i], size, type ) );
+    }
+    for( unsigned pass = 0 ; pass < 2 ; pass++ ) {
+        for( ulongest i = 0 ; i < num ; i++ ) {
+            if( (tazR_getObjType( img.objs[i] ) == tazR_Type_CODE) != (pass == 0) )
+                continue;
+            
+            img.objSize = ancs[i].sz - sizeof(tazR_Obj);
+            loadObj( full, &img, img.objs[i] );
+            tazE_commitObj( eng, &ancs[i] );
+        }
+    }
+    eng->envState = tazE_loadRef( eng, &img );
+    eng->apiState = tazE_loadRef( eng, &img );
+    if( img.pos != img.len )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    tazE_cancelRaw( eng, &ancsA );
+    tazE_cancelRaw( eng, &objsA );
+    tazE_cancelRaw( eng, &strsA );
+    tazE_popBarrier( eng, &bar );
     
-    return id | STR_LONG;
+    full->gcDisabled = disabled;
+    return eng;
 }
 
-static tazR_Str makeStr( tazE_Engine* eng, StrPool* pool, char const* str, size_t len ) {
-    if( len <= SHORT_STR_MAX_LEN )
-        return makeShortStr( eng, pool, str, len );
-    if( len <= MEDIUM_STR_MAX_LEN )
-        return makeMediumStr( eng, pool, str, len );
-    
-    return makeLongStr( eng, pool, str, len );
+#if taz_CONFIG_ENABLE_IMAGE_MAPPING
+    tazE_Engine* tazE_mapImage( taz_Config const* cfg, char const* path ) {
+        int fd = open( path, O_RDONLY );
+        if( fd < 0 )
+            return NULL;
+        
+        struct stat st;
+        void*       map = MAP_FAILED;
+        if( !fstat( fd, &st ) && st.st_size > 0 )
+            map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        close( fd );
+        if( map == MAP_FAILED )
+            return NULL;
+        
+        tazE_Engine* eng = tazE_loadImage( cfg, map, st.st_size );
+        munmap( map, st.st_size );
+        return eng;
+    }
+#endif
+
+void tazE_saveWord( tazE_Engine* eng, tazE_Image* img, ulongest word ) {
+    for( unsigned i = 0 ; i < 8 ; i++ )
+        saveByte( img, word >> i*8 );
 }
 
-static StrNode* getStrNode( tazE_Engine* eng, StrPool* pool, tazR_Str id ) {
-    unsigned  arrayOffset = id / sizeof(unsigned);
-    unsigned  blockOffset = id % sizeof(unsigned);
-    return pool->nmap[arrayOffset][blockOffset];
+void tazE_saveBytes( tazE_Engine* eng, tazE_Image* img, void const* buf, size_t len ) {
+    for( size_t i = 0 ; i < len ; i++ )
+        saveByte( img, ((uchar const*)buf)[i] );
 }
 
-static void borrowShortStr( tazE_Engine* eng, StrPool* pool, tazR_Str s, taz_StrLoan* loan ) {
-    size_t len = (s & STR_SIZE_MASK) >> STR_SIZE_SHIFT;
-    
-    tazE_RawAnchor strA;
-    char*  str = tazE_mallocRaw( eng, &strA, len + 1 );
-    size_t end = len;
-    str[end--] = '\0';
-    for( unsigned i = 0 ; i < len ; i++ ) {
-        str[end--] = s & 0xFF;
-        s >>= 8;
+void tazE_saveRef( tazE_Engine* eng, tazE_Image* img, void const* ptr ) {
+    if( !ptr ) {
+        tazE_saveWord( eng, img, 0 );
+        return;
     }
     
-    loan->next = NULL;
-    loan->link = NULL;
-    loan->str  = str;
-    loan->len  = len;
-    
-    tazE_commitRaw( eng, &strA );
+    ImageSlot* slot = findSlot( img, tazR_toObj( ptr ) );
+    assert( slot->obj );
+    tazE_saveWord( eng, img, slot->ref );
 }
 
-static void borrowLongStr( tazE_Engine* eng, StrPool* pool, tazR_Str id, taz_StrLoan* loan ) {
-    StrNodeLong* node = (StrNodeLong*)getStrNode( eng, pool, id );
-    assert( node );
+void tazE_saveStr( tazE_Engine* eng, tazE_Image* img, tazR_Str str ) {
+    tazE_saveWord( eng, img, str );
+}
+
+void tazE_saveVal( tazE_Engine* eng, tazE_Image* img, tazR_TVal val ) {
+    tazR_Type type = tazR_getValType( val );
+    tazE_saveWord( eng, img, type );
+    if( type == tazR_Type_STR )
+        tazE_saveStr( eng, img, tazR_getValStr( val ) );
+    else
+    if( type >= tazR_Type_FIRST_OBJECT )
+        tazE_saveRef( eng, img, tazR_getValObj( val ) );
+    else
+        #if taz_CONFIG_DISABLE_NAN_TAGGING
+            tazE_saveWord( eng, img, val.u.u );
+        #else
+            tazE_saveWord( eng, img, val.u );
+        #endif
+}
+
+void tazE_saveHook( tazE_Engine* eng, tazE_Image* img, tazE_Hook hook ) {
+    tazE_saveWord( eng, img, hook ? (char*)(void*)hook - (char*)(void*)tazE_saveImage : 0 );
+}
+
+ulongest tazE_loadWord( tazE_Engine* eng, tazE_Image* img ) {
+    ulongest word = 0;
+    for( unsigned i = 0 ; i < 8 ; i++ )
+        word |= (ulongest)loadByte( img ) << i*8;
+    return word;
+}
+
+void tazE_loadBytes( tazE_Engine* eng, tazE_Image* img, void* buf, size_t len ) {
+    if( len > img->len - img->pos )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    memcpy( buf, img->buf + img->pos, len );
+    img->pos += len;
+}
+
+void* tazE_loadRef( tazE_Engine* eng, tazE_Image* img ) {
+    ulongest ref = tazE_loadWord( eng, img );
+    if( ref == 0 )
+        return NULL;
+    if( ref > img->numObjs )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    return tazR_getObjData( img->objs[ref - 1] );
+}
+
+tazR_Str tazE_loadStr( tazE_Engine* eng, tazE_Image* img ) {
+    tazR_Str str = tazE_loadWord( eng, img );
+    if( (str & STR_TYPE_MASK) == STR_SHORT )
+        return str;
     
-    tazR_linkWithNextAndLink( &((EngineFull*)eng)->loans, loan );
-    loan->len = node->len;
-    loan->str = node->buf;
+    ulongest id = str & ~STR_TYPE_MASK;
+    if( id >= img->numStrs || !img->strs[id] )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    return img->strs[id];
 }
 
-static void borrowMediumStr( tazE_Engine* eng, StrPool* pool, tazR_Str id, taz_StrLoan* loan ) {
-    StrNodeMedium* node = (StrNodeMedium*)getStrNode( eng, pool, id );
-    assert( node );
+tazR_TVal tazE_loadVal( tazE_Engine* eng, tazE_Image* img ) {
+    tazR_Type type = tazE_loadWord( eng, img );
+    if( type == tazR_Type_STR )
+        return tazR_strVal( tazE_loadStr( eng, img ) );
+    if( type >= tazR_Type_FIRST_OBJECT && type <= tazR_Type_LAST_OBJECT )
+        return tazR_othVal( type, tazE_loadRef( eng, img ) );
     
-    tazR_linkWithNextAndLink( &((EngineFull*)eng)->loans, loan );
-    loan->len = node->len;
-    loan->str = node->buf;
+    tazR_TVal val;
+    #if taz_CONFIG_DISABLE_NAN_TAGGING
+        val.tag = type;
+        val.u.u = tazE_loadWord( eng, img );
+    #else
+        val.u = tazE_loadWord( eng, img );
+    #endif
+    return val;
 }
 
+size_t tazE_loadSize( tazE_Engine* eng, tazE_Image* img ) {
+    return img->objSize;
+}
 
-static void startStringGC( tazE_Engine* _eng ) {
-    EngineFull* eng = (EngineFull*)_eng;
-    
-    // Copy out all the loaned strings.
-    taz_StrLoan* loanIt = eng->loans;
-    while( loanIt ) {
-        tazE_stealStr( _eng, loanIt );
-        loanIt = loanIt->next;
-    }
-    eng->loans = NULL;
+tazE_Hook tazE_loadHook( tazE_Engine* eng, tazE_Image* img ) {
+    ulongest off = tazE_loadWord( eng, img );
+    if( off == 0 )
+        return NULL;
+    return (tazE_Hook)(void*)((char*)(void*)tazE_saveImage + (ptrdiff_t)off);
 }
 
-static void collectNode( tazE_Engine* eng, StrPool* pool, StrNode* node ) {
-    unsigned arrayOffset = node->id / sizeof(unsigned);
-    unsigned blockOffset = node->id % sizeof(unsigned);
-    pool->nmap[arrayOffset][blockOffset] = NULL;
-    pool->bmap[arrayOffset] &= ~(1 << blockOffset);
+// This is a full cycle run from just the roots being kept, so anything
+// else is released as garbage would be; including by its finalizer.
+void tazE_resetEngine( tazE_Engine* _eng, unsigned keep ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    assert( !eng->barriers && !eng->loans && !eng->frozen );
     
-    if( node->large ) {
-        StrNodeLong* nodeL = (StrNodeLong*)node;
-        tazE_freeRaw( eng, nodeL, sizeof(StrNodeLong) + nodeL->len + 1 );
+    eng->view.fiber    = NULL;
+    eng->view.apiState = NULL;
+    if( !(keep & tazE_Keep_ENV) )
+        eng->view.envState = NULL;
+    
+    bool disabled = eng->gcDisabled;
+    eng->gcDisabled = false;
+    
+    // A cycle in progress may have marked objects that are now being
+    // dropped, so it's finished before ours is started.
+    if( eng->gcPhase == GCPhase_MARK ) {
+        eng->isGCRunning = true;
+        finishCycle( eng, 0 );
     }
-    else {
-        StrNodeMedium* nodeM = (StrNodeMedium*)node;
-        tazR_unlinkWithNextAndLink( nodeM );
-        tazE_freeRaw( eng, nodeM, sizeof(StrNodeMedium) + nodeM->len + 1 );
+    finishSweep( eng );
+    
+    eng->isGCRunning = true;
+    startCycle( eng, true );
+    if( keep & tazE_Keep_CODE ) {
+        tazR_Obj* lists[] = { eng->nursery, eng->objects };
+        for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+            for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+                if( tazR_getObjType( obj ) == tazR_Type_CODE )
+                    tazE_markObj( _eng, tazR_getObjData( obj ) );
+            }
+        }
     }
+    eng->gcKeepStrs = (keep & tazE_Keep_STRS) != 0;
+    finishCycle( eng, 0 );
+    finishSweep( eng );
+    tazE_runFinalizers( _eng, 0 );
+    
+    eng->gcKeepStrs = false;
+    eng->gcDisabled = disabled;
 }
 
-static void finishStringGC( tazE_Engine* _eng ) {
-    EngineFull* eng  = (EngineFull*)_eng;
-    StrPool*    pool = eng->strPool;
+tazE_Pool* tazE_makePool( taz_Config const* cfg, unsigned size, unsigned keep, tazE_WarmCb warm, void* data ) {
+    tazE_Pool* pool = cfg->alloc( NULL, 0, sizeof(tazE_Pool) + sizeof(tazE_Engine*)*size );
+    if( !pool )
+        return NULL;
     
-    // Figure out how many blocks we actually need to scan.
-    unsigned end = pool->ncap;
-    while( end > 0 && pool->bmap[end-1] == 0 )
-        end--;
+    pool->cfg  = *cfg;
+    pool->keep = keep;
+    pool->warm = warm;
+    pool->data = data;
+    pool->lock = false;
+    pool->size = size;
+    pool->top  = 0;
     
-    for( unsigned i = 0 ; i < end ; i++ ) {
-        for( unsigned j = 0 ; j < elemsof(pool->nmap[i]) ; j++ ) {
-            StrNode* node = pool->nmap[i][j];
-            if( !node )
-                continue;
-            if( node && node->mark == 0 )
-                collectNode( _eng, pool, node );
-            else
-                node->mark = 0;
+    while( pool->top < size ) {
+        tazE_Engine* eng = makeWarmEngine( pool );
+        if( !eng ) {
+            tazE_freePool( pool );
+            return NULL;
         }
+        pool->idle[pool->top++] = eng;
     }
+    return pool;
 }
 
-/*************************** API Functions ************************************/
+void tazE_freePool( tazE_Pool* pool ) {
+    for( unsigned i = 0 ; i < pool->top ; i++ )
+        tazE_freeEngine( pool->idle[i] );
+    pool->cfg.alloc( pool, sizeof(tazE_Pool) + sizeof(tazE_Engine*)*pool->size, 0 );
+}
 
-tazE_Engine* tazE_makeEngine( taz_Config const* cfg ) {
-    taz_MemCb   alloc = cfg->alloc;
-    EngineFull* eng   = alloc( NULL, 0, sizeof(EngineFull) );
+tazE_Engine* tazE_takeEngine( tazE_Pool* pool ) {
+    lockPool( pool );
+    tazE_Engine* eng = pool->top > 0 ? pool->idle[--pool->top] : NULL;
+    unlockPool( pool );
     
-    eng->view.envState = NULL;
-    eng->view.apiState = NULL;
-    eng->view.fiber    = NULL;
-    eng->alloc         = alloc;
-    eng->barriers      = NULL;
-    eng->objects       = NULL;
-    eng->loans         = NULL;
-    eng->isGCRunning   = false;
-    eng->isFullCycle   = false;
-    eng->nGCCycles     = 0;
-    eng->memUsed       = sizeof(EngineFull);
-    eng->memLimit      = 1024;
-    eng->memGrowth     = 0.5;
-    eng->gcStackTop    = 0;
-    eng->gcStackBuf    = eng->gcFirstStackBuf;
-    eng->gcDisabled    = true;
+    if( !eng )
+        eng = makeWarmEngine( pool );
+    return eng;
+}
+
+void tazE_giveEngine( tazE_Pool* pool, tazE_Engine* eng ) {
+    tazE_resetEngine( eng, pool->keep );
     
-    // This should come last, as it relies on the engine being
-    // semi-functional.
-    tazE_Barrier bar = { 0 };
-    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) ) {
-        eng->strPool = NULL;
-        tazE_freeEngine( (tazE_Engine*)eng );
-        return NULL;
+    lockPool( pool );
+    if( pool->top < pool->size ) {
+        pool->idle[pool->top++] = eng;
+        eng = NULL;
     }
+    unlockPool( pool );
     
-    tazE_pushBarrier( (tazE_Engine*)eng, &bar );
-    eng->strPool = makeStrPool( (tazE_Engine*)eng );
+    if( eng )
+        tazE_freeEngine( eng );
+}
 
-    // These rely on string pool functionality, so must come
-    // after the previous segment.
-    for( unsigned i = 0 ; i < taz_ErrNum_LAST ; i++ )
-        eng->errvals[i] = tazR_udf;
+// Everything that survives a full cycle is marked and promoted for good,
+// so sharing engines take it as live and old without writing to it; and
+// with the GC off the marks are never cleared.  The handle given out is
+// just the engine itself, it only keeps the type out of `taz.h`.
+taz_Shared* tazE_freezeEngine( tazE_Engine* _eng ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    assert( !eng->barriers && !eng->loans && !eng->frozen );
     
-    #define ERRVAL( WHICH, STR ) \
-        eng->errvals[WHICH] = tazR_strVal( tazE_makeStr( &eng->view, STR, sizeof(STR)-1 ) )
-    ERRVAL( taz_ErrNum_MEMORY, "Memory management error" );
-    ERRVAL( taz_ErrNum_KEY_TYPE, "Invalid type used for record key" );
-    ERRVAL( taz_ErrNum_NUM_LOCALS, "Local variable limit exceeded in function" );
-    ERRVAL( taz_ErrNum_NUM_UPVALS, "Upvalue limit exceeded in function" );
-    ERRVAL( taz_ErrNum_NUM_CONSTS, "Constant value limit exceeded in function" );
-    ERRVAL( taz_ErrNum_PARAM_NAME, "Invalid parameter name" );
-    ERRVAL( taz_ErrNum_UPVAL_NAME, "Invalid upvalue name" );
-    ERRVAL( taz_ErrNum_EXTRA_PARAMS, "Extra parameters given after ellipsis" );
-    ERRVAL( taz_ErrNum_SET_TO_UDF, "Attempt to set record field or variable from `udf` value" );
-    ERRVAL( taz_ErrNum_SET_UNDEFINED, "Attempt to set undefined variable or record field" );
-    ERRVAL( taz_ErrNum_FORMAT_SPEC, "Invalid format specifier" );
-    ERRVAL( taz_ErrNum_CYCLIC_RECORD, "Illegal cyclic record operation" );
-    ERRVAL( taz_ErrNum_TOO_MANY_RETURNS, "Too many return values" );
-    ERRVAL( taz_ErrNum_TOO_FEW_RETURNS, "Too few return values" );
-
-    tazE_popBarrier( (tazE_Engine*)eng, &bar );
     eng->gcDisabled = false;
-
-    return (tazE_Engine*)eng;
+    collect( eng, 0, true );
+    eng->gcDisabled = true;
+    
+    tazR_Obj* lists[] = { eng->nursery, eng->objects };
+    for( unsigned i = 0 ; i < elemsof(lists) ; i++ ) {
+        for( tazR_Obj* obj = lists[i] ; obj ; obj = tazR_getObjNext( obj ) ) {
+            setObjMark( obj );
+            obj->next_and_tag = tazR_makeTPtr(
+                tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_OLD_MASK,
+                tazR_getObjNext( obj )
+            );
+        }
+    }
+    eng->frozen = true;
+    return (taz_Shared*)eng;
 }
 
-void tazE_freeEngine( tazE_Engine* _eng ) {
+bool tazE_startSampling( tazE_Engine* _eng, size_t interval ) {
     EngineFull* eng = (EngineFull*)_eng;
+    assert( interval > 0 );
     
-    // This should come first, as it relies on having a functional engine.
-    if( eng->strPool )
-        freeStrPool( _eng, eng->strPool );
+    tazE_stopSampling( _eng );
     
-    // Now cleanup everything else.
-    tazR_Obj* objIter = eng->objects;
-    while( objIter ) {
-        tazR_Obj* obj = objIter;
-        objIter = tazR_getObjNext( obj );
-        
-        destructObj( eng, obj );
-    }
-    objIter = eng->objects;
-    while( objIter ) {
-        tazR_Obj* obj = objIter;
-        objIter = tazR_getObjNext( obj );
-        
-        releaseObj( eng, obj );
-    }
+    Sampler* sampler = sysAlloc( eng, NULL, 0, sizeof(Sampler) );
+    if( !sampler )
+        return false;
     
-    while( eng->barriers ) {
-        clearBarrier( eng, eng->barriers );
-        eng->barriers = eng->barriers->prev;
+    unsigned      cap    = 64;
+    SampleStack** stacks = sysAlloc( eng, NULL, 0, sizeof(SampleStack*)*cap );
+    if( !stacks ) {
+        sysAlloc( eng, sampler, sizeof(Sampler), 0 );
+        return false;
     }
+    for( unsigned i = 0 ; i < cap ; i++ )
+        stacks[i] = NULL;
+    eng->memUsed += sizeof(Sampler) + sizeof(SampleStack*)*cap;
+    
+    sampler->interval   = interval;
+    sampler->seed       = 0x9E3779B97F4A7C15LLU ^ (uintptr_t)eng;
+    sampler->stacks     = stacks;
+    sampler->stackCap   = cap;
+    sampler->stackCount = 0;
+    sampler->objs       = NULL;
+    sampler->objTop     = 0;
+    sampler->objCap     = 0;
+    sampler->left       = nextSampleGap( sampler );
     
-    eng->alloc( eng, sizeof(EngineFull), 0 );
+    eng->sampler = sampler;
+    return true;
 }
 
-static void scanWithNewStack( EngineFull* eng, tazR_Obj* obj ) {
-    tazR_Obj** obuf = eng->gcStackBuf;
-    unsigned   otop = eng->gcStackTop;
-    
-    tazR_Obj* buf[taz_CONFIG_GC_STACK_SEGMENT_SIZE];
+void tazE_stopSampling( tazE_Engine* _eng ) {
+    EngineFull* eng     = (EngineFull*)_eng;
+    Sampler*    sampler = eng->sampler;
+    if( !sampler )
+        return;
     
-    eng->gcStackBuf = buf;
-    eng->gcStackTop = 0;
+    for( unsigned i = 0 ; i < sampler->objTop ; i++ ) {
+        tazR_Obj* obj = sampler->objs[i].obj;
+        obj->next_and_tag = tazR_makeTPtr(
+            tazR_getPtrTag( obj->next_and_tag ) & ~tazR_OBJ_TAG_SAMP_MASK,
+            tazR_getPtrAddr( obj->next_and_tag )
+        );
+    }
     
-    scanObj( eng, obj, eng->isFullCycle );
-    while( eng->gcStackTop > 0 )
-        scanObj( eng, eng->gcStackBuf[--eng->gcStackTop], eng->isFullCycle );
+    eng->sampler = NULL;
+    freeSampler( eng, sampler );
+}
+
+bool tazE_writeSamples( tazE_Engine* _eng, taz_Writer* writer, tazE_Profile which ) {
+    EngineFull* eng     = (EngineFull*)_eng;
+    Sampler*    sampler = eng->sampler;
+    if( !sampler )
+        return true;
     
-    eng->gcStackBuf = obuf;
-    eng->gcStackTop = otop;
+    for( unsigned i = 0 ; i < sampler->stackCap ; i++ ) {
+        for( SampleStack* it = sampler->stacks[i] ; it ; it = it->next ) {
+            ulongest bytes = which == tazE_Profile_ALLOC ? it->allocBytes : it->liveBytes;
+            if( bytes == 0 )
+                continue;
+            
+            char   num[24];
+            size_t len = sprintf( num, " %llu\n", bytes );
+            for( size_t j = 0 ; j < it->len ; j++ ) {
+                if( !writer->write( writer, it->text[j] ) )
+                    return false;
+            }
+            for( size_t j = 0 ; j < len ; j++ ) {
+                if( !writer->write( writer, num[j] ) )
+                    return false;
+            }
+        }
+    }
+    return true;
 }
 
-void tazE_markObj( tazE_Engine* _eng, void* ptr ) {
-    EngineFull* eng = (EngineFull*)_eng;
+void tazE_getStats( tazE_Engine* _eng, tazE_Stats* stats ) {
+    EngineFull* eng  = (EngineFull*)_eng;
+    StrPool*    pool = eng->strPool;
     
-    tazR_Obj* obj = tazR_toObj( ptr );
-    if( tazR_isObjMarked( obj ) )
-        return;
+    *stats = eng->stats;
+    stats->memUsed  = eng->memUsed;
+    stats->memLimit = eng->memLimit;
+    stats->finlPending = eng->finlPending;
     
-    obj->next_and_tag = tazR_makeTPtr(
-        tazR_getPtrTag( obj->next_and_tag ) | tazR_OBJ_TAG_MARK_MASK,
-        tazR_getPtrAddr( obj->next_and_tag )
-    );
-    if( eng->gcStackTop < taz_CONFIG_GC_STACK_SEGMENT_SIZE && eng->gcStackBuf != NULL ) {
-        eng->gcStackBuf[eng->gcStackTop++] = obj;
-        return;
+    stats->strCount = 0;
+    stats->strSlots = pool->ncap*elemsof(pool->nmap[0]);
+    stats->strBytes = 0;
+    for( size_t i = 0 ; i < pool->ncap ; i++ ) {
+        for( unsigned u = pool->bmap[i] ; u ; u &= u - 1 )
+            stats->strCount++;
+        for( unsigned j = 0 ; j < elemsof(pool->nmap[i]) ; j++ ) {
+            if( pool->nmap[i][j] )
+                stats->strBytes += sizeofStrNode( pool->nmap[i][j] );
+        }
     }
     
-    scanWithNewStack( eng, obj );
+    unsigned mask = pool->hcap - 1;
+    stats->strTableSlots = pool->hcap;
+    stats->strTableUsed  = pool->hcnt;
+    stats->strProbeTotal = 0;
+    stats->strProbeMax   = 0;
+    for( unsigned i = 0 ; i < pool->hcap ; i++ ) {
+        if( !pool->hmap[i] )
+            continue;
+        
+        size_t probes = ((i - strMapSlot( pool, pool->hmap[i]->base.hash )) & mask) + 1;
+        stats->strProbeTotal += probes;
+        if( probes > stats->strProbeMax )
+            stats->strProbeMax = probes;
+    }
 }
 
-void tazE_markStr( tazE_Engine* eng, tazR_Str str ) {
-    tazR_Str type = str & STR_TYPE_MASK;
-    if( type == STR_SHORT )
-        return;
-    
-    tazR_Str id   = str & ~STR_TYPE_MASK;
-    StrNode* node = getStrNode( eng, ((EngineFull*)eng)->strPool, id );
-    assert( node );
-    
-    node->mark = 1;
+size_t tazE_shallowSize( tazE_Engine* _eng, void* ptr ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    return footprintOf( eng, sizeofObj( eng, tazR_toObj( ptr ) ) );
 }
 
-void tazE_collect( tazE_Engine* eng, bool full ) {
-    collect( (EngineFull*)eng, 0, full );
+size_t tazE_deepSize( tazE_Engine* _eng, void* ptr ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    return tazE_shallowSize( _eng, ptr ) + ownedByObj( eng, tazR_toObj( ptr ) );
+}
+
+ulongest tazE_pauseBucketFloor( unsigned bucket ) {
+    unsigned const p = taz_CONFIG_GC_PAUSE_PRECISION;
+    if( bucket < 1U << p )
+        return bucket;
+    
+    unsigned e = (bucket >> p) + p - 1;
+    ulongest m = (bucket & ((1U << p) - 1)) | (1U << p);
+    return m << (e - p);
 }
 
 void* tazE_mallocObj( tazE_Engine* _eng, tazE_ObjAnchor* anchor, size_t sz, tazR_Type type ) {
     EngineFull* eng = (EngineFull*)_eng;
     
+    if( eng->gcPhase == GCPhase_SWEEP )
+        sweepSome( eng, taz_CONFIG_GC_SWEEP_STEP_SIZE );
+    
     size_t    osz = sizeof(tazR_Obj) + sz;
-    tazR_Obj* obj = mallocMem( eng,  osz );
-    obj->next_and_tag = tazR_makeTPtr(
-        (type << tazR_OBJ_TAG_TYPE_SHIFT) & tazR_OBJ_TAG_TYPE_MASK,
-        NULL
-    );
+    tazR_Obj* obj = mallocObjMem( eng, osz );
+    unsigned  tag = (type << tazR_OBJ_TAG_TYPE_SHIFT) & tazR_OBJ_TAG_TYPE_MASK;
+    if( sizeClassOf( osz ) != NO_CLASS )
+        tag |= tazR_OBJ_TAG_PAGE_MASK;
+    obj->next_and_tag = tazR_makeTPtr( tag, NULL );
+    
+    // Mark bits live apart from the cell, so make sure we don't inherit
+    // one from whatever occupied it before.
+    clearObjMark( obj );
     
     anchor->obj = obj;
     anchor->sz  = osz;
@@ -867,6 +4649,9 @@ void* tazE_mallocObj( tazE_Engine* _eng, tazE_ObjAnchor* anchor, size_t sz, tazR
     assert( eng->barriers );
     tazR_linkWithNextAndLink( &eng->barriers->objAnchors, anchor );
     
+    if( eng->sampler )
+        sampleAlloc( eng, osz, obj );
+    
     return tazR_getObjData( obj );
 }
 
@@ -878,7 +4663,9 @@ void* tazE_zallocObj( tazE_Engine* eng, tazE_ObjAnchor* anchor, size_t sz, tazR_
 
 void tazE_cancelObj( tazE_Engine* eng, tazE_ObjAnchor* anchor ) {
     tazR_unlinkWithNextAndLink( anchor );
-    freeMem( (EngineFull*)eng, anchor->obj, anchor->sz );
+    if( tazR_isObjSampled( anchor->obj ) )
+        dropSample( (EngineFull*)eng, anchor->obj );
+    freeObjMem( (EngineFull*)eng, anchor->obj, anchor->sz );
 }
 
 void  tazE_commitObj( tazE_Engine* _eng, tazE_ObjAnchor* anchor ) {
@@ -886,8 +4673,39 @@ void  tazE_commitObj( tazE_Engine* _eng, tazE_ObjAnchor* anchor ) {
     tazR_unlinkWithNextAndLink( anchor );
     
     tazR_Obj* obj = anchor->obj;
-    obj->next_and_tag = tazR_makeTPtr( tazR_getPtrTag( obj->next_and_tag ), eng->objects );
-    eng->objects = obj;
+    obj->next_and_tag = tazR_makeTPtr( tazR_getPtrTag( obj->next_and_tag ), eng->nursery );
+    eng->nursery = obj;
+    eng->stats.liveObjects[tazR_getObjType( obj )]++;
+    eng->stats.liveBytes[tazR_getObjType( obj )] += footprintOf( eng, anchor->sz );
+    
+    // Objects created while marking are allocated black, they'll
+    // survive the cycle either way.
+    if( eng->gcPhase == GCPhase_MARK )
+        tazE_markObj( _eng, tazR_getObjData( obj ) );
+}
+
+void _tazE_writeBarrier( tazE_Engine* _eng, void* ptr, tazR_TVal val ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    tazR_Obj* obj = tazR_toObj( ptr );
+    
+    // While marking incrementally a marked object may already have been
+    // scanned, we can't tell whether it has, so the new value is shaded
+    // either way.
+    if( eng->gcPhase == GCPhase_MARK && isObjMarked( obj ) )
+        tazE_markVal( _eng, val );
+    
+    if( !tazR_isObjOld( obj ) || tazR_isObjRemembered( obj ) )
+        return;
+    
+    // Strings are only collected in full cycles, so needn't be remembered.
+    if( tazR_getValType( val ) == tazR_Type_STR )
+        return;
+    if( tazR_isObjOld( tazR_toObj( tazR_getValObj( val ) ) ) )
+        return;
+    
+    if( !remember( eng, obj ) )
+        eng->remSetOverflow = true;
 }
 
 void* tazE_mallocRaw( tazE_Engine* _eng, tazE_RawAnchor* anchor, size_t sz ) {
@@ -899,18 +4717,63 @@ void* tazE_mallocRaw( tazE_Engine* _eng, tazE_RawAnchor* anchor, size_t sz ) {
     assert( eng->barriers );
     tazR_linkWithNextAndLink( &eng->barriers->rawAnchors, anchor );
     
+    if( eng->sampler )
+        sampleAlloc( eng, sz, NULL );
+    
     return ptr;
 }
 
 void* tazE_zallocRaw( tazE_Engine* eng, tazE_RawAnchor* anchor, size_t sz ) {
     void* ptr = tazE_mallocRaw( eng, anchor, sz );
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        if( isLarge( (EngineFull*)eng, sz ) )
+            return ptr;
+    #endif
     memset( ptr, 0, sz );
     return ptr;
 }
 
+void* tazE_scratchRaw( tazE_Engine* _eng, tazE_RawAnchor* anchor, size_t sz ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    assert( eng->barriers );
+    
+    // Arena engines bump everything anyway.
+    void* ptr = NULL;
+    if( sz <= SCRATCH_MAX && !eng->arena )
+        ptr = bumpScratch( eng, sz );
+    if( !ptr )
+        return tazE_mallocRaw( _eng, anchor, sz );
+    
+    anchor->raw  = ptr;
+    anchor->sz   = sz;
+    anchor->next = NULL;
+    anchor->link = &scratchLink;
+    return ptr;
+}
+
 void* tazE_reallocRaw( tazE_Engine* _eng, tazE_RawAnchor* anchor, size_t sz ) {
     EngineFull* eng = (EngineFull*)_eng;
     
+    // A scratch allocation stays in scratch memory if it can, growing in
+    // place if it's the last thing in the chunk.
+    if( isScratch( anchor ) ) {
+        ArenaChunk* chunk = eng->scratch;
+        char*       old   = anchor->raw;
+        size_t      osz   = anchor->sz;
+        if( old + arenaRound( osz ) == chunk->bump && arenaRound( sz ) <= (size_t)(chunk->end - old) ) {
+            chunk->bump = old + arenaRound( sz );
+            anchor->sz  = sz;
+            return old;
+        }
+        
+        void* ptr = tazE_scratchRaw( _eng, anchor, sz );
+        memcpy( ptr, old, osz < sz ? osz : sz );
+        return ptr;
+    }
+    
+    if( eng->sampler && sz > anchor->sz )
+        sampleAlloc( eng, sz - anchor->sz, NULL );
+    
     void* ptr = reallocMem( eng, anchor->raw, anchor->sz, sz );
     anchor->raw = ptr;
     anchor->sz  = sz;
@@ -927,12 +4790,35 @@ void tazE_freeRaw( tazE_Engine* eng, void* raw, size_t sz ) {
 void tazE_cancelRaw( tazE_Engine* _eng, tazE_RawAnchor* anchor ) {
     EngineFull* eng = (EngineFull*)_eng;
     
+    // The rest of the scratch memory goes when the barrier's cleared, but
+    // the last allocation can be given back now.
+    if( isScratch( anchor ) ) {
+        ArenaChunk* chunk = eng->scratch;
+        if( (char*)anchor->raw + arenaRound( anchor->sz ) == chunk->bump )
+            chunk->bump = anchor->raw;
+        return;
+    }
+    
     freeMem( eng, anchor->raw, anchor->sz );
     tazR_unlinkWithNextAndLink( anchor );
 }
 
-void tazE_commitRaw( tazE_Engine* eng, tazE_RawAnchor* anchor ) {
+void* tazE_commitRaw( tazE_Engine* _eng, tazE_RawAnchor* anchor ) {
+    EngineFull* eng = (EngineFull*)_eng;
+    
+    if( isScratch( anchor ) ) {
+        void* ptr = mallocMem( eng, anchor->sz );
+        memcpy( ptr, anchor->raw, anchor->sz );
+        if( eng->sampler )
+            sampleAlloc( eng, anchor->sz, NULL );
+        
+        anchor->raw  = ptr;
+        anchor->link = NULL;
+        return ptr;
+    }
+    
     tazR_unlinkWithNextAndLink( anchor );
+    return anchor->raw;
 }
 
 void tazE_addBucket( tazE_Engine* _eng, void* _buc, unsigned size ) {
@@ -966,6 +4852,15 @@ void tazE_pushBarrier( tazE_Engine* _eng, tazE_Barrier* barrier ) {
     barrier->buckets    = NULL;
     barrier->errnum     = taz_ErrNum_NONE;
     barrier->errval     = tazR_udf;
+    barrier->oneJump    = false;
+    
+    barrier->scratchChunk = eng->scratch;
+    barrier->scratchBump  = eng->scratch ? eng->scratch->bump : NULL;
+}
+
+void tazE_pushJumpBarrier( tazE_Engine* eng, tazE_Barrier* barrier ) {
+    tazE_pushBarrier( eng, barrier );
+    barrier->oneJump = true;
 }
 
 void tazE_popBarrier( tazE_Engine* _eng, tazE_Barrier* barrier ) {
@@ -974,6 +4869,13 @@ void tazE_popBarrier( tazE_Engine* _eng, tazE_Barrier* barrier ) {
     
     clearBarrier( eng, barrier );
     eng->barriers = eng->barriers->prev;
+    
+    // Control is going back to the host, so it's a good time to catch
+    // up on finalizers and compaction.
+    if( !eng->barriers && eng->finlQueue )
+        tazE_runFinalizers( _eng, 0 );
+    if( !eng->barriers && eng->compactDue )
+        compactRaw( eng );
 }
 
 void tazE_error( tazE_Engine* _eng, taz_ErrNum errnum ) {
@@ -991,6 +4893,8 @@ void tazE_error( tazE_Engine* _eng, taz_ErrNum errnum ) {
     
     if( bar->errorFun )
         bar->errorFun( _eng, bar );
+    if( bar->oneJump )
+        _tazE_longJump( bar->jumpDst );
     longjmp( bar->errorDst, 1 );
 }
 
@@ -1008,6 +4912,8 @@ void tazE_panic( tazE_Engine* _eng, tazR_TVal errval ) {
     
     if( bar->errorFun )
         bar->errorFun( _eng, bar );
+    if( bar->oneJump )
+        _tazE_longJump( bar->jumpDst );
     longjmp( bar->errorDst, 1 );
 }
 
@@ -1025,6 +4931,8 @@ void tazE_yield( tazE_Engine* _eng ) {
     
     if( bar->yieldFun )
         bar->yieldFun( _eng, bar );
+    if( bar->oneJump )
+        _tazE_longJump( bar->jumpDst );
     longjmp( bar->yieldDst, 1 );
 }
 
@@ -35,6 +35,71 @@ tazE_Engine* tazE_makeEngine( taz_Config const* cfg );
 void         tazE_freeEngine( tazE_Engine* eng );
 bool         tazE_testEngine( void );
 
+/* Note: Resetting and Pooling Engines
+Making an engine sets up its string pool and interns the error messages, and
+the host will usually go on to set up an environment and load some code; so an
+engine that's only needed briefly can be put back to use with
+`tazE_resetEngine()` instead.  This releases everything the engine holds
+except for what's asked to be kept:
+
+    tazE_Keep_ENV   the environment state, with its globals and whatever
+                    they reference
+    tazE_Keep_CODE  compiled code, with its constants and names
+    tazE_Keep_STRS  interned strings, even those no longer referenced
+
+What's kept is kept as it is, not as it was when the engine was made; so
+anything a request changed in the environment is still changed afterwards.
+The engine must be idle when it's reset, with no barriers or loans outstanding;
+the current fiber and API state are always dropped.
+
+A `tazE_Pool` keeps up to `size` idle engines, made from the same config and
+readied by the `warm` callback, so a request can take one in a few steps;
+when given back the engine is reset, keeping what `keep` says, and put back
+if there's room or freed otherwise.  Engines are only warmed once, so `keep`
+should cover whatever the callback sets up.  An engine is made and warmed on demand if
+there are none idle, and `tazE_takeEngine()` returns NULL if that fails.  The
+pool itself can be used from any thread, but the config's allocator must then
+be thread safe; and an engine may only be used by one thread at a time.
+*/
+
+typedef enum   tazE_Keep  tazE_Keep;
+typedef struct tazE_Pool  tazE_Pool;
+typedef bool (*tazE_WarmCb)( void* data, tazE_Engine* eng );
+
+enum tazE_Keep {
+    tazE_Keep_ENV  = 1 << 0,
+    tazE_Keep_CODE = 1 << 1,
+    tazE_Keep_STRS = 1 << 2
+};
+
+void tazE_resetEngine( tazE_Engine* eng, unsigned keep );
+
+tazE_Pool*   tazE_makePool( taz_Config const* cfg, unsigned size, unsigned keep, tazE_WarmCb warm, void* data );
+void         tazE_freePool( tazE_Pool* pool );
+tazE_Engine* tazE_takeEngine( tazE_Pool* pool );
+void         tazE_giveEngine( tazE_Pool* pool, tazE_Engine* eng );
+
+/* Note: Sharing Engines
+When several engines are run side by side, one per thread say, each would
+usually load the same prelude and so hold its own copy of the same code and
+strings.  Instead the prelude can be loaded once into an engine that's then
+frozen with `tazE_freezeEngine()`, and the others made with the handle that
+returns as their `taz_Config.shared`.  A sharing engine may reference any of the frozen
+engine's objects, and the frozen engine's interned strings keep their IDs in
+every engine sharing it; so code and constants can be used as they are, and
+interning a string the frozen engine already has gives the same `tazR_Str`.
+
+Freezing runs a full cycle, then leaves everything that survived marked and
+in the old generation for good; so the GC of a sharing engine never scans,
+writes to, or frees any of it.  After freezing the engine's contents mustn't
+be changed in any way, by it or by the engines sharing it, nor may it make
+new strings; it should only be freed, once every engine sharing it is.  The
+frozen engine can be shared by engines on any number of threads.  An engine
+that shares another can't be saved as an image.
+*/
+
+taz_Shared* tazE_freezeEngine( tazE_Engine* eng );
+
 /* Note: Memory Allocation
 The `taz_Engine` uses long jumps for propegating errors efficiently, thus
 avoiding the overhead of countless error checks and forwards.  Unfortunately
@@ -91,17 +156,64 @@ void* tazE_zallocRaw( tazE_Engine* eng, tazE_RawAnchor* anchor, size_t sz );
 void* tazE_reallocRaw( tazE_Engine* eng, tazE_RawAnchor* anchor, size_t sz );
 void  tazE_freeRaw( tazE_Engine* eng, void* raw, size_t sz );
 void  tazE_cancelRaw( tazE_Engine* eng, tazE_RawAnchor* anchor );
-void  tazE_commitRaw( tazE_Engine* eng, tazE_RawAnchor* anchor );
+void* tazE_commitRaw( tazE_Engine* eng, tazE_RawAnchor* anchor );
+
+/* Note: Scratch Allocations
+Raw buffers that are usually thrown away, like the temporaries a host call
+builds up on its way to a result, can be taken from `tazE_scratchRaw()`
+instead of `tazE_mallocRaw()`.  These come from a bump region belonging to
+the topmost barrier, and aren't linked onto its anchor list; when the barrier
+is popped, or an interrupt clears it, the region is wound back to where it
+stood when the barrier was pushed, releasing all of them at once.  Cancelling
+one releases it right away only if it's the most recent; otherwise it waits
+for the barrier.
+
+Committing a scratch allocation copies it to the heap, so unlike ordinary
+allocations its address changes: the caller must use the pointer returned
+by `tazE_commitRaw()` (also left in the anchor's `raw` field) and mustn't
+have stored the scratch address anywhere that outlives the barrier.  Growing
+one with `tazE_reallocRaw()` keeps it in scratch memory.  Requests too big
+for the region, and any made by an arena engine, are served by
+`tazE_mallocRaw()` instead; which needs no special treatment, since the
+anchor API is the same either way.
+*/
+void* tazE_scratchRaw( tazE_Engine* eng, tazE_RawAnchor* anchor, size_t sz );
 
 /* Note: Garbage Collection
 Cleanup and scanning routines are defined elsewhere for different types of Taz
 values so the engine provides a function to be called elsewhere to mark an
 objects as being references.
+
+Dead objects in the old generation are swept lazily, a few at a time as new
+objects are allocated, so finalizers may run long after an object died and
+shouldn't touch any other collected objects; these may already be released.
+
+When the engine is built with `taz_CONFIG_ENABLE_GC_PARALLEL_MARK` the scanning
+routines may be called from several threads at once, so they shouldn't modify
+anything besides marking the values they reference.
 */
 
 void tazE_markObj( tazE_Engine* eng, void* ptr );
 void tazE_markStr( tazE_Engine* eng, tazR_Str str );
 
+/* Note: Deferred Finalizers
+State finalizers are host code, and can take any amount of time; so with
+`taz_Config.gcDeferFinalizers` set the GC doesn't run them itself.  Dead state
+objects that have one are put on a queue instead, keeping their memory until
+the finalizer has run; everything else dead is released as usual.  Queued
+finalizers are run by `tazE_runFinalizers()`, up to `max` of them or all if
+that's zero, which returns how many were run.  The engine calls it itself when
+the outermost barrier is popped, on its way back to the host; and before the
+engine is reset or freed.  The finalizers still mustn't allocate.
+
+With `taz_Config.gcFreeThread` set, and the engine built with
+`taz_CONFIG_ENABLE_GC_BACKGROUND_FREE`, the memory released by the GC and by
+finalizers is given back to the allocator by a helper thread; see the
+Background Freeing section of `taz_engine.c`.
+*/
+
+unsigned tazE_runFinalizers( tazE_Engine* eng, unsigned max );
+
 
 #define tazE_markVal( ENG, VAL ) do {                                      \
     tazR_Type type = tazR_getValType( (VAL) );                             \
@@ -116,6 +228,336 @@ void tazE_markStr( tazE_Engine* eng, tazR_Str str );
 void tazE_collect( tazE_Engine* eng, bool full );
 
 
+/* Note: Compaction
+Small raw buffers that come and go leave the allocator's memory fragmented, so
+with `taz_Config.gcCompact` set the engine keeps raw buffers small enough for
+the heap's cells, up to 256 bytes, in pages of their own.  After each full
+cycle the sparsest of these pages are evacuated into the fullest, and the
+emptied pages are given back to the system with `madvise()` when built with
+`taz_CONFIG_ENABLE_PAGE_RELEASE`.  The pages are carved out of memory from the
+host's `alloc` callback, so that's only safe if it gives out private anonymous
+memory; see `taz_Config.gcCompact`.  Evacuation is left for when the outermost
+barrier is popped, as runtime code holds on to buffer addresses;
+`tazE_compact()` runs a full cycle and compacts right away, and likewise can't
+be called while any barrier is up.
+
+Only buffers in these pages are ever moved.  Larger ones, which includes every
+index table and the value arrays of big records, stay where the allocator put
+them.
+
+To be moved a buffer must be owned by a single object, whose type's `move`
+routine passes it to `tazE_moveRaw()` along with its size, and replaces it with
+the address returned; for now only records have one.  Buffers that aren't
+moved, or owned by types without a `move` routine, just pin their pages in
+place.
+*/
+
+void  tazE_compact( tazE_Engine* eng );
+void* tazE_moveRaw( tazE_Engine* eng, void* raw, size_t sz );
+
+
+/* Note: Weak References
+An object's scanning routine can hold off on marking some of its references by
+passing the object itself to `tazE_markWeak()` instead.  If that returns true
+then, once everything else has been marked, the engine will call the type's
+`trace` hook repeatedly until it stops reporting that it marked something new,
+and then its `clear` hook; which should drop any references for which
+`tazE_isValMarked()` is false, since these are about to be released.  If it
+returns false then the references should just be marked as usual.
+
+The hooks are called while the GC is running, so they mustn't allocate.  Note
+that a weak object may be scanned more than once per cycle, so the hooks should
+be idempotent.
+*/
+
+bool tazE_markWeak( tazE_Engine* eng, void* ptr );
+bool tazE_isValMarked( tazE_Engine* eng, tazR_TVal val );
+
+
+/* Note: Statistics
+The engine keeps a running tally of what the GC has been up to, which can be
+copied out with `tazE_getStats()` for tuning and monitoring.  All times are in
+nanoseconds.  The mark and sweep times of the last cycle include the marking
+steps of an incremental cycle, and any part of the old generation's sweep that
+was finished off by the collector itself; but not the bits swept lazily on
+allocation, which are too small and numerous to be worth timing.
+
+Each pause, that is each time the mutator is stopped to run or step a cycle,
+is counted in a log-linear histogram by its length in microseconds.  Pauses of
+less than `2^taz_CONFIG_GC_PAUSE_PRECISION` microseconds get a bucket of their
+own, after that each power of two is split into that many buckets; so pauses
+are counted within 1/2^precision of their actual length.  The shortest pause
+counted in a bucket is given by `tazE_pauseBucketFloor()`.
+
+The object counts are indexed by type, and count every object that has been
+committed but not yet released; so dead objects are counted until they're
+swept.  The string counts are of the interned (medium and long) strings, and
+the slots available to them without growing the pool.
+
+The byte counts are indexed by type as well.  `liveBytes` is what the counted
+objects take up in the heap, themselves only, and is kept up to date as they
+come and go.  The raw memory the objects own (record value arrays, index
+tables, bytecode and so on) is too changeable to track as it goes, so it's
+tallied while the survivors of each full cycle are swept; `ownedBytes` is what
+they owned as of the last one.  `strBytes` is what the interned strings take up.
+
+Medium strings are interned in a hash table, `strTableUsed` of whose
+`strTableSlots` they take up.  Finding one means probing from its hash's slot
+up to the one it's in, `strProbeTotal` is the number of slots probed to find
+all of them, and `strProbeMax` the most for any one; so the average probe
+length is `strProbeTotal/strTableUsed`.
+
+The same sizes are given for single objects by `tazE_shallowSize()`, which is
+the object's own size in the heap, and `tazE_deepSize()`; which adds the raw
+memory it owns, but not the objects it references.
+
+What the survivors of the last full cycle came to in all is also used to pace
+full cycles; see the Generations note.
+
+`finlPending` counts the dead objects whose finalizers have been deferred and
+not yet run; these are still counted as live until they have been.
+
+`bytesCompacted` is how much raw memory has been moved by compaction, and
+`pagesReleased` how many heap pages it has emptied and given back to the
+system; see the Compaction note.
+*/
+
+#define tazE_PAUSE_BUCKETS ((33 - taz_CONFIG_GC_PAUSE_PRECISION) << taz_CONFIG_GC_PAUSE_PRECISION)
+
+typedef struct tazE_Stats tazE_Stats;
+
+struct tazE_Stats {
+    ulongest minorCycles;
+    ulongest fullCycles;
+    
+    ulongest lastMarkTime;
+    ulongest lastSweepTime;
+    ulongest markTime;
+    ulongest sweepTime;
+    
+    ulongest pauses[tazE_PAUSE_BUCKETS];
+    ulongest maxPause;
+    
+    ulongest bytesFreed;
+    size_t   memUsed;
+    size_t   memLimit;
+    
+    size_t   liveObjects[tazR_Type_LAST_OBJECT + 1];
+    size_t   liveBytes[tazR_Type_LAST_OBJECT + 1];
+    size_t   ownedBytes[tazR_Type_LAST_OBJECT + 1];
+    
+    size_t   strCount;
+    size_t   strSlots;
+    size_t   strBytes;
+    
+    size_t   strTableSlots;
+    size_t   strTableUsed;
+    size_t   strProbeTotal;
+    size_t   strProbeMax;
+    
+    size_t   finlPending;
+    
+    ulongest bytesCompacted;
+    ulongest pagesReleased;
+};
+
+void     tazE_getStats( tazE_Engine* eng, tazE_Stats* stats );
+ulongest tazE_pauseBucketFloor( unsigned bucket );
+size_t   tazE_shallowSize( tazE_Engine* eng, void* ptr );
+size_t   tazE_deepSize( tazE_Engine* eng, void* ptr );
+
+
+/* Note: Heap Dumps
+To find out what's holding on to memory `tazE_dumpHeap()` runs a full cycle
+then writes a snapshot of everything that survived to the given writer, it
+returns false if the writer fails.  The references are found by the same scan
+routines used for marking, so they're exactly the ones the GC follows; except
+that weak references are listed as well.  The `tools/taz_heap.c` analyzer
+reads these dumps and works out retained sizes and paths from the roots.
+
+The dump is a sequence of little endian fixed size fields.  It starts with the
+bytes "TAZHEAP" followed by a one byte format version, currently 1.  Then come
+a number of entries, each beginning with a one byte tag:
+
+    'R' roots:  8 byte ids of every root reference, ending with a 0
+    'O' object: 8 byte id, 1 byte `tazR_Type`, 4 byte size, then the ids of
+                the object's references, ending with a 0
+    'S' string: 8 byte id, 4 byte size
+    'E' end of dump
+
+Objects are identified by address, and interned strings by their pool ID with
+the top bit set.  Object sizes are deep sizes, so include the raw memory owned
+by each object; see the Statistics note.  References may be listed more than
+once.
+*/
+
+bool tazE_dumpHeap( tazE_Engine* eng, taz_Writer* writer );
+
+
+/* Note: Heap Images
+An engine that takes a while to set up (an environment with a standard library
+and some preloaded code, say) can be saved as an image with `tazE_saveImage()`
+once it's ready, then new engines loaded from the image with `tazE_loadImage()`
+in a fraction of the time.  Saving runs a full cycle first, so only what's
+reachable is saved, and returns false if the writer fails or if the heap holds
+anything that can't be saved; that's fibers, and states without `save` and
+`load` callbacks.  Loading returns NULL if the image is malformed or was made
+by a different build, or if it runs out of memory.  Where supported
+`tazE_mapImage()` maps an image file into memory and loads it from there.
+
+Each type saves its objects with the `tazE_save*()` helpers and loads them in
+the same order with the `tazE_load*()` ones.  References to other objects and
+interned strings are saved as their place in the image, and translated back
+to those in the loading engine; and function pointers are saved relative to
+the engine's own code, so images are only good for the build that made them.
+Objects are loaded into uninitialized memory, and not in any particular order,
+so a loader mustn't look at the objects it references; code objects are the
+exception, they're all loaded before anything else.  `tazE_loadSize()` gives
+the size the object being loaded was allocated with, anything copied into it
+has to be checked against that.  Any buffers an object owns should be
+allocated tentatively and committed once it's filled in.  A loader that finds
+the image malformed raises an error, which fails the load.
+
+Images are checked for accidental damage, but not for tampering; so they must
+come from a trusted source.
+*/
+
+typedef void (*tazE_Hook)( void );
+
+bool         tazE_saveImage( tazE_Engine* eng, taz_Writer* writer );
+tazE_Engine* tazE_loadImage( taz_Config const* cfg, void const* buf, size_t len );
+
+#if taz_CONFIG_ENABLE_IMAGE_MAPPING
+    tazE_Engine* tazE_mapImage( taz_Config const* cfg, char const* path );
+#endif
+
+void tazE_saveWord( tazE_Engine* eng, tazE_Image* img, ulongest word );
+void tazE_saveBytes( tazE_Engine* eng, tazE_Image* img, void const* buf, size_t len );
+void tazE_saveRef( tazE_Engine* eng, tazE_Image* img, void const* ptr );
+void tazE_saveStr( tazE_Engine* eng, tazE_Image* img, tazR_Str str );
+void tazE_saveVal( tazE_Engine* eng, tazE_Image* img, tazR_TVal val );
+void tazE_saveHook( tazE_Engine* eng, tazE_Image* img, tazE_Hook hook );
+
+ulongest  tazE_loadWord( tazE_Engine* eng, tazE_Image* img );
+void      tazE_loadBytes( tazE_Engine* eng, tazE_Image* img, void* buf, size_t len );
+void*     tazE_loadRef( tazE_Engine* eng, tazE_Image* img );
+tazR_Str  tazE_loadStr( tazE_Engine* eng, tazE_Image* img );
+tazR_TVal tazE_loadVal( tazE_Engine* eng, tazE_Image* img );
+tazE_Hook tazE_loadHook( tazE_Engine* eng, tazE_Image* img );
+size_t    tazE_loadSize( tazE_Engine* eng, tazE_Image* img );
+
+
+/* Note: Allocation Sampling
+To find out which functions allocate the most `tazE_startSampling()` has the
+engine take a sample roughly every `interval` bytes allocated; each interval is
+picked at random, averaging out to the one given, so that allocation patterns
+which repeat with some period aren't over or under counted.  Each sample is
+weighted by the number of bytes it stands for, and attributed to the current
+fiber's call stack as given by `tazR_sampleFib()`; which fills in up to `max`
+frames, innermost first, and returns the number filled.  Bytecode frames give
+the word offset of their next instruction, host frames an offset of -1.
+
+Two profiles are kept: the bytes allocated by each stack, and the bytes of
+sampled objects that were still alive at the end of the last cycle.  Raw
+buffers are freed explicitly rather than collected, so they only count towards
+the first.  `tazE_writeSamples()` writes a profile out in the folded stack
+format taken by flame graph tools, one line per stack:
+
+    outer+12;inner+3 81920
+
+Where there was no fiber to attribute the allocation to the stack is given as
+`[host]`.  Stopping the sampler discards both profiles.
+*/
+
+typedef struct tazE_Frame tazE_Frame;
+typedef enum   tazE_Profile tazE_Profile;
+
+struct tazE_Frame {
+    tazR_Str name;
+    long     offset;
+};
+
+enum tazE_Profile {
+    tazE_Profile_ALLOC,
+    tazE_Profile_LIVE
+};
+
+bool tazE_startSampling( tazE_Engine* eng, size_t interval );
+void tazE_stopSampling( tazE_Engine* eng );
+bool tazE_writeSamples( tazE_Engine* eng, taz_Writer* writer, tazE_Profile which );
+
+
+/* Note: Generations
+The engine's heap is split into two generations.  Newly committed objects are
+placed in the nursery, and are promoted to the old generation once they survive
+a collection.  Most collections are minor cycles, which only mark and sweep the
+nursery; while every `taz_Config.gcFullInterval`th cycle is a full cycle
+which collects both generations along with the string pool.  A full cycle is
+also run early once the objects promoted since the last one, counting the raw
+memory they own, come to more than `taz_Config.gcHeapGrowth` times what that
+one left behind (or `taz_Config.gcHeapTarget`, if that's more); so a heap that
+fills up quickly with long lived objects isn't left uncollected for long.  Both
+wait on `taz_Config.gcFullMinAlloc`, see the Heap Limits note.
+
+For minor cycles to be sound the engine needs to know about every reference
+from an old object to a young one, these are kept in a remembered set which is
+maintained by a write barrier.  So any code that stores a value into an already
+committed object must follow the store with a call to `tazE_writeBarrier()`,
+with the exception of state and fiber objects; these are mutated too freely
+for a barrier to be practical, so they're kept in the remembered set for the
+duration of their lives instead.  The same goes for buckets, which are roots
+and are always scanned.
+
+Note that this 'barrier' has nothing to do with the `tazE_Barrier` type defined
+below, the name is just the conventional one for such things.
+
+If `taz_Config.gcStepSize` is non-zero then the marking phase of full cycles
+is done incrementally, a few objects at a time, interleaved with allocations.
+The same barrier keeps this sound by marking any value stored into an object
+that's already been marked.  State objects, fibers, and roots are re-scanned
+before the cycle is finished, so they needn't worry about this either.
+*/
+
+#define tazE_writeBarrier( ENG, PTR, VAL ) do {                            \
+    if( tazR_getValType( (VAL) ) > tazR_Type_LAST_ATOMIC )                 \
+        _tazE_writeBarrier( (ENG), (PTR), (VAL) );                         \
+} while( 0 )
+void _tazE_writeBarrier( tazE_Engine* eng, void* ptr, tazR_TVal val );
+
+
+/* Note: Heap Limits
+A cycle is run whenever the heap grows past its limit, which is set after each
+cycle to what survived it plus `taz_Config.gcHeapGrowth` times that again; but
+never less than `taz_Config.gcHeapTarget`.
+
+If a soft limit is given then the heap's limit is held there until the heap
+actually grows past it, at which point a full collection is run rather than a
+minor or incremental cycle; and if that still leaves the heap over the soft
+limit then the pressure callback is told so.  The heap limit is then paced off
+the survivors as usual, so the GC doesn't thrash while the heap stays large.
+
+Full cycles can be spaced out with `taz_Config.gcFullMinAlloc`, the number of
+bytes that must be allocated after one starts before the GC starts another of
+its own accord; whether for the soft limit, the full cycle interval, or the
+growth of the old generation (see the Generations note).  Until then those run
+minor or incremental cycles instead, and the pressure callback isn't told about
+the soft limit.  Full collections asked for with `tazE_collect()`, or needed to
+make room under the hard limit or when the allocator fails, are always run.
+
+An allocation that would take the heap past a hard limit runs a full
+collection, then gives the pressure callback a chance to drop whatever it can
+before collecting again; if there's still no room then the allocation raises
+a `taz_ErrNum_HEAP_LIMIT` error.  Unlike `taz_ErrNum_MEMORY`, which is raised
+when the allocator itself fails, this isn't fatal; so it only fails the fiber
+that made the allocation.  The collector's own buffers, the remembered set and
+mark stack, aren't held to either limit since the GC can't fail.
+
+The pressure callback is called in the middle of an allocation, so it mustn't
+use the engine; it should only release host references, or arrange for load to
+be shed once control returns to the host.
+*/
+
+
 /* Note: Reference Buckets
 In some subroutines we need to keep references to garbage collected objects
 for the duration of its invocation.  For this we can allocate a `tazE_Bucket`
@@ -164,8 +606,46 @@ caller is expected to initialize the jump destination fields: errorDst and
 yieldDst; as well as the pre-interrupt callbacks: errorFun and yieldFun.
 The callbacks can be set to NULL of nothing needs to be done before the
 interrupt, and destruction of stack frames, is invoked.
+
+Setting both destinations is most of what a barrier costs, which adds up on
+hot host call boundaries; so a barrier can be installed with a single one
+instead, `jumpDst`, by setting it with `tazE_setJump()` and pushing the
+barrier with `tazE_pushJumpBarrier()`.  Both interrupts jump there, and the
+barrier's `errnum` tells them apart: it's `taz_ErrNum_NONE` after a yield.
+The callbacks are called as usual.  The barrier struct is mostly jump buffers,
+so zeroing it costs about as much again as setting them; since pushing sets
+everything but the callbacks there's no need to.  Here's an example:
+
+    tazE_Barrier bar;
+    bar.errorFun = onError;
+    bar.yieldFun = NULL;
+    if( tazE_setJump( &bar ) ) {
+        if( bar.errnum == taz_ErrNum_NONE )
+            ...yielded
+        else
+            ...failed
+    }
+    tazE_pushJumpBarrier( eng, &bar );
+    ...
+    tazE_popBarrier( eng, &bar );
+
+Where the compiler has them `tazE_setJump()` uses the `__builtin_setjmp()`
+intrinsics, which save only the frame, stack and return pointers; and never
+the signal mask, which some C libraries save on every `setjmp()`.  The usual
+rules still apply, locals changed after the jump is set must be `volatile` to
+be read after it's taken.
 */
 
+#if defined(__GNUC__) && !defined(__SANITIZE_ADDRESS__)
+    typedef void* tazE_JumpBuf[5];
+    #define tazE_setJump( BAR )  __builtin_setjmp( (BAR)->jumpDst )
+    #define _tazE_longJump( BUF ) __builtin_longjmp( (BUF), 1 )
+#else
+    typedef jmp_buf tazE_JumpBuf;
+    #define tazE_setJump( BAR )  setjmp( (BAR)->jumpDst )
+    #define _tazE_longJump( BUF ) longjmp( (BUF), 1 )
+#endif
+
 struct tazE_Barrier {
     tazE_Barrier*  prev;
     
@@ -173,6 +653,11 @@ struct tazE_Barrier {
     tazE_RawAnchor* rawAnchors;
     tazE_Bucket*    buckets;
     
+    // Where the scratch region stood when the barrier was pushed; it's
+    // wound back here when the barrier is cleared.  Set by the engine.
+    void* scratchChunk;
+    char* scratchBump;
+    
     taz_ErrNum  errnum;
     tazR_TVal   errval;
     
@@ -181,9 +666,13 @@ struct tazE_Barrier {
     
     jmp_buf errorDst;
     jmp_buf yieldDst;
+    
+    tazE_JumpBuf jumpDst;
+    bool         oneJump;
 };
 
 void tazE_pushBarrier( tazE_Engine* eng, tazE_Barrier* barrier );
+void tazE_pushJumpBarrier( tazE_Engine* eng, tazE_Barrier* barrier );
 void tazE_popBarrier( tazE_Engine* eng, tazE_Barrier* barrier );
 
 
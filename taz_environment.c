@@ -3,6 +3,9 @@
 #include "taz_record.h"
 #include "taz_index.h"
 
+// Globals are stored through plain pointers (see `tazR_getGlobalVal()`), so
+// there's no place for a write barrier; this is fine since the environment
+// is a state object, and so it's rescanned by every minor GC cycle.
 typedef struct {
     tazR_State base;
 
@@ -15,7 +18,7 @@ typedef struct {
     tazR_Rec* operatorFunctions;
 } Env;
 
-static void scanEnv( tazE_Engine* eng, tazR_State* self ) {
+static void scanEnv( tazE_Engine* eng, tazR_State* self, bool full ) {
     Env* env = (Env*)self;
     tazE_markObj( eng, env->globalsIdx );
     tazE_markObj( eng, env->importLoaders );
@@ -30,6 +33,58 @@ static size_t sizeofEnv( tazE_Engine* eng, tazR_State* self ) {
     return sizeof(Env);
 }
 
+static size_t ownedByEnv( tazE_Engine* eng, tazR_State* self ) {
+    return sizeof(tazR_TVal)*((Env*)self)->globalsCap;
+}
+
+static void finlEnv( tazE_Engine* eng, tazR_State* self ) {
+    Env* env = (Env*)self;
+    if( env->globalsBuf )
+        tazE_freeRaw( eng, env->globalsBuf, sizeof(tazR_TVal)*env->globalsCap );
+}
+
+static void saveEnv( tazE_Engine* eng, tazR_State* self, tazE_Image* img ) {
+    Env* env = (Env*)self;
+    tazE_saveRef( eng, img, env->globalsIdx );
+    tazE_saveRef( eng, img, env->importLoaders );
+    tazE_saveRef( eng, img, env->importTranslators );
+    tazE_saveRef( eng, img, env->operatorFunctions );
+    
+    tazE_saveWord( eng, img, env->globalsCap );
+    for( unsigned i = 0 ; i < env->globalsCap ; i++ )
+        tazE_saveVal( eng, img, env->globalsBuf[i] );
+}
+
+static void loadEnv( tazE_Engine* eng, tazR_State* self, tazE_Image* img ) {
+    Env* env = (Env*)self;
+    env->base.scan  = scanEnv;
+    env->base.finl  = finlEnv;
+    env->base.size  = sizeofEnv;
+    env->base.owned = ownedByEnv;
+    env->base.save  = saveEnv;
+    env->base.load  = loadEnv;
+    
+    env->globalsIdx        = tazE_loadRef( eng, img );
+    env->importLoaders     = tazE_loadRef( eng, img );
+    env->importTranslators = tazE_loadRef( eng, img );
+    env->operatorFunctions = tazE_loadRef( eng, img );
+    env->globalsBuf        = NULL;
+    env->globalsCap        = 0;
+    
+    unsigned cap = tazE_loadWord( eng, img );
+    if( cap == 0 )
+        return;
+    
+    tazE_RawAnchor bufA;
+    tazR_TVal*     buf = tazE_mallocRaw( eng, &bufA, sizeof(tazR_TVal)*cap );
+    for( unsigned i = 0 ; i < cap ; i++ )
+        buf[i] = tazE_loadVal( eng, img );
+    
+    env->globalsBuf = buf;
+    env->globalsCap = cap;
+    tazE_commitRaw( eng, &bufA );
+}
+
 void tazR_initEnv( tazE_Engine* eng ) {
     struct {
         tazE_Bucket base;
@@ -61,6 +116,12 @@ void tazR_initEnv( tazE_Engine* eng ) {
 
     tazE_ObjAnchor envA;
     Env* env = tazE_mallocObj( eng, &envA, sizeof(Env), tazR_Type_STATE );
+    env->base.scan  = scanEnv;
+    env->base.finl  = finlEnv;
+    env->base.size  = sizeofEnv;
+    env->base.owned = ownedByEnv;
+    env->base.save  = saveEnv;
+    env->base.load  = loadEnv;
     env->globalsIdx = globalsIdx;
     env->globalsBuf = NULL;
     env->globalsCap = 0;
@@ -155,31 +155,56 @@ taz_FibState tazR_getFibState( tazE_Engine* eng, tazR_Fib* fib ) {
     return fib->state;
 }
 
+// Called by the engine's allocation sampler, this mustn't allocate.
+unsigned _tazR_sampleFib( tazE_Engine* eng, tazR_Fib* fib, tazE_Frame* frames, unsigned max ) {
+    if( !fib || !fib->cstack.top )
+        return 0;
+    
+    unsigned n  = 0;
+    BaseAR*  ar = fib->cstack.top->prev;
+    while( ar && n < max ) {
+        tazR_Code* code = ar->fun->code;
+        frames[n].name = code->name;
+        if( code->type == tazR_CodeType_HOST )
+            frames[n].offset = -1;
+        else
+            frames[n].offset = ((ByteAR*)ar)->wp - ((tazR_ByteCode*)code)->wordBuf;
+        
+        n++;
+        ar = ar->prev;
+    }
+    return n;
+}
+
+size_t _tazR_ownedFib( tazE_Engine* eng, tazR_Fib* fib ) {
+    return sizeof(tazR_TVal)*fib->vstack.cap + fib->cstack.cap;
+}
+
 void tazR_cont( tazE_Engine* eng, tazR_Fib* fib, taz_Tup* args, taz_Tup* rets, taz_LocInfo const* loc ) {
     if( fib->state != taz_FibState_STOPPED )
         tazE_error( eng, taz_ErrNum_FIB_NOT_STOPPED );
     
-    tazE_Barrier bar = { 0 };
-    if( setjmp( bar.errorDst ) ) {
-        if( fib->parent )
-            fib->parent->state = taz_FibState_CURRENT;
-        eng->fiber = fib->parent;
-
-        fib->state  = taz_FibState_FAILED;
-        fib->parent = NULL;
-        fib->errnum = bar.errnum;
-        fib->errval = bar.errval;
-
-        if( bar.errnum >= taz_ErrNum_FATAL )
-            tazE_error( eng, bar.errnum );
-        return;
-    }
-
-    if( setjmp( bar.yieldDst ) ) {
+    // Resumes are frequent, so this takes the cheaper single jump barrier;
+    // errors leave `errnum` set, yields don't.
+    tazE_Barrier bar;
+    bar.errorFun = NULL;
+    bar.yieldFun = NULL;
+    if( tazE_setJump( &bar ) ) {
         if( fib->parent )
             fib->parent->state = taz_FibState_CURRENT;
         eng->fiber = fib->parent;
-
+        
+        if( bar.errnum != taz_ErrNum_NONE ) {
+            fib->state  = taz_FibState_FAILED;
+            fib->parent = NULL;
+            fib->errnum = bar.errnum;
+            fib->errval = bar.errval;
+            
+            if( bar.errnum >= taz_ErrNum_FATAL )
+                tazE_error( eng, bar.errnum );
+            return;
+        }
+        
         if( fib->state != taz_FibState_FINISHED )
             fib->state = taz_FibState_STOPPED;
         
@@ -187,7 +212,7 @@ void tazR_cont( tazE_Engine* eng, tazR_Fib* fib, taz_Tup* args, taz_Tup* rets, t
         popRetTup( eng, fib, rets );
         return;
     }
-    tazE_pushBarrier( eng, &bar );
+    tazE_pushJumpBarrier( eng, &bar );
 
     fib->parent        = eng->fiber;
     fib->parent->state = taz_FibState_PAUSED;
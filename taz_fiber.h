@@ -1,6 +1,7 @@
 #ifndef taz_fiber_h
 #define taz_fiber_h
 #include "taz_common.h"
+#include "taz_engine.h"
 
 tazR_Fib*    tazR_makeFib( tazE_Engine* eng, tazR_Fun* fun );
 tazR_TVal    tazR_getFibErrVal( tazE_Engine* eng, tazR_Fib* fib );
@@ -18,6 +19,11 @@ void    tazR_pop( tazE_Engine* eng, tazR_Fib* fib, taz_Var* var );
 
 #define tazR_scanFib   _tazR_scanFib
 #define tazR_sizeofFib _tazR_sizeofFib
+#define tazR_ownedFib  _tazR_ownedFib
 #define tazR_finlFib   _tazR_finlFib
+#define tazR_sampleFib _tazR_sampleFib
+
+unsigned _tazR_sampleFib( tazE_Engine* eng, tazR_Fib* fib, tazE_Frame* frames, unsigned max );
+size_t   _tazR_ownedFib( tazE_Engine* eng, tazR_Fib* fib );
 
 #endif
\ No newline at end of file
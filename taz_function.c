@@ -35,6 +35,53 @@ size_t tazR_sizeofFun( tazE_Engine* eng, tazR_Fun* fun ) {
     return sizeof(tazR_Fun) + stateSize;
 }
 
+size_t tazR_ownedFun( tazE_Engine* eng, tazR_Fun* fun ) {
+    return sizeof(tazR_Upv*)*fun->code->numUpvals;
+}
+
 void tazR_finlFun( tazE_Engine* eng, tazR_Fun* fun ) {
     tazE_freeRaw( eng, fun->upvs, sizeof(tazR_Upv*)*fun->code->numUpvals );
+}
+
+// The number of upvalues and the size of the state are saved along with
+// them, and checked against the code when they're loaded; so a damaged
+// image can't leave the function at odds with its code.
+void tazR_saveFun( tazE_Engine* eng, tazE_Image* img, tazR_Fun* fun ) {
+    unsigned numUpvs   = fun->code->numUpvals;
+    size_t   stateSize = tazR_sizeofFun( eng, fun ) - sizeof(tazR_Fun);
+    
+    tazE_saveRef( eng, img, fun->code );
+    tazE_saveWord( eng, img, numUpvs );
+    for( unsigned i = 0 ; i < numUpvs ; i++ )
+        tazE_saveRef( eng, img, fun->upvs[i] );
+    tazE_saveWord( eng, img, stateSize );
+    tazE_saveBytes( eng, img, fun->state, stateSize );
+}
+
+void tazR_loadFun( tazE_Engine* eng, tazE_Image* img, tazR_Fun* fun ) {
+    fun->code = tazE_loadRef( eng, img );
+    if( !fun->code || tazR_getObjType( tazR_toObj( fun->code ) ) != tazR_Type_CODE )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    // The code's already been loaded, so its size can be trusted.
+    size_t expected = tazR_sizeofFun( eng, fun );
+    if( tazE_loadSize( eng, img ) != expected )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    unsigned numUpvs = fun->code->numUpvals;
+    if( tazE_loadWord( eng, img ) != numUpvs )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    tazE_RawAnchor upvsA;
+    tazR_Upv**     upvs = tazE_mallocRaw( eng, &upvsA, sizeof(tazR_Upv*)*numUpvs );
+    for( unsigned i = 0 ; i < numUpvs ; i++ )
+        upvs[i] = tazE_loadRef( eng, img );
+    
+    size_t stateSize = tazE_loadWord( eng, img );
+    if( sizeof(tazR_Fun) + stateSize != expected )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    tazE_loadBytes( eng, img, fun->state, stateSize );
+    
+    fun->upvs = upvs;
+    tazE_commitRaw( eng, &upvsA );
 }
\ No newline at end of file
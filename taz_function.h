@@ -12,10 +12,16 @@ tazR_Fun* tazR_makeFun( tazE_Engine* eng, tazR_Code* code );
 
 #define tazR_scanFun    _tazR_scanFun
 #define tazR_sizeofFun  _tazR_sizeofFun
+#define tazR_ownedFun   _tazR_ownedFun
 #define tazR_finlFun    _tazR_finlFun
+#define tazR_saveFun    _tazR_saveFun
+#define tazR_loadFun    _tazR_loadFun
 
 void   tazR_scanFun( tazE_Engine* eng, tazR_Fun* fun, bool full );
 size_t tazR_sizeofFun( tazE_Engine* eng, tazR_Fun* fun );
+size_t tazR_ownedFun( tazE_Engine* eng, tazR_Fun* fun );
 void   tazR_finlFun( tazE_Engine* eng, tazR_Fun* fun );
+void   tazR_saveFun( tazE_Engine* eng, tazE_Image* img, tazR_Fun* fun );
+void   tazR_loadFun( tazE_Engine* eng, tazE_Image* img, tazR_Fun* fun );
 
 #endif
\ No newline at end of file
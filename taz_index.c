@@ -91,6 +91,12 @@ struct tazR_Idx {
     long     (*lookup)( tazE_Engine* eng, tazR_Idx* idx, tazR_TVal key );
     unsigned (*insert)( tazE_Engine* eng, tazR_Idx* idx, tazR_TVal key );
     void     (*scan)( tazE_Engine* eng, tazR_Idx* idx );
+    
+    // Set if the index holds its keys weakly, in which case `scan` is
+    // only called by `tazR_idxMarkKeys()` and not by the GC.  Removed
+    // keys are replaced with `udf`, which is never a valid key so it'll
+    // never match a lookup.
+    bool weak;
 };
 
 #define IDX_ROW_CAP (28)
@@ -191,6 +197,7 @@ tazR_Idx* tazR_makeIdx( tazE_Engine* eng ) {
     idx->lookup = lookupWhenNoStrings;
     idx->insert = insertWhenNoStrings;
     idx->scan   = scanWhenNoStrings;
+    idx->weak   = false;
     
     tazE_commitRaw( eng, &rawA );
     tazE_commitObj( eng, &idxA );
@@ -199,13 +206,18 @@ tazR_Idx* tazR_makeIdx( tazE_Engine* eng ) {
 }
 
 void _tazR_scanIdx( tazE_Engine* eng, tazR_Idx* idx, bool full ) {
-    idx->scan( eng, idx );
+    if( !idx->weak )
+        idx->scan( eng, idx );
 }
 
 size_t tazR_sizeofIdx( tazE_Engine* eng, tazR_Idx* idx ) {
     return sizeof(tazR_Idx);
 }
 
+size_t tazR_ownedIdx( tazE_Engine* eng, tazR_Idx* idx ) {
+    return bufCapTable[idx->row]*sizeof(KeyLoc) + bitCapTable[idx->row]*sizeof(ulongest);
+}
+
 static long lookupString( tazE_Engine* eng, tazR_Idx* idx, tazR_Str str ) {
     unsigned hash = tazE_strHash( eng, str );
     unsigned step = 0;
@@ -312,6 +324,7 @@ static unsigned insertInEmpty( tazE_Engine* eng, tazR_Idx* idx, tazR_TVal key )
                 KeyLoc* kp = &idx->buf[i];
                 kp->key = key;
                 kp->loc = idx->loc++;
+                tazE_writeBarrier( eng, idx, key );
                 
                 if( step > idx->stepLimit ) {
                     idx->stepLimit = step;
@@ -461,6 +474,7 @@ static void growIdx( tazE_Engine* eng, tazR_Idx* idx ) {
     tazE_ObjAnchor oldA;
     tazR_Idx* old = tazE_mallocObj( eng, &oldA, sizeof(tazR_Idx), tazR_Type_IDX );
     *old = *idx;
+    old->weak = false;
     tazE_commitObj( eng, &oldA );
     buc.old = tazR_idxVal( old );
     
@@ -484,7 +498,8 @@ static void growIdx( tazE_Engine* eng, tazR_Idx* idx ) {
     
     unsigned ocap = bufCapTable[old->row];
     for( unsigned i = 0 ; i < ocap ; i++ ) {
-        if( tazR_getValType( old->buf[i].key ) == tazR_Type_NONE )
+        tazR_Type type = tazR_getValType( old->buf[i].key );
+        if( type == tazR_Type_NONE || type == tazR_Type_UDF )
             continue;
         
         idx->loc = old->buf[i].loc;
@@ -553,7 +568,7 @@ tazR_Idx* tazR_subIdx( tazE_Engine* eng, tazR_Idx* idx, unsigned n, bool* select
         if( loc >= n )
             continue;
         
-        if( select[loc] )
+        if( select[loc] && tazR_getValType( key ) != tazR_Type_UDF )
             locs[loc] = tazR_idxInsert( eng, sub, key );
         else
             locs[loc] = -1;
@@ -563,12 +578,112 @@ tazR_Idx* tazR_subIdx( tazE_Engine* eng, tazR_Idx* idx, unsigned n, bool* select
     return sub;
 }
 
+void tazR_idxWeak( tazE_Engine* eng, tazR_Idx* idx ) {
+    idx->weak = true;
+}
+
+void tazR_idxMarkKeys( tazE_Engine* eng, tazR_Idx* idx ) {
+    idx->scan( eng, idx );
+}
+
+void tazR_idxFilter( tazE_Engine* eng, tazR_Idx* idx, tazR_IdxKeep keep, void* ud ) {
+    uchar const    tomb   = tazR_getValByte( tazR_udf );
+    unsigned const bitCap = bitCapTable[idx->row];
+    for( unsigned j = 0 ; j < bitCap ; j++ ) {
+        unsigned k = 0;
+        ulongest u = idx->bitmap[j];
+        while( u ) {
+            if( (u & 0xFF) != 0 && (u & 0xFF) != tomb ) {
+                unsigned i = j*sizeof(ulongest) + k;
+                
+                KeyLoc* kp = &idx->buf[i];
+                if( !keep( eng, kp->key, kp->loc, ud ) ) {
+                    kp->key = tazR_udf;
+                    idx->bitmap[j] = (idx->bitmap[j] & ~(0xFFLLU << k*8)) | (ulongest)tomb << k*8;
+                }
+            }
+            k++;
+            u >>= 8;
+        }
+    }
+}
+
 void _tazR_finlIdx( tazE_Engine* eng, tazR_Idx* idx ) {
     size_t bufSize = bufCapTable[idx->row]*sizeof(KeyLoc);
     size_t bitSize = bitCapTable[idx->row]*sizeof(ulongest);
     tazE_freeRaw( eng, idx->buf, bufSize + bitSize );
 }
 
+// Only the occupied buckets are saved, each with its position; string
+// hashes are taken from the contents, so the keys will belong in the
+// same buckets when loaded.  But a string's bitmap byte includes a few
+// bits of its ID, which will likely change, so the bitmap is rebuilt.
+void _tazR_saveIdx( tazE_Engine* eng, tazE_Image* img, tazR_Idx* idx ) {
+    tazE_saveWord( eng, img, idx->row );
+    tazE_saveWord( eng, img, idx->loc );
+    tazE_saveWord( eng, img, idx->stepLimit );
+    tazE_saveWord( eng, img, idx->stepLimitDeviation );
+    tazE_saveWord( eng, img, idx->weak );
+    tazE_saveHook( eng, img, (tazE_Hook)idx->lookup );
+    tazE_saveHook( eng, img, (tazE_Hook)idx->insert );
+    tazE_saveHook( eng, img, (tazE_Hook)idx->scan );
+    
+    unsigned const bufCap = bufCapTable[idx->row];
+    unsigned       num    = 0;
+    for( unsigned i = 0 ; i < bufCap ; i++ ) {
+        if( idx->bitmap[i/sizeof(ulongest)] >> i%sizeof(ulongest)*8 & 0xFF )
+            num++;
+    }
+    tazE_saveWord( eng, img, num );
+    for( unsigned i = 0 ; i < bufCap ; i++ ) {
+        if( !(idx->bitmap[i/sizeof(ulongest)] >> i%sizeof(ulongest)*8 & 0xFF) )
+            continue;
+        
+        tazE_saveWord( eng, img, i );
+        tazE_saveVal( eng, img, idx->buf[i].key );
+        tazE_saveWord( eng, img, idx->buf[i].loc );
+    }
+}
+
+void _tazR_loadIdx( tazE_Engine* eng, tazE_Image* img, tazR_Idx* idx ) {
+    ensureTables();
+    
+    ulongest row = tazE_loadWord( eng, img );
+    if( row >= IDX_ROW_CAP )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    idx->row                = row;
+    idx->loc                = tazE_loadWord( eng, img );
+    idx->stepLimit          = tazE_loadWord( eng, img );
+    idx->stepLimitDeviation = tazE_loadWord( eng, img );
+    idx->weak               = tazE_loadWord( eng, img );
+    idx->lookup = (void*)tazE_loadHook( eng, img );
+    idx->insert = (void*)tazE_loadHook( eng, img );
+    idx->scan   = (void*)tazE_loadHook( eng, img );
+    
+    tazE_RawAnchor rawA;
+    size_t bufSize = bufCapTable[row]*sizeof(KeyLoc);
+    size_t bitSize = bitCapTable[row]*sizeof(ulongest);
+    
+    void* raw = tazE_zallocRaw( eng, &rawA, bufSize + bitSize );
+    idx->buf    = raw;
+    idx->bitmap = raw + bufSize;
+    
+    ulongest num = tazE_loadWord( eng, img );
+    for( ulongest n = 0 ; n < num ; n++ ) {
+        ulongest i = tazE_loadWord( eng, img );
+        if( i >= bufCapTable[row] )
+            tazE_error( eng, taz_ErrNum_OTHER );
+        
+        tazR_TVal key = tazE_loadVal( eng, img );
+        idx->buf[i].key = key;
+        idx->buf[i].loc = tazE_loadWord( eng, img );
+        idx->bitmap[i/sizeof(ulongest)] |= (ulongest)tazR_getValByte( key ) << i%sizeof(ulongest)*8;
+    }
+    
+    tazE_commitRaw( eng, &rawA );
+}
+
 struct tazR_IdxIter {
     tazR_State base;
     tazR_Idx*  idx;
@@ -587,9 +702,12 @@ static size_t idxIterSize( tazE_Engine* eng, tazR_State* self ) {
 tazR_IdxIter* tazR_makeIdxIter( tazE_Engine* eng, tazR_Idx* idx ) {
     tazE_ObjAnchor iterA;
     tazR_IdxIter*  iter = tazE_mallocObj( eng, &iterA, sizeof(tazR_IdxIter), tazR_Type_STATE );
-    iter->base.scan = idxIterScan;
-    iter->base.size = idxIterSize;
-    iter->base.finl = NULL;
+    iter->base.scan  = idxIterScan;
+    iter->base.size  = idxIterSize;
+    iter->base.owned = NULL;
+    iter->base.finl  = NULL;
+    iter->base.save  = NULL;
+    iter->base.load  = NULL;
     
     iter->idx = idx;
     iter->i   = 0;
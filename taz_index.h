@@ -32,6 +32,24 @@ tazR_TVal tazR_idxGetKey( tazE_Engine* eng, tazR_Idx* idx, unsigned loc );
 
 tazR_Idx* tazR_subIdx( tazE_Engine* eng, tazR_Idx* idx, unsigned n, bool* select, long* locs );
 
+/* Note: Weak Keys
+An index can be set to hold its keys weakly, in which case the GC won't mark
+the strings it uses as keys; it's up to the owner of the index to remove any
+keys that weren't marked elsewhere before the cycle is finished, since their
+string IDs may be reused afterwards.  This is done with `tazR_idxFilter()`,
+which calls `keep` for each of the index's keys and removes the ones for which
+it returns false.  The filter doesn't allocate, so it's safe to call while the
+GC is running.  Removed keys leave their slot occupied until the index grows,
+and their locs aren't given out again; so the owner will want to compact the
+index (with `tazR_subIdx()`) once in a while if keys are removed often.
+*/
+
+typedef bool (*tazR_IdxKeep)( tazE_Engine* eng, tazR_TVal key, unsigned loc, void* ud );
+
+void tazR_idxWeak( tazE_Engine* eng, tazR_Idx* idx );
+void tazR_idxMarkKeys( tazE_Engine* eng, tazR_Idx* idx );
+void tazR_idxFilter( tazE_Engine* eng, tazR_Idx* idx, tazR_IdxKeep keep, void* ud );
+
 tazR_IdxIter* tazR_makeIdxIter( tazE_Engine* eng, tazR_Idx* idx );
 bool          tazR_idxIterNext( tazE_Engine* eng, tazR_IdxIter* iter, tazR_TVal* key, unsigned* loc );
 
@@ -44,7 +62,16 @@ void _tazR_scanIdx( tazE_Engine* eng, tazR_Idx* idx, bool full );
 #define tazR_sizeofIdx _tazR_sizeofIdx
 size_t _tazR_sizeofIdx( tazE_Engine* eng, tazR_Idx* idx );
 
+#define tazR_ownedIdx _tazR_ownedIdx
+size_t _tazR_ownedIdx( tazE_Engine* eng, tazR_Idx* idx );
+
 #define tazR_finlIdx _tazR_finlIdx
 void _tazR_finlIdx( tazE_Engine* eng, tazR_Idx* idx );
 
+#define tazR_saveIdx _tazR_saveIdx
+void _tazR_saveIdx( tazE_Engine* eng, tazE_Image* img, tazR_Idx* idx );
+
+#define tazR_loadIdx _tazR_loadIdx
+void _tazR_loadIdx( tazE_Engine* eng, tazE_Image* img, tazR_Idx* idx );
+
 #endif
\ No newline at end of file
@@ -15,21 +15,34 @@ as far as memory goes, record instances.
 
 The combined `index_and_flags` field houses both a pointer to the
 record's index, and 16 bits of flag bits; of which only the lowest
-2 bits are used.  The bit masked by `SEP_FLAG_MASK` indicates that the
+4 bits are used.  The bit masked by `SEP_FLAG_MASK` indicates that the
 record has been marked for 'separation' from its index; so its
 current index pointer will be replaced with a new index when the
 next definition to the record is requested.  The `RCU_FLAG_MASK` is
 used as a marker for cycle detection when comparing records or doing
 other recursive operations.
 
+The `WEAK_FLAG_MASK` and `EPHE_FLAG_MASK` bits make the record hold its
+values weakly, for use as caches.  A weak record's values are cleared
+to `udf` once they're only reachable through the record itself.  An
+ephemeron keeps each of its values alive for only as long as its key
+is reachable from elsewhere, at which point the whole field is dropped.
+Since keys can only be atomic values or strings, and only interned
+strings are ever collected, only fields with such keys can be dropped.
+An ephemeron needs an index of its own, which holds its keys weakly;
+fields are dropped from this index in place, and the record is marked
+for separation so the index is compacted at its next definition.
+
 
 The combined `vals_and_row` field houses a pointer to the value
 array, as well as the array's size as a `row` into the `valsCapTable`
 */
 struct tazR_Rec {
     tazR_TPtr index_and_flags;
-    #define SEP_FLAG_MASK (0x1)
-    #define RCU_FLAG_MASK (0x2)
+    #define SEP_FLAG_MASK  (0x1)
+    #define RCU_FLAG_MASK  (0x2)
+    #define WEAK_FLAG_MASK (0x4)
+    #define EPHE_FLAG_MASK (0x8)
 
     tazR_TPtr vals_and_row;
 };
@@ -71,6 +84,12 @@ tazR_Rec* tazR_makeRec( tazE_Engine* eng, tazR_Idx* idx ) {
 }
 
 static void separateRec( tazE_Engine* eng, tazR_Rec* rec ) {
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+
     tazR_Idx*  idx  = tazR_getPtrAddr( rec->index_and_flags );
     unsigned   row  = tazR_getPtrTag( rec->vals_and_row );
     unsigned   cap  = valsCapTable[row];
@@ -80,8 +99,11 @@ static void separateRec( tazE_Engine* eng, tazR_Rec* rec ) {
     for( unsigned i = 0 ; i < cap ; i++ )
         select[i] = (tazR_getValType( vals[i] ) != tazR_Type_UDF);
     
+    // A weak record's fields may be cleared by any collection triggered
+    // from here on, in which case their locs will be left as -1.
     long locs[cap];
     idx = tazR_subIdx( eng, idx, cap, select, locs );
+    buc.idx = tazR_idxVal( idx );
 
     unsigned ncap = 0;
     for( unsigned i = 0 ; i < cap ; i++ ) {
@@ -89,23 +111,31 @@ static void separateRec( tazE_Engine* eng, tazR_Rec* rec ) {
             ncap = locs[i] + 1;
     }
 
+    unsigned nrow = row;
+    while( nrow > 0 && valsCapTable[nrow-1] >= ncap )
+        nrow--;
+    ncap = valsCapTable[nrow];
+
     tazE_RawAnchor nvalsA;
     tazR_TVal* nvals = tazE_mallocRaw( eng, &nvalsA, sizeof(tazR_TVal)*ncap );
+    for( unsigned i = 0 ; i < ncap ; i++ )
+        nvals[i] = tazR_udf;
     for( unsigned i = 0 ; i < cap ; i++ ) {
-        if( select[i] )
+        if( select[i] && locs[i] >= 0 )
             nvals[locs[i]] = vals[i];
     }
     tazE_commitRaw( eng, &nvalsA );
     tazE_freeRaw( eng, vals, sizeof(tazR_TVal)*cap );
 
-    while( row > 0 && valsCapTable[row-1] >= ncap )
-        row--;
+    unsigned tag = tazR_getPtrTag( rec->index_and_flags );
+    if( tag & EPHE_FLAG_MASK )
+        tazR_idxWeak( eng, idx );
+
+    rec->index_and_flags = tazR_makeTPtr( tag & ~SEP_FLAG_MASK, idx );
+    rec->vals_and_row    = tazR_makeTPtr( nrow, nvals );
+    tazE_writeBarrier( eng, rec, buc.idx );
 
-    rec->index_and_flags = tazR_makeTPtr(
-        tazR_getPtrTag( rec->index_and_flags ) & ~SEP_FLAG_MASK,
-        tazR_getPtrAddr( rec->index_and_flags )
-    );
-    rec->vals_and_row = tazR_makeTPtr( row, nvals );
+    tazE_remBucket( eng, &buc );
 }
 
 void tazR_recDef( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key, tazR_TVal val ) {
@@ -142,6 +172,7 @@ void tazR_recDef( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key, tazR_TVal val
     }
 
     vals[loc] = val;
+    tazE_writeBarrier( eng, rec, val );
 }
 
 void tazR_recSet( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key, tazR_TVal val ) {
@@ -162,6 +193,7 @@ void tazR_recSet( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key, tazR_TVal val
         tazE_error( eng, taz_ErrNum_SET_UNDEFINED );
     
     vals[loc] = val;
+    tazE_writeBarrier( eng, rec, val );
 }
 
 tazR_TVal tazR_recGet( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key ) {
@@ -187,6 +219,24 @@ void tazR_recSep( tazE_Engine* eng, tazR_Rec* rec ) {
     rec->index_and_flags = tazR_makeTPtr( tag | SEP_FLAG_MASK, idx );
 }
 
+void tazR_recWeak( tazE_Engine* eng, tazR_Rec* rec, bool ephemeron ) {
+    unsigned tag = tazR_getPtrTag( rec->index_and_flags );
+    if( tag & EPHE_FLAG_MASK )
+        return;
+    
+    // The record has to be separated before its flag is set, otherwise
+    // a collection could drop keys from an index shared with others.
+    if( ephemeron ) {
+        separateRec( eng, rec );
+        tazR_idxWeak( eng, tazR_getPtrAddr( rec->index_and_flags ) );
+        tag = (tazR_getPtrTag( rec->index_and_flags ) & ~WEAK_FLAG_MASK) | EPHE_FLAG_MASK;
+    }
+    else {
+        tag |= WEAK_FLAG_MASK;
+    }
+    rec->index_and_flags = tazR_makeTPtr( tag, tazR_getPtrAddr( rec->index_and_flags ) );
+}
+
 
 void _tazR_scanRec( tazE_Engine* eng, tazR_Rec* rec, bool full ) {
     tazR_Idx*  idx  = tazR_getPtrAddr( rec->index_and_flags );
@@ -195,14 +245,107 @@ void _tazR_scanRec( tazE_Engine* eng, tazR_Rec* rec, bool full ) {
     tazR_TVal* vals = tazR_getPtrAddr( rec->vals_and_row );
 
     tazE_markObj( eng, idx );
+
+    // Weak values are left for `_tazR_traceRec()` and `_tazR_clearRec()`
+    // to deal with once everything else is marked.  If the engine can't
+    // keep track of the record then it has to be marked normally, along
+    // with its keys if its index wouldn't mark them itself.
+    unsigned tag = tazR_getPtrTag( rec->index_and_flags );
+    if( tag & (WEAK_FLAG_MASK | EPHE_FLAG_MASK) ) {
+        if( tazE_markWeak( eng, rec ) )
+            return;
+        if( tag & EPHE_FLAG_MASK )
+            tazR_idxMarkKeys( eng, idx );
+    }
+
     for( unsigned i = 0 ; i < cap ; i++ )
         tazE_markVal( eng, vals[i] );
 }
 
+typedef struct {
+    tazR_TVal* vals;
+    unsigned   cap;
+    bool       changed;
+} WeakScan;
+
+static bool traceField( tazE_Engine* eng, tazR_TVal key, unsigned loc, void* ud ) {
+    WeakScan* ws = ud;
+    if( loc >= ws->cap || tazE_isValMarked( eng, ws->vals[loc] ) )
+        return true;
+    
+    if( tazE_isValMarked( eng, key ) ) {
+        tazE_markVal( eng, ws->vals[loc] );
+        ws->changed = true;
+    }
+    return true;
+}
+
+bool _tazR_traceRec( tazE_Engine* eng, tazR_Rec* rec ) {
+    if( !(tazR_getPtrTag( rec->index_and_flags ) & EPHE_FLAG_MASK) )
+        return false;
+    
+    WeakScan ws = {
+        .vals    = tazR_getPtrAddr( rec->vals_and_row ),
+        .cap     = valsCapTable[tazR_getPtrTag( rec->vals_and_row )],
+        .changed = false
+    };
+    tazR_idxFilter( eng, tazR_getPtrAddr( rec->index_and_flags ), traceField, &ws );
+    return ws.changed;
+}
+
+static bool clearField( tazE_Engine* eng, tazR_TVal key, unsigned loc, void* ud ) {
+    WeakScan* ws = ud;
+    if( tazE_isValMarked( eng, key ) )
+        return true;
+    
+    if( loc < ws->cap )
+        ws->vals[loc] = tazR_udf;
+    ws->changed = true;
+    return false;
+}
+
+void _tazR_clearRec( tazE_Engine* eng, tazR_Rec* rec ) {
+    tazR_Idx* idx = tazR_getPtrAddr( rec->index_and_flags );
+    unsigned  tag = tazR_getPtrTag( rec->index_and_flags );
+
+    WeakScan ws = {
+        .vals    = tazR_getPtrAddr( rec->vals_and_row ),
+        .cap     = valsCapTable[tazR_getPtrTag( rec->vals_and_row )],
+        .changed = false
+    };
+
+    // The values of an ephemeron's live keys have all been marked, so
+    // only the fields with dead keys need to go.
+    if( tag & EPHE_FLAG_MASK ) {
+        tazR_idxFilter( eng, idx, clearField, &ws );
+        if( ws.changed )
+            rec->index_and_flags = tazR_makeTPtr( tag | SEP_FLAG_MASK, idx );
+        return;
+    }
+
+    for( unsigned i = 0 ; i < ws.cap ; i++ ) {
+        if( !tazE_isValMarked( eng, ws.vals[i] ) )
+            ws.vals[i] = tazR_udf;
+    }
+}
+
 size_t _tazR_sizeofRec( tazE_Engine* eng, tazR_Rec* rec ) {
     return sizeof(tazR_Rec);
 }
 
+size_t _tazR_ownedRec( tazE_Engine* eng, tazR_Rec* rec ) {
+    return sizeof(tazR_TVal)*valsCapTable[tazR_getPtrTag( rec->vals_and_row )];
+}
+
+void _tazR_moveRec( tazE_Engine* eng, tazR_Rec* rec ) {
+    unsigned   row  = tazR_getPtrTag( rec->vals_and_row );
+    unsigned   cap  = valsCapTable[row];
+    tazR_TVal* vals = tazR_getPtrAddr( rec->vals_and_row );
+    
+    vals = tazE_moveRaw( eng, vals, sizeof(tazR_TVal)*cap );
+    rec->vals_and_row = tazR_makeTPtr( row, vals );
+}
+
 void _tazR_finlRec( tazE_Engine* eng, tazR_Rec* rec ) {
     unsigned   row  = tazR_getPtrTag( rec->vals_and_row );
     unsigned   cap  = valsCapTable[row];
@@ -211,6 +354,36 @@ void _tazR_finlRec( tazE_Engine* eng, tazR_Rec* rec ) {
     tazE_freeRaw( eng, vals, sizeof(tazR_TVal)*cap );
 }
 
+void _tazR_saveRec( tazE_Engine* eng, tazE_Image* img, tazR_Rec* rec ) {
+    unsigned   row  = tazR_getPtrTag( rec->vals_and_row );
+    unsigned   cap  = valsCapTable[row];
+    tazR_TVal* vals = tazR_getPtrAddr( rec->vals_and_row );
+    
+    tazE_saveWord( eng, img, tazR_getPtrTag( rec->index_and_flags ) );
+    tazE_saveRef( eng, img, tazR_getPtrAddr( rec->index_and_flags ) );
+    tazE_saveWord( eng, img, row );
+    for( unsigned i = 0 ; i < cap ; i++ )
+        tazE_saveVal( eng, img, vals[i] );
+}
+
+void _tazR_loadRec( tazE_Engine* eng, tazE_Image* img, tazR_Rec* rec ) {
+    unsigned  tag = tazE_loadWord( eng, img );
+    tazR_Idx* idx = tazE_loadRef( eng, img );
+    ulongest  row = tazE_loadWord( eng, img );
+    if( !idx || row >= REC_NUM_ROWS )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    unsigned       cap = valsCapTable[row];
+    tazE_RawAnchor valsA;
+    tazR_TVal*     vals = tazE_mallocRaw( eng, &valsA, sizeof(tazR_TVal)*cap );
+    for( unsigned i = 0 ; i < cap ; i++ )
+        vals[i] = tazE_loadVal( eng, img );
+    
+    rec->index_and_flags = tazR_makeTPtr( tag, idx );
+    rec->vals_and_row    = tazR_makeTPtr( row, vals );
+    tazE_commitRaw( eng, &valsA );
+}
+
 struct tazR_RecIter {
     tazR_State    base;
     tazR_Rec*     rec;
@@ -239,9 +412,12 @@ tazR_RecIter* tazR_makeRecIter( tazE_Engine* eng, tazR_Rec* rec ) {
 
     tazE_ObjAnchor recIterA;
     tazR_RecIter* recIter = tazE_mallocObj( eng, &recIterA, sizeof(tazR_RecIter), tazR_Type_STATE );
-    recIter->base.scan = scanRecIter;
-    recIter->base.size = sizeofRecIter;
-    recIter->base.finl = NULL;
+    recIter->base.scan  = scanRecIter;
+    recIter->base.size  = sizeofRecIter;
+    recIter->base.owned = NULL;
+    recIter->base.finl  = NULL;
+    recIter->base.save  = NULL;
+    recIter->base.load  = NULL;
 
     recIter->rec  = rec;
     recIter->iter = idxIter;
@@ -320,7 +496,7 @@ static bool isSubset( tazE_Engine* eng, tazR_Rec* rec1, tazR_Rec* rec2, bool* cy
                 
                 rec1->index_and_flags = tazR_makeTPtr( tag | RCU_FLAG_MASK, tazR_getPtrAddr( rec1->index_and_flags ) );
                 isSub = areEqual( eng, tazR_getValRec( val ), tazR_getValRec( oth ), cyclic );
-                rec1->index_and_flags = tazR_makeTPtr( tag & !RCU_FLAG_MASK, tazR_getPtrAddr( rec1->index_and_flags ) );
+                rec1->index_and_flags = tazR_makeTPtr( tag & ~RCU_FLAG_MASK, tazR_getPtrAddr( rec1->index_and_flags ) );
                 if( !isSub )
                     break;
             }
@@ -9,6 +9,7 @@ void      tazR_recDef( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key, tazR_TVal
 void      tazR_recSet( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key, tazR_TVal val );
 tazR_TVal tazR_recGet( tazE_Engine* eng, tazR_Rec* rec, tazR_TVal key );
 void      tazR_recSep( tazE_Engine* eng, tazR_Rec* rec );
+void      tazR_recWeak( tazE_Engine* eng, tazR_Rec* rec, bool ephemeron );
 
 tazR_RecIter* tazR_makeRecIter( tazE_Engine* eng, tazR_Rec* rec );
 bool          tazR_recIterNext( tazE_Engine* eng, tazR_RecIter* iter, tazR_TVal* key, tazR_TVal* val );
@@ -21,10 +22,28 @@ bool       tazR_recLessOrEqual( tazE_Engine* eng, tazR_Rec* rec1, tazR_Rec* rec2
 #define tazR_scanRec _tazR_scanRec
 void _tazR_scanRec( tazE_Engine* eng, tazR_Rec* rec, bool full );
 
+#define tazR_traceRec _tazR_traceRec
+bool _tazR_traceRec( tazE_Engine* eng, tazR_Rec* rec );
+
+#define tazR_clearRec _tazR_clearRec
+void _tazR_clearRec( tazE_Engine* eng, tazR_Rec* rec );
+
 #define tazR_sizeofRec _tazR_sizeofRec
 size_t _tazR_sizeofRec( tazE_Engine* eng, tazR_Rec* rec );
 
+#define tazR_ownedRec _tazR_ownedRec
+size_t _tazR_ownedRec( tazE_Engine* eng, tazR_Rec* rec );
+
+#define tazR_moveRec _tazR_moveRec
+void _tazR_moveRec( tazE_Engine* eng, tazR_Rec* rec );
+
 #define tazR_finlRec _tazR_finlRec
 void _tazR_finlRec( tazE_Engine* eng, tazR_Rec* rec );
 
+#define tazR_saveRec _tazR_saveRec
+void _tazR_saveRec( tazE_Engine* eng, tazE_Image* img, tazR_Rec* rec );
+
+#define tazR_loadRec _tazR_loadRec
+void _tazR_loadRec( tazE_Engine* eng, tazE_Image* img, tazR_Rec* rec );
+
 #endif
\ No newline at end of file
@@ -3,9 +3,14 @@
 
 tazR_Upv* tazR_makeUpv( tazE_Engine* eng, tazR_TVal val ) {
     tazE_ObjAnchor upvA;
-    tazR_Upv* upv = tazE_mallocObj( eng, &upva, sizeof(tazR_Upv), tazR_Type_UPV );
+    tazR_Upv* upv = tazE_mallocObj( eng, &upvA, sizeof(tazR_Upv), tazR_Type_UPV );
     upv->val = val;
     tazE_commitObj( eng, &upvA );
 
     return upv;
+}
+
+void tazR_setUpv( tazE_Engine* eng, tazR_Upv* upv, tazR_TVal val ) {
+    upv->val = val;
+    tazE_writeBarrier( eng, upv, val );
 }
\ No newline at end of file
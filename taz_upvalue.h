@@ -7,8 +7,11 @@ struct tazR_Upv {
 };
 
 tazR_Upv* tazR_makeUpv( tazE_Engine* eng, tazR_TVal val );
+void      tazR_setUpv( tazE_Engine* eng, tazR_Upv* upv, tazR_TVal val );
 
 #define tazR_scanUpv( ENG, UPV, FULL ) tazE_markVal( (ENG), ((tazR_Upv*)(UPV))->val )
 #define tazR_sizeofUpv( ENG, UPV )     sizeof(tazR_Upv)
+#define tazR_saveUpv( ENG, IMG, UPV )  tazE_saveVal( (ENG), (IMG), ((tazR_Upv*)(UPV))->val )
+#define tazR_loadUpv( ENG, IMG, UPV )  (((tazR_Upv*)(UPV))->val = tazE_loadVal( (ENG), (IMG) ))
 
 #endif
\ No newline at end of file
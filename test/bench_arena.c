@@ -0,0 +1,143 @@
+#define taz_TESTING
+#include "../taz_index.c"
+#include "../taz_record.c"
+#include "../taz_engine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures the latency of a short lived engine's whole life: creating it,
+// doing a request's worth of work, then freeing it; with the usual engine
+// against arena engines, with and without the GC, and against taking a
+// warm engine from a pool and resetting it afterwards.
+
+#define NUM_REQUESTS (200)
+#define NUM_RECS     (2000)
+#define NUM_FIELDS   (8)
+
+static void* alloc( void* old, size_t osz, size_t nsz ) {
+    if( nsz > 0 )
+        return realloc( old, nsz );
+    free( old );
+    return NULL;
+}
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Builds a list of records with a few string and number fields each, the
+// sort of thing a request handler might put together for a response.
+static bool handleRequest( tazE_Engine* eng ) {
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        return false;
+    tazE_pushBarrier( eng, &bar );
+
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+        tazR_TVal   list;
+        tazR_TVal   str;
+    } buc;
+    tazE_addBucket( eng, &buc, 3 );
+
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+    for( unsigned i = 0 ; i < NUM_FIELDS ; i++ )
+        tazR_idxInsert( eng, idx, tazR_intVal( i ) );
+
+    char buf[32];
+    for( unsigned i = 0 ; i < NUM_RECS ; i++ ) {
+        tazR_Rec* rec = tazR_makeRec( eng, idx );
+        tazR_recDef( eng, rec, tazR_intVal( 0 ), buc.list );
+        buc.list = tazR_recVal( rec );
+
+        int len = sprintf( buf, "response item %u", i );
+        buc.str = tazR_strVal( tazE_makeStr( eng, buf, len ) );
+        tazR_recDef( eng, rec, tazR_intVal( 1 ), buc.str );
+        for( unsigned j = 2 ; j < NUM_FIELDS ; j++ )
+            tazR_recDef( eng, rec, tazR_intVal( j ), tazR_intVal( i*j ) );
+    }
+
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    return true;
+}
+
+static bool run( char const* name, taz_Config const* cfg ) {
+    double total = 0.0;
+    double worst = 0.0;
+    double free  = 0.0;
+    for( unsigned i = 0 ; i < NUM_REQUESTS ; i++ ) {
+        double start = now();
+
+        tazE_Engine* eng = tazE_makeEngine( cfg );
+        if( !eng || !handleRequest( eng ) )
+            return false;
+
+        double freeing = now();
+        tazE_freeEngine( eng );
+
+        double stop = now();
+        total += stop - start;
+        free  += stop - freeing;
+        if( stop - start > worst )
+            worst = stop - start;
+    }
+
+    printf(
+        "arena: %-24s mean %7.1fus, worst %7.1fus, teardown %6.1fus\n",
+        name, total/NUM_REQUESTS*1e6, worst*1e6, free/NUM_REQUESTS*1e6
+    );
+    return true;
+}
+
+static bool runPooled( char const* name, taz_Config const* cfg ) {
+    tazE_Pool* pool = tazE_makePool( cfg, 1, 0, NULL, NULL );
+    if( !pool )
+        return false;
+    
+    double total = 0.0;
+    double worst = 0.0;
+    double free  = 0.0;
+    for( unsigned i = 0 ; i < NUM_REQUESTS ; i++ ) {
+        double start = now();
+        
+        tazE_Engine* eng = tazE_takeEngine( pool );
+        if( !eng || !handleRequest( eng ) )
+            return false;
+        
+        double freeing = now();
+        tazE_giveEngine( pool, eng );
+        
+        double stop = now();
+        total += stop - start;
+        free  += stop - freeing;
+        if( stop - start > worst )
+            worst = stop - start;
+    }
+    tazE_freePool( pool );
+    
+    printf(
+        "arena: %-24s mean %7.1fus, worst %7.1fus, teardown %6.1fus\n",
+        name, total/NUM_REQUESTS*1e6, worst*1e6, free/NUM_REQUESTS*1e6
+    );
+    return true;
+}
+
+int main( void ) {
+    taz_Config heap     = { .alloc = alloc };
+    taz_Config arena    = { .alloc = alloc, .arenaChunkSize = 256*1024 };
+    taz_Config arenaNoGC = { .alloc = alloc, .arenaChunkSize = 256*1024, .gcDisabled = true };
+
+    bool ok = run( "heap", &heap ) && run( "arena", &arena ) && run( "arena, no GC", &arenaNoGC ) &&
+              runPooled( "pooled heap", &heap );
+    if( !ok ) {
+        printf( "FAILED\n" );
+        return 1;
+    }
+    return 0;
+}
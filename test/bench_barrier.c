@@ -0,0 +1,78 @@
+#define taz_TESTING
+#include "../taz_engine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures what it costs to install and pop a barrier around a call that
+// does nothing, and to unwind one with an error, with the usual pair of
+// jump destinations against a single jump barrier; which, as the note in
+// the header suggests, isn't zeroed first.
+
+#define NUM_CALLS (5000000)
+
+static void* alloc( void* old, size_t osz, size_t nsz ) {
+    if( nsz > 0 )
+        return realloc( old, nsz );
+    free( old );
+    return NULL;
+}
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static __attribute__((noinline)) void body( tazE_Engine* eng, bool raise ) {
+    if( raise )
+        tazE_error( eng, taz_ErrNum_OTHER );
+}
+
+static __attribute__((noinline)) bool pairCall( tazE_Engine* eng, bool raise ) {
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        return false;
+    tazE_pushBarrier( eng, &bar );
+    
+    body( eng, raise );
+    
+    tazE_popBarrier( eng, &bar );
+    return true;
+}
+
+static __attribute__((noinline)) bool jumpCall( tazE_Engine* eng, bool raise ) {
+    tazE_Barrier bar;
+    bar.errorFun = NULL;
+    bar.yieldFun = NULL;
+    if( tazE_setJump( &bar ) )
+        return false;
+    tazE_pushJumpBarrier( eng, &bar );
+    
+    body( eng, raise );
+    
+    tazE_popBarrier( eng, &bar );
+    return true;
+}
+
+static void run( char const* name, bool (*call)( tazE_Engine*, bool ), bool raise ) {
+    taz_Config   cfg = { .alloc = alloc };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    
+    unsigned ok    = 0;
+    double   start = now();
+    for( unsigned i = 0 ; i < NUM_CALLS ; i++ )
+        ok += call( eng, raise );
+    double stop = now();
+    
+    tazE_freeEngine( eng );
+    printf( "barrier: %-24s %6.1fns per call (%u returned)\n", name, (stop - start)/NUM_CALLS*1e9, ok );
+}
+
+int main( void ) {
+    run( "pair, push/pop", pairCall, false );
+    run( "jump, push/pop", jumpCall, false );
+    run( "pair, error", pairCall, true );
+    run( "jump, error", jumpCall, true );
+    return 0;
+}
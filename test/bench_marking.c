@@ -0,0 +1,115 @@
+#define taz_TESTING
+#include "../taz_index.c"
+#include "../taz_record.c"
+#include "../taz_engine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures full cycle marking throughput over a graph of records, each
+// linked to a few others picked at random; so tracing it jumps all over
+// the heap, the way real record graphs tend to.
+
+#define NUM_RECS   (500000)
+#define NUM_FIELDS (4)
+#define NUM_RUNS   (10)
+
+static void* alloc( void* old, size_t osz, size_t nsz ) {
+    if( nsz > 0 )
+        return realloc( old, nsz );
+    free( old );
+    return NULL;
+}
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double markOnce( EngineFull* eng ) {
+    sweepSome( eng, 0 );
+    eng->isGCRunning = true;
+    
+    double start = now();
+    startCycle( eng, true );
+    drainGray( eng, 0 );
+    double stop = now();
+    
+    finishCycle( eng, 0 );
+    sweepSome( eng, 0 );
+    return stop - start;
+}
+
+int main( void ) {
+    taz_Config   cfg = { .alloc = alloc };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    EngineFull*  full = (EngineFull*)eng;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) ) {
+        printf( "FAILED\n" );
+        return 1;
+    }
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   root;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    // The records aren't reachable until they're all linked up.
+    full->gcDisabled = true;
+    
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    for( unsigned i = 0 ; i < NUM_FIELDS ; i++ )
+        tazR_idxInsert( eng, idx, tazR_intVal( i ) );
+    
+    tazR_Rec** recs  = malloc( sizeof(tazR_Rec*)*NUM_RECS );
+    unsigned*  order = malloc( sizeof(unsigned)*NUM_RECS );
+    for( unsigned i = 0 ; i < NUM_RECS ; i++ ) {
+        recs[i]  = tazR_makeRec( eng, idx );
+        order[i] = i;
+    }
+    
+    // Field zero chains the records in a random order, so they're all
+    // reachable but not in allocation order.  The rest are random.
+    srand( 1234 );
+    for( unsigned i = NUM_RECS - 1 ; i > 0 ; i-- ) {
+        unsigned j = rand() % (i + 1);
+        unsigned t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for( unsigned i = 0 ; i < NUM_RECS ; i++ ) {
+        tazR_Rec* rec = recs[order[i]];
+        if( i + 1 < NUM_RECS )
+            tazR_recDef( eng, rec, tazR_intVal( 0 ), tazR_recVal( recs[order[i + 1]] ) );
+        for( unsigned j = 1 ; j < NUM_FIELDS ; j++ )
+            tazR_recDef( eng, rec, tazR_intVal( j ), tazR_recVal( recs[rand() % NUM_RECS] ) );
+    }
+    buc.root = tazR_recVal( recs[order[0]] );
+    free( recs );
+    free( order );
+    
+    full->gcDisabled = false;
+    tazE_collect( eng, true );
+    
+    double best = 0.0;
+    for( unsigned i = 0 ; i < NUM_RUNS ; i++ ) {
+        double secs = markOnce( full );
+        if( i == 0 || secs < best )
+            best = secs;
+    }
+    
+    printf(
+        "marking: %u records, prefetch distance %u: %.1fM objects/s\n",
+        NUM_RECS, taz_CONFIG_GC_PREFETCH_DISTANCE, NUM_RECS/best/1e6
+    );
+    
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    tazE_freeEngine( eng );
+    return 0;
+}
@@ -0,0 +1,82 @@
+#define taz_TESTING
+#include "../taz_index.c"
+#include "../taz_record.c"
+#include "../taz_engine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures a host call that builds up a handful of temporary buffers on
+// the way to a small result, with the temporaries taken from the heap as
+// ordinary tentative allocations against taking them from the barrier's
+// scratch region; once with the call returning normally, and once with it
+// raising an error before it's done.
+
+#define NUM_CALLS (200000)
+#define NUM_TEMPS (16)
+#define TEMP_SIZE (256)
+
+static void* alloc( void* old, size_t osz, size_t nsz ) {
+    if( nsz > 0 )
+        return realloc( old, nsz );
+    free( old );
+    return NULL;
+}
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static size_t hostCall( tazE_Engine* eng, bool scratch, bool raise ) {
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        return 0;
+    tazE_pushBarrier( eng, &bar );
+    
+    tazE_RawAnchor ancs[NUM_TEMPS];
+    size_t         sum = 0;
+    for( unsigned i = 0 ; i < NUM_TEMPS ; i++ ) {
+        unsigned char* buf = scratch ? tazE_scratchRaw( eng, &ancs[i], TEMP_SIZE )
+                                     : tazE_mallocRaw( eng, &ancs[i], TEMP_SIZE );
+        memset( buf, i, TEMP_SIZE );
+        sum += buf[i];
+    }
+    if( raise )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    tazE_RawAnchor resA;
+    size_t* res = scratch ? tazE_scratchRaw( eng, &resA, sizeof(size_t) )
+                          : tazE_mallocRaw( eng, &resA, sizeof(size_t) );
+    *res = sum;
+    res  = tazE_commitRaw( eng, &resA );
+    
+    tazE_popBarrier( eng, &bar );
+    
+    sum = *res;
+    tazE_freeRaw( eng, res, sizeof(size_t) );
+    return sum;
+}
+
+static void run( char const* name, bool scratch, bool raise ) {
+    taz_Config   cfg = { .alloc = alloc };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    
+    size_t total = 0;
+    double start = now();
+    for( unsigned i = 0 ; i < NUM_CALLS ; i++ )
+        total += hostCall( eng, scratch, raise );
+    double stop = now();
+    
+    tazE_freeEngine( eng );
+    printf( "scratch: %-24s %7.1fns per call (%zu)\n", name, (stop - start)/NUM_CALLS*1e9, total );
+}
+
+int main( void ) {
+    run( "heap", false, false );
+    run( "scratch", true, false );
+    run( "heap, error", false, true );
+    run( "scratch, error", true, true );
+    return 0;
+}
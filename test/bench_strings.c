@@ -0,0 +1,71 @@
+#define taz_TESTING
+#include "../taz_engine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures interning a large number of distinct strings, which each
+// take a new ID from the string pool; and medium ones a place in the
+// intern table as well.  Reported per million so any growth in the cost
+// per string shows up.  Collection is disabled, so all of them are kept.
+
+#define NUM_STRS  (10000000)
+#define BATCH     (1000000)
+
+static void* alloc( void* old, size_t osz, size_t nsz ) {
+    if( nsz > 0 )
+        return realloc( old, nsz );
+    free( old );
+    return NULL;
+}
+
+static double now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void run( char const* name, char const* fmt ) {
+    taz_Config   cfg = { .alloc = alloc, .gcDisabled = true };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) ) {
+        printf( "strings: %s failed\n", name );
+        exit( 1 );
+    }
+    tazE_pushBarrier( eng, &bar );
+    
+    char     buf[64];
+    tazR_Str sum   = 0;
+    double   total = 0;
+    for( unsigned i = 0 ; i < NUM_STRS ; i += BATCH ) {
+        double start = now();
+        for( unsigned j = i ; j < i + BATCH ; j++ ) {
+            int len = sprintf( buf, fmt, j );
+            sum ^= tazE_makeStr( eng, buf, len );
+        }
+        double stop = now();
+        total += stop - start;
+        printf( "strings: %-6s %8u-%-8u %7.1fns per string\n", name, i, i + BATCH, (stop - start)/BATCH*1e9 );
+    }
+    printf( "strings: %-6s %-17s %7.1fns per string (%llx)\n", name, "all", total/NUM_STRS*1e9, (unsigned long long)sum );
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    if( stats.strTableUsed > 0 ) {
+        printf( "strings: %-6s %zu of %zu table slots, %.2f probes on average, %zu at most\n",
+            name, stats.strTableUsed, stats.strTableSlots,
+            (double)stats.strProbeTotal/stats.strTableUsed, stats.strProbeMax
+        );
+    }
+    
+    tazE_popBarrier( eng, &bar );
+    tazE_freeEngine( eng );
+}
+
+int main( void ) {
+    run( "long", "interned string number %u" );
+    run( "medium", "field_%u" );
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include "../taz.h"
 
 
 typedef struct {
@@ -66,6 +68,27 @@ static bool suite_ ## NAME( void ) {                                           \
 
 #define run_suite( NAME ) suite_ ## NAME()
 
+
+// Collects what's written to it in a buffer that grows as needed, and is
+// kept null terminated so it can be read as a string.
+typedef struct {
+    taz_Writer base;
+    char*      buf;
+    size_t     len;
+    size_t     cap;
+} BufWriter;
+
+static inline bool bufWrite( taz_Writer* self, char chr ) {
+    BufWriter* w = (BufWriter*)self;
+    if( w->len + 1 >= w->cap ) {
+        w->cap = w->cap ? w->cap*2 : 1024;
+        w->buf = realloc( w->buf, w->cap );
+    }
+    w->buf[w->len++] = chr;
+    w->buf[w->len]   = '\0';
+    return true;
+}
+
 #define check( COND ) do {                                                     \
     if( !(COND) ) goto fail;                                                   \
 } while( 0 )
@@ -70,7 +70,7 @@ begin_test( create_assembler, SETUP_ENGINE_AND_BARRIER )
         tazR_TVal   name;
         tazR_TVal   as;
     } buc;
-    tazE_addBucket( eng, &buc, 1 );
+    tazE_addBucket( eng, &buc, 2 );
 
     tazR_Str name = tazE_makeStr( eng, "foo", 3 );
     buc.name = tazR_strVal( name );
@@ -93,7 +93,7 @@ begin_test( assemble_code, SETUP_ENGINE_AND_BARRIER )
         tazR_TVal   tmp;
         tazR_TVal   as;
     } buc;
-    tazE_addBucket( eng, &buc, 1 );
+    tazE_addBucket( eng, &buc, 4 );
 
     tazR_Str name = tazE_makeStr( eng, "foo", 4 );
     buc.name = tazR_strVal( name );
@@ -142,10 +142,37 @@ begin_test( assemble_code, SETUP_ENGINE_AND_BARRIER )
     tazE_remBucket( eng, &buc );
 end_test( assemble_code, TEARDOWN_ENGINE_AND_BARRIER )
 
+begin_test( reset_keeps_code, SETUP_ENGINE )
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    taz_FunInfo info = {
+        .name     = "foo",
+        .params   = "a, b",
+        .upvals   = "x, y",
+        .callback = foo
+    };
+    tazR_Code* code = tazR_makeHostCode( eng, &info );
+    tazE_popBarrier( eng, &bar );
+    
+    tazE_Stats stats;
+    tazE_resetEngine( eng, tazE_Keep_CODE );
+    tazE_getStats( eng, &stats );
+    check( stats.liveObjects[tazR_Type_CODE] == 1 );
+    check( code->type == tazR_CodeType_HOST );
+    
+    tazE_resetEngine( eng, 0 );
+    tazE_getStats( eng, &stats );
+    check( stats.liveObjects[tazR_Type_CODE] == 0 );
+end_test( reset_keeps_code, TEARDOWN_ENGINE )
+
 begin_suite( code_tests )
     with_test( create_host_code )
     with_test( create_assembler )
     with_test( assemble_code )
+    with_test( reset_keeps_code )
 end_suite( code_tests )
 
 int main( void ) {
@@ -1,4 +1,17 @@
 #define taz_TESTING
+#include "../taz_engine.h"
+
+// Stands in for the fiber's call stack when sampling allocations.
+static tazE_Frame sampleFrames[2];
+static unsigned   sampleDepth = 0;
+
+static unsigned sampleStack( tazE_Frame* frames, unsigned max ) {
+    for( unsigned i = 0 ; i < sampleDepth && i < max ; i++ )
+        frames[i] = sampleFrames[i];
+    return sampleDepth;
+}
+#define tazR_sampleFib( ENG, FIB, FRAMES, MAX ) sampleStack( FRAMES, MAX )
+
 #include "../taz_engine.c"
 #include "test.h"
 #include <string.h>
@@ -45,60 +58,869 @@ static size_t cellSize( tazE_Engine* eng, tazR_State* self ) {
 Cell* cons( tazE_Engine* eng, int car, Cell* cdr ) {
     tazE_ObjAnchor anc;
     Cell* cell = tazE_mallocObj( eng, &anc, sizeof(Cell), tazR_Type_STATE );
-    cell->base.finl = NULL;
-    cell->base.scan = cellScan;
-    cell->base.size = cellSize;
+    cell->base.finl  = NULL;
+    cell->base.scan  = cellScan;
+    cell->base.size  = cellSize;
+    cell->base.owned = NULL;
+    cell->base.save  = NULL;
+    cell->base.load  = NULL;
     
     cell->car = car;
     cell->cdr = cdr;
     
     tazE_commitObj( eng, &anc );
-    return cell;
+    return cell;
+}
+
+#define SETUP_ENGINE_AND_BARRIER                                            \
+    taz_Config   cfg = { .alloc = alloc };                                  \
+    tazE_Engine* eng = tazE_makeEngine( &cfg );                             \
+    tazE_Barrier bar = { 0 };                                               \
+    if( setjmp( bar.errorDst ) )                                            \
+        fail();                                                             \
+    if( setjmp( bar.yieldDst ) )                                            \
+        fail();                                                             \
+    tazE_pushBarrier( eng, &bar );
+    
+#define TEARDOWN_ENGINE_AND_BARRIER                                         \
+    tazE_popBarrier( eng, &bar );                                           \
+    tazE_freeEngine( eng );
+
+begin_test( malloc_and_collect_objects, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    Cell* cell = cons( eng, 0, NULL );
+    buc.cell = tazR_stateVal( cell );
+    
+    for( int i = 1 ; i < 10000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    
+    tazE_remBucket( eng, &buc );
+    
+    check( ((EngineFull*)eng)->nGCCycles > 0 );
+    
+    // Touch all cells to make sure they're still alive, issues here
+    // may not be caught by the test itself, but will be caught by
+    // valgrind and similar tools.
+    for( int i = 9999 ; i >= 0 ; i-- ) {
+        check( cell->car == i );
+        cell = cell->cdr;
+    }
+    
+    tazE_collect( eng, false );
+end_test( malloc_and_collect_objects, TEARDOWN_ENGINE_AND_BARRIER )
+
+static unsigned countObjs( tazR_Obj* list ) {
+    unsigned n = 0;
+    while( list ) {
+        n++;
+        list = tazR_getObjNext( list );
+    }
+    return n;
+}
+
+begin_test( generational_collection, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    Cell* cell = cons( eng, 0, NULL );
+    buc.cell = tazR_stateVal( cell );
+    
+    tazE_collect( eng, true );
+    check( full->nursery == NULL );
+    check( tazR_isObjOld( tazR_toObj( cell ) ) );
+    
+    // State objects are kept in the remembered set once promoted.
+    check( tazR_isObjRemembered( tazR_toObj( cell ) ) );
+    
+    unsigned nold = countObjs( full->objects );
+    for( int i = 1 ; i < 100 ; i++ )
+        cons( eng, i, NULL );
+    
+    // Make sure the next one's a minor cycle.
+    full->nGCCycles = 1;
+    tazE_collect( eng, false );
+    check( full->nursery == NULL );
+    check( countObjs( full->objects ) == nold );
+    check( tazR_isObjRemembered( tazR_toObj( cell ) ) );
+    
+    tazE_remBucket( eng, &buc );
+    tazE_collect( eng, true );
+    check( countObjs( full->objects ) == nold - 1 );
+    check( full->remSetTop == 0 );
+end_test( generational_collection, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( incremental_collection, SETUP_ENGINE )
+    EngineFull* full = (EngineFull*)eng;
+    full->gcStepSize = 4;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) )
+        fail();
+    if( setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    Cell* cell = cons( eng, 0, NULL );
+    buc.cell = tazR_stateVal( cell );
+    
+    bool stepped = false;
+    for( int i = 1 ; i < 10000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+        stepped = stepped || full->gcPhase == GCPhase_MARK;
+    }
+    check( stepped );
+    
+    for( int i = 9999 ; i >= 0 ; i-- ) {
+        check( cell->car == i );
+        cell = cell->cdr;
+    }
+    
+    // An explicit collection should finish the cycle in progress.
+    tazE_remBucket( eng, &buc );
+    tazE_collect( eng, true );
+    check( full->gcPhase == GCPhase_IDLE );
+    check( full->nursery == NULL );
+    check( full->remSetTop == 0 );
+    
+    tazE_popBarrier( eng, &bar );
+end_test( incremental_collection, TEARDOWN_ENGINE )
+
+begin_test( lazy_sweeping, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    unsigned nbase = countObjs( full->objects ) + countObjs( full->nursery );
+    Cell*    cell  = NULL;
+    for( int i = 0 ; i < 1000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    tazE_collect( eng, true );
+    check( countObjs( full->objects ) == nbase + 1000 );
+    
+    // Drop the list and start a full cycle the way an allocation
+    // would, the old generation should be left unswept.
+    buc.cell = tazR_nil;
+    full->nGCCycles = 0;
+    stepGC( full, 0 );
+    check( full->gcPhase == GCPhase_SWEEP );
+    check( countObjs( full->sweepNext ) == nbase + 1000 );
+    
+    // Each object allocation should sweep a bit more.
+    unsigned nallocs = 0;
+    while( full->gcPhase == GCPhase_SWEEP ) {
+        unsigned nunswept = countObjs( full->sweepNext );
+        cons( eng, 0, NULL );
+        check( countObjs( full->sweepNext ) < nunswept );
+        nallocs++;
+    }
+    check( nallocs > 1 );
+    check( full->sweepNext == NULL );
+    check( countObjs( full->objects ) == nbase );
+    
+    tazE_remBucket( eng, &buc );
+end_test( lazy_sweeping, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( gc_statistics, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+        tazR_TVal    str;
+    } buc;
+    tazE_addBucket( eng, &buc, 2 );
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    size_t nStrs = stats.strCount;
+    
+    Cell* cell = NULL;
+    for( int i = 0 ; i < 1000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    buc.str = tazR_strVal( tazE_makeStr( eng, "medium string", 13 ) );
+    
+    tazE_collect( eng, false );
+    tazE_getStats( eng, &stats );
+    check( stats.liveObjects[tazR_Type_STATE] == 1000 );
+    check( stats.strCount == nStrs + 1 );
+    check( stats.strSlots >= stats.strCount );
+    check( stats.memUsed == ((EngineFull*)eng)->memUsed );
+    
+    ulongest cycles = stats.minorCycles + stats.fullCycles;
+    ulongest freed  = stats.bytesFreed;
+    check( cycles == ((EngineFull*)eng)->nGCCycles );
+    
+    buc.cell = tazR_udf;
+    buc.str  = tazR_udf;
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.liveObjects[tazR_Type_STATE] == 0 );
+    check( stats.strCount == nStrs );
+    check( stats.fullCycles >= 1 );
+    check( stats.minorCycles + stats.fullCycles == cycles + 1 );
+    check( stats.bytesFreed >= freed + 1000*sizeof(Cell) );
+    check( stats.markTime >= stats.lastMarkTime );
+    check( stats.sweepTime >= stats.lastSweepTime );
+    
+    ulongest pauses = 0;
+    for( unsigned i = 0 ; i < tazE_PAUSE_BUCKETS ; i++ )
+        pauses += stats.pauses[i];
+    check( pauses >= 2 );
+    
+    // Every pause length falls within the bounds of its bucket.
+    ulongest lens[] = { 0, 1, 3, 4, 5, 7, 8, 9, 1000, 123456, 1LLU << 31, (1LLU << 32) - 1 };
+    for( unsigned i = 0 ; i < elemsof(lens) ; i++ ) {
+        unsigned b = pauseBucket( lens[i] );
+        check( b < tazE_PAUSE_BUCKETS );
+        check( tazE_pauseBucketFloor( b ) <= lens[i] );
+        if( b + 1 < tazE_PAUSE_BUCKETS )
+            check( tazE_pauseBucketFloor( b + 1 ) > lens[i] );
+    }
+    
+    tazE_remBucket( eng, &buc );
+end_test( gc_statistics, TEARDOWN_ENGINE_AND_BARRIER )
+
+// A cell with a raw buffer hanging off of it.
+typedef struct {
+    tazR_State base;
+    tazR_TVal  next;
+    size_t     len;
+    char*      buf;
+} Blob;
+
+static void blobScan( tazE_Engine* eng, tazR_State* self, bool full ) {
+    tazE_markVal( eng, ((Blob*)self)->next );
+}
+
+static void blobFinl( tazE_Engine* eng, tazR_State* self ) {
+    tazE_freeRaw( eng, ((Blob*)self)->buf, ((Blob*)self)->len );
+}
+
+static size_t blobSize( tazE_Engine* eng, tazR_State* self ) {
+    return sizeof(Blob);
+}
+
+static size_t blobOwned( tazE_Engine* eng, tazR_State* self ) {
+    return ((Blob*)self)->len;
+}
+
+static Blob* makeBlob( tazE_Engine* eng, size_t len, tazR_TVal next ) {
+    tazE_ObjAnchor objA;
+    tazE_RawAnchor bufA;
+    Blob* blob = tazE_mallocObj( eng, &objA, sizeof(Blob), tazR_Type_STATE );
+    blob->base.scan  = blobScan;
+    blob->base.finl  = blobFinl;
+    blob->base.size  = blobSize;
+    blob->base.owned = blobOwned;
+    blob->base.save  = NULL;
+    blob->base.load  = NULL;
+    blob->next = next;
+    blob->len  = len;
+    blob->buf  = tazE_mallocRaw( eng, &bufA, len );
+    
+    tazE_commitRaw( eng, &bufA );
+    tazE_commitObj( eng, &objA );
+    return blob;
+}
+
+#define NUM_BLOBS (200)
+#define BLOB_LEN  (1000)
+
+begin_test( memory_accounting, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    head;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    buc.head = tazR_udf;
+    for( unsigned i = 0 ; i < NUM_BLOBS ; i++ )
+        buc.head = tazR_stateVal( (tazR_State*)makeBlob( eng, BLOB_LEN, buc.head ) );
+    
+    Blob*  blob    = (Blob*)tazR_getValState( buc.head );
+    size_t shallow = tazE_shallowSize( eng, blob );
+    check( shallow >= sizeof(tazR_Obj) + sizeof(Blob) );
+    check( tazE_deepSize( eng, blob ) == shallow + BLOB_LEN );
+    
+    // Object sizes are kept up to date, owned memory as of the last full
+    // cycle.
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    check( stats.liveBytes[tazR_Type_STATE] == NUM_BLOBS*shallow );
+    
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.liveBytes[tazR_Type_STATE] == NUM_BLOBS*shallow );
+    check( stats.ownedBytes[tazR_Type_STATE] == NUM_BLOBS*BLOB_LEN );
+    check( stats.strBytes > 0 );
+    
+    buc.head = blob->next;
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.liveBytes[tazR_Type_STATE] == (NUM_BLOBS - 1)*shallow );
+    check( stats.ownedBytes[tazR_Type_STATE] == (NUM_BLOBS - 1)*BLOB_LEN );
+    
+    // Promoting much more than survived the last full cycle brings the
+    // next one forward, however far off the interval would put it.
+    EngineFull* full = (EngineFull*)eng;
+    full->gcFullInterval = 1000;
+    ulongest fullCycles = stats.fullCycles;
+    for( unsigned i = 0 ; i < 20 ; i++ ) {
+        for( unsigned j = 0 ; j < NUM_BLOBS ; j++ )
+            buc.head = tazR_stateVal( (tazR_State*)makeBlob( eng, BLOB_LEN, buc.head ) );
+        tazE_collect( eng, false );
+    }
+    tazE_getStats( eng, &stats );
+    check( stats.fullCycles > fullCycles );
+    
+    tazE_remBucket( eng, &buc );
+end_test( memory_accounting, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( deferred_finalizers, )
+    taz_Config   cfg = { .alloc = alloc, .gcDeferFinalizers = true };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    size_t states = stats.liveObjects[tazR_Type_STATE];
+    
+    for( unsigned i = 0 ; i < NUM_BLOBS ; i++ )
+        makeBlob( eng, BLOB_LEN, tazR_udf );
+    
+    // The dead blobs are queued, with their buffers, until their
+    // finalizers are run.
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.finlPending == NUM_BLOBS );
+    check( stats.liveObjects[tazR_Type_STATE] == states + NUM_BLOBS );
+    
+    size_t used = stats.memUsed;
+    check( tazE_runFinalizers( eng, 10 ) == 10 );
+    tazE_getStats( eng, &stats );
+    check( stats.finlPending == NUM_BLOBS - 10 );
+    check( stats.memUsed < used );
+    
+    // The rest are run on the way back to the host.
+    tazE_popBarrier( eng, &bar );
+    tazE_getStats( eng, &stats );
+    check( stats.finlPending == 0 );
+    check( stats.liveObjects[tazR_Type_STATE] == states );
+    
+    tazE_freeEngine( eng );
+end_test( deferred_finalizers, )
+
+// Counts the blocks the host allocator has handed out, atomically, since
+// engines with a free thread give some back from there.
+static size_t hostBlocks = 0;
+
+static void* countingAlloc( void* old, size_t osz, size_t nsz ) {
+    if( !old && nsz > 0 )
+        __atomic_add_fetch( &hostBlocks, 1, __ATOMIC_RELAXED );
+    if( old && nsz == 0 )
+        __atomic_sub_fetch( &hostBlocks, 1, __ATOMIC_RELAXED );
+    return alloc( old, osz, nsz );
+}
+
+#if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+
+begin_test( background_freeing, )
+    size_t       blocks = hostBlocks;
+    taz_Config   cfg = { .alloc = countingAlloc, .gcFreeThread = true };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    EngineFull*  full = (EngineFull*)eng;
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    // Plenty of buffers to fill a few batches, and some big enough to
+    // be mapped.
+    for( unsigned i = 0 ; i < 4*taz_CONFIG_GC_FREE_BATCH_SIZE ; i++ )
+        makeBlob( eng, i % 100 == 0 ? taz_CONFIG_LARGE_OBJECT_SIZE : BLOB_LEN, tazR_udf );
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    size_t used = stats.memUsed;
+    
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.memUsed < used - 4*taz_CONFIG_GC_FREE_BATCH_SIZE*BLOB_LEN );
+    check( full->freeThread && full->freeThread->started );
+    
+    // The helper is done with everything once the engine's freed.
+    tazE_popBarrier( eng, &bar );
+    tazE_freeEngine( eng );
+    check( hostBlocks == blocks );
+end_test( background_freeing, )
+
+#endif
+
+typedef struct {
+    unsigned soft;
+    unsigned hard;
+} Pressure;
+
+static void onPressure( void* data, taz_Pressure level, size_t used ) {
+    Pressure* pressure = data;
+    if( level == taz_Pressure_SOFT )
+        pressure->soft++;
+    else
+        pressure->hard++;
+}
+
+#define SETUP_LIMITED_ENGINE                                                \
+    taz_Config   cfg = {                                                    \
+        .alloc        = alloc,                                              \
+        .gcHeapTarget = 16*1024,                                            \
+        .memSoftLimit = 256*1024,                                           \
+        .memHardLimit = 512*1024,                                           \
+        .onPressure   = onPressure,                                         \
+        .pressureData = &pressure                                           \
+    };                                                                      \
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+
+static Pressure pressure;
+
+// Cells are state objects, so they're all kept in the remembered set;
+// which, like the mark stack, isn't held to the limits.
+#define heapUsed( ENG ) ((ENG)->memUsed - (ENG)->remSetCap*sizeof(tazR_Obj*))
+
+begin_test( heap_limits, SETUP_LIMITED_ENGINE )
+    EngineFull* full = (EngineFull*)eng;
+    size_t      base = heapUsed( full );
+    check( full->memLimit == 16*1024 );
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.yieldDst ) )
+        fail();
+    if( setjmp( bar.errorDst ) ) {
+        check( bar.errnum == taz_ErrNum_HEAP_LIMIT );
+        check( pressure.soft > 0 );
+        check( pressure.hard == 1 );
+        check( heapUsed( full ) <= 512*1024 );
+        
+        // The engine is still usable, and the dropped bucket lets
+        // everything go.
+        tazE_collect( eng, true );
+        check( heapUsed( full ) <= base + sizeof(MarkSeg) );
+        pass();
+    }
+    tazE_pushBarrier( eng, &bar );
+    
+    // Garbage alone doesn't put the heap under pressure.
+    for( unsigned i = 0 ; i < 100000 ; i++ ) {
+        cons( eng, i, NULL );
+        check( heapUsed( full ) <= 256*1024 );
+    }
+    check( pressure.soft == 0 && pressure.hard == 0 );
+    
+    // Live data past the soft limit is reported, and allocation
+    // fails once the hard limit is reached.
+    tazE_addBucket( eng, &buc, 1 );
+    Cell* cell = NULL;
+    for( unsigned i = 0 ; i < 1000000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+        check( heapUsed( full ) <= 512*1024 );
+    }
+    fail();
+end_test( heap_limits, TEARDOWN_ENGINE )
+
+// Runs a heap held over its soft limit by live cells through a few MB of
+// garbage, and counts the full cycles that took.
+static ulongest softLimitFullCycles( size_t minAlloc ) {
+    taz_Config   cfg = {
+        .alloc          = alloc,
+        .gcHeapTarget   = 16*1024,
+        .gcFullInterval = 1000,
+        .gcFullMinAlloc = minAlloc,
+        .memSoftLimit   = 64*1024
+    };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.yieldDst ) || setjmp( bar.errorDst ) )
+        return 0;
+    tazE_pushBarrier( eng, &bar );
+    tazE_addBucket( eng, &buc, 1 );
+    
+    Cell* cell = NULL;
+    for( unsigned i = 0 ; i < 4000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    ulongest fullCycles = stats.fullCycles;
+    for( unsigned i = 0 ; i < 100000 ; i++ )
+        cons( eng, i, NULL );
+    tazE_getStats( eng, &stats );
+    
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    tazE_freeEngine( eng );
+    return stats.fullCycles - fullCycles;
+}
+
+// Without a floor every cycle run past the soft limit is a full one.
+begin_test( full_cycle_floor, )
+    ulongest unlimited = softLimitFullCycles( 0 );
+    ulongest limited   = softLimitFullCycles( 1024*1024 );
+    check( limited > 0 );
+    check( limited*4 < unlimited );
+end_test( full_cycle_floor, )
+
+// Finds the bytes given for a stack in a folded profile.
+static ulongest profileBytes( BufWriter* w, char const* stack ) {
+    size_t len = strlen( stack );
+    char*  it  = w->buf;
+    while( it && *it ) {
+        if( !strncmp( it, stack, len ) && it[len] == ' ' )
+            return strtoull( it + len + 1, NULL, 10 );
+        it = strchr( it, '\n' );
+        if( it )
+            it++;
+    }
+    return 0;
+}
+
+begin_test( allocation_sampling, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    outer;
+        tazR_TVal    keep;
+        tazR_TVal    drop;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 4 );
+    
+    buc.outer = tazR_strVal( tazE_makeStr( eng, "outerFunction", 13 ) );
+    buc.keep  = tazR_strVal( tazE_makeStr( eng, "keep", 4 ) );
+    buc.drop  = tazR_strVal( tazE_makeStr( eng, "dropper", 7 ) );
+    
+    check( tazE_startSampling( eng, 1024 ) );
+    
+    sampleDepth     = 2;
+    sampleFrames[1] = (tazE_Frame){ tazR_getValStr( buc.outer ), 4 };
+    sampleFrames[0] = (tazE_Frame){ tazR_getValStr( buc.keep ), 10 };
+    Cell* cell = NULL;
+    for( unsigned i = 0 ; i < 2000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    
+    sampleFrames[0] = (tazE_Frame){ tazR_getValStr( buc.drop ), -1 };
+    for( unsigned i = 0 ; i < 2000 ; i++ )
+        cons( eng, i, NULL );
+    
+    sampleDepth = 0;
+    for( unsigned i = 0 ; i < 100 ; i++ )
+        cons( eng, i, NULL );
+    
+    tazE_collect( eng, true );
+    
+    // Each stack is credited with about what it allocated.
+    ulongest  bytes = 2000*(sizeof(tazR_Obj) + sizeof(Cell));
+    BufWriter alloc = { .base = { .write = bufWrite } };
+    check( tazE_writeSamples( eng, &alloc.base, tazE_Profile_ALLOC ) );
+    ulongest kept    = profileBytes( &alloc, "outerFunction+4;keep+10" );
+    ulongest dropped = profileBytes( &alloc, "outerFunction+4;dropper" );
+    check( kept > bytes/2 && kept < bytes*3/2 );
+    check( dropped > bytes/2 && dropped < bytes*3/2 );
+    check( profileBytes( &alloc, "[host]" ) < bytes/2 );
+    
+    // But only the kept cells are still alive.
+    BufWriter live = { .base = { .write = bufWrite } };
+    check( tazE_writeSamples( eng, &live.base, tazE_Profile_LIVE ) );
+    check( profileBytes( &live, "outerFunction+4;keep+10" ) == kept );
+    check( profileBytes( &live, "outerFunction+4;dropper" ) == 0 );
+    
+    // Once the cells die they're taken off the sample list.
+    buc.cell = tazR_udf;
+    tazE_collect( eng, true );
+    check( ((EngineFull*)eng)->sampler->objTop == 0 );
+    
+    free( alloc.buf );
+    free( live.buf );
+    tazE_stopSampling( eng );
+    check( ((EngineFull*)eng)->sampler == NULL );
+    
+    tazE_remBucket( eng, &buc );
+end_test( allocation_sampling, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( object_heap, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    // Cells of the same size should be packed into the same pages.
+    Cell* cell1 = cons( eng, 0, NULL );
+    Cell* cell2 = cons( eng, 1, cell1 );
+    buc.cell = tazR_stateVal( cell2 );
+    check( pageOf( tazR_toObj( cell1 ) ) == pageOf( tazR_toObj( cell2 ) ) );
+    check( pageOf( tazR_toObj( cell1 ) )->cls == sizeClassOf( sizeof(tazR_Obj) + sizeof(Cell) ) );
+    
+    // Allocate enough to need a few chunks, then let them go; all
+    // but one chunk should be given back.
+    unsigned n = 4*taz_CONFIG_HEAP_CHUNK_SIZE/classSizeTable[sizeClassOf( sizeof(tazR_Obj) + sizeof(Cell) )];
+    Cell* cell = cell2;
+    for( unsigned i = 0 ; i < n ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    check( full->heapChunks->next != NULL );
+    
+    buc.cell = tazR_nil;
+    tazE_collect( eng, true );
+    check( full->heapChunks != NULL && full->heapChunks->next == NULL );
+    
+    // Big objects go straight to the callback.
+    tazE_ObjAnchor anc;
+    void* big = tazE_mallocObj( eng, &anc, 2*MAX_CLASS_SIZE, tazR_Type_STATE );
+    check( sizeClassOf( 2*MAX_CLASS_SIZE ) == NO_CLASS );
+    tazE_cancelObj( eng, &anc );
+    
+    tazE_remBucket( eng, &buc );
+end_test( object_heap, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( side_mark_bits, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    Cell* cells[100];
+    Cell* cell = NULL;
+    for( unsigned i = 0 ; i < elemsof(cells) ; i++ ) {
+        cell = cons( eng, i, cell );
+        cells[i] = cell;
+        buc.cell = tazR_stateVal( cell );
+    }
+    tazE_collect( eng, true );
+    
+    // With nothing to collect a full cycle shouldn't write to the
+    // headers of the old objects, their marks are kept elsewhere.
+    tazR_TPtr tags[elemsof(cells)];
+    for( unsigned i = 0 ; i < elemsof(cells) ; i++ ) {
+        check( tazR_isObjPaged( tazR_toObj( cells[i] ) ) );
+        tags[i] = ((tazR_Obj*)tazR_toObj( cells[i] ))->next_and_tag;
+    }
+    tazE_collect( eng, true );
+    for( unsigned i = 0 ; i < elemsof(cells) ; i++ ) {
+        tazR_Obj* obj = tazR_toObj( cells[i] );
+        check( memcmp( &obj->next_and_tag, &tags[i], sizeof(tazR_TPtr) ) == 0 );
+        check( !isObjMarked( obj ) );
+    }
+    
+    // With garbage in between the survivors only have their links
+    // rewritten, where the object after them was unlinked.
+    EngineFull* full = (EngineFull*)eng;
+    Cell*       junk = NULL;
+    cell = NULL;
+    for( unsigned i = 0 ; i < elemsof(cells) ; i++ ) {
+        cell = cons( eng, i, cell );
+        cells[i] = cell;
+        buc.cell = tazR_stateVal( cell );
+        junk = cons( eng, i, junk );
+        eng->apiState = (tazR_State*)junk;
+    }
+    tazE_collect( eng, true );
+    tazE_collect( eng, true );
+    
+    unsigned nobjs = countObjs( full->objects );
+    for( unsigned i = 0 ; i < elemsof(cells) ; i++ )
+        tags[i] = ((tazR_Obj*)tazR_toObj( cells[i] ))->next_and_tag;
+    eng->apiState = NULL;
+    tazE_collect( eng, true );
+    check( countObjs( full->objects ) == nobjs - elemsof(cells) );
+    
+    unsigned relinked = 0;
+    for( unsigned i = 0 ; i < elemsof(cells) ; i++ ) {
+        tazR_Obj* obj = tazR_toObj( cells[i] );
+        check( tazR_getPtrTag( obj->next_and_tag ) == tazR_getPtrTag( tags[i] ) );
+        check( !isObjMarked( obj ) );
+        if( tazR_getPtrAddr( obj->next_and_tag ) != tazR_getPtrAddr( tags[i] ) )
+            relinked++;
+    }
+    check( relinked > 0 );
+    
+    tazE_remBucket( eng, &buc );
+end_test( side_mark_bits, TEARDOWN_ENGINE_AND_BARRIER )
+
+typedef struct Node Node;
+
+struct Node {
+    tazR_State base;
+    unsigned   nkids;
+    Node*      kids[];
+};
+
+static void nodeScan( tazE_Engine* eng, tazR_State* self, bool full ) {
+    Node* node = (Node*)self;
+    
+    for( unsigned i = 0 ; i < node->nkids ; i++ ) {
+        if( node->kids[i] )
+            tazE_markObj( eng, node->kids[i] );
+    }
+}
+
+static size_t nodeSize( tazE_Engine* eng, tazR_State* self ) {
+    return sizeof(Node) + sizeof(Node*)*((Node*)self)->nkids;
+}
+
+static Node* makeNode( tazE_Engine* eng, unsigned nkids ) {
+    tazE_ObjAnchor anc;
+    Node* node = tazE_zallocObj( eng, &anc, sizeof(Node) + sizeof(Node*)*nkids, tazR_Type_STATE );
+    node->base.scan = nodeScan;
+    node->base.size = nodeSize;
+    node->nkids     = nkids;
+    
+    tazE_commitObj( eng, &anc );
+    return node;
 }
 
-#define SETUP_ENGINE_AND_BARRIER                                            \
-    taz_Config   cfg = { .alloc = alloc };                                  \
-    tazE_Engine* eng = tazE_makeEngine( &cfg );                             \
-    tazE_Barrier bar = { 0 };                                               \
-    if( setjmp( bar.errorDst ) )                                            \
-        fail();                                                             \
-    if( setjmp( bar.yieldDst ) )                                            \
-        fail();                                                             \
-    tazE_pushBarrier( eng, &bar );
-    
-#define TEARDOWN_ENGINE_AND_BARRIER                                         \
-    tazE_popBarrier( eng, &bar );                                           \
-    tazE_freeEngine( eng );
+static unsigned failedSegAllocs = 0;
+static void* failSegAlloc( void* old, size_t osz, size_t nsz ) {
+    if( nsz == sizeof(MarkSeg) ) {
+        failedSegAllocs++;
+        return NULL;
+    }
+    return alloc( old, osz, nsz );
+}
 
-begin_test( malloc_and_collect_objects, SETUP_ENGINE_AND_BARRIER )
+begin_test( deep_marking, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    
     struct {
         tazE_Bucket  base;
-        tazR_TVal    cell;
+        tazR_TVal    root;
     } buc;
     tazE_addBucket( eng, &buc, 1 );
     
-    Cell* cell = cons( eng, 0, NULL );
-    buc.cell = tazR_stateVal( cell );
+    // A comb, each node has a leaf and the next node; so the leaves
+    // pile up on the gray stack while the spine is traced.
+    unsigned nbase = countObjs( full->objects ) + countObjs( full->nursery );
+    unsigned depth = 64*taz_CONFIG_GC_STACK_SEGMENT_SIZE;
+    Node* root = makeNode( eng, 2 );
+    buc.root = tazR_stateVal( root );
     
-    for( int i = 1 ; i < 10000 ; i++ ) {
-        cell = cons( eng, i, cell );
-        buc.cell = tazR_stateVal( cell );
+    Node* node = root;
+    for( unsigned i = 1 ; i < depth ; i++ ) {
+        node->kids[0] = makeNode( eng, 0 );
+        node->kids[1] = makeNode( eng, 2 );
+        node = node->kids[1];
     }
+    unsigned nnodes = 2*depth - 1;
+    
+    tazE_collect( eng, true );
+    check( countObjs( full->objects ) == nbase + nnodes );
+    check( full->gcStack.seg == NULL );
+    check( full->gcStack.spare != NULL );
+    
+    // Without any segments to spare the overflow should be caught
+    // by rescanning.
+    freeMarkStack( full, &full->gcStack );
+    full->alloc = failSegAlloc;
+    tazE_collect( eng, true );
+    full->alloc = alloc;
+    check( failedSegAllocs > 0 );
+    check( !full->gcStackOverflow );
+    check( countObjs( full->objects ) == nbase + nnodes );
     
     tazE_remBucket( eng, &buc );
+    tazE_collect( eng, true );
+    check( countObjs( full->objects ) == nbase );
+end_test( deep_marking, TEARDOWN_ENGINE_AND_BARRIER )
+
+#if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+
+begin_test( parallel_marking, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    full->gcMarkThreads = 4;
     
-    check( ((EngineFull*)eng)->nGCCycles > 0 );
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    root;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
     
-    // Touch all cells to make sure they're still alive, issues here
-    // may not be caught by the test itself, but will be caught by
-    // valgrind and similar tools.
-    for( int i = 9999 ; i >= 0 ; i-- ) {
-        check( cell->car == i );
-        cell = cell->cdr;
+    // Make the root wider than a deque, so some of the
+    // work overflows.
+    unsigned nbase = countObjs( full->objects ) + countObjs( full->nursery );
+    Node* root = makeNode( eng, 2*taz_CONFIG_GC_MARK_DEQUE_SIZE );
+    buc.root = tazR_stateVal( root );
+    for( unsigned i = 0 ; i < root->nkids ; i++ ) {
+        Node* kid = makeNode( eng, 8 );
+        root->kids[i] = kid;
+        for( unsigned j = 0 ; j < kid->nkids ; j++ )
+            kid->kids[j] = makeNode( eng, 0 );
     }
+    unsigned nnodes = 1 + root->nkids*9;
+    
+    tazE_collect( eng, true );
+    check( full->gcMarkWorkers != NULL );
+    check( countObjs( full->objects ) == nbase + nnodes );
     
+    // Minor cycles are marked serially, and the threads are kept
+    // between full cycles.
+    unsigned rounds = full->gcMarkRound;
     tazE_collect( eng, false );
-end_test( malloc_and_collect_objects, TEARDOWN_ENGINE_AND_BARRIER )
+    check( full->gcMarkRound == rounds );
+    tazE_collect( eng, true );
+    check( full->gcMarkRound > rounds );
+    check( countObjs( full->objects ) == nbase + nnodes );
+    
+    tazE_remBucket( eng, &buc );
+    tazE_collect( eng, true );
+    check( countObjs( full->objects ) == nbase );
+end_test( parallel_marking, TEARDOWN_ENGINE_AND_BARRIER )
+
+#endif
 
 begin_test( zalloc_and_cancel_objects, SETUP_ENGINE_AND_BARRIER )
     
@@ -129,6 +951,633 @@ begin_test( raw_memory_management, SETUP_ENGINE_AND_BARRIER )
     tazE_cancelRaw( eng, &anc );
 end_test( raw_memory_management, TEARDOWN_ENGINE_AND_BARRIER )
 
+begin_test( scratch_allocations, SETUP_ENGINE )
+    EngineFull* full = (EngineFull*)eng;
+    size_t      used = full->memUsed;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    // Scratch memory doesn't touch the heap until it's committed.
+    tazE_RawAnchor anc, tmp;
+    char  str[] = "Hello, World!";
+    char* raw   = tazE_scratchRaw( eng, &anc, sizeof(str) );
+    strcpy( raw, str );
+    char* more  = tazE_scratchRaw( eng, &tmp, 100 );
+    check( more != raw );
+    check( full->memUsed == used );
+    check( bar.rawAnchors == NULL );
+    
+    // The most recent allocation grows in place.
+    check( tazE_reallocRaw( eng, &tmp, 200 ) == more );
+    tazE_cancelRaw( eng, &tmp );
+    
+    char* committed = tazE_commitRaw( eng, &anc );
+    check( committed != raw && committed == anc.raw );
+    check( !strcmp( committed, str ) );
+    check( full->memUsed > used );
+    
+    // Big requests go to the heap.
+    tazE_scratchRaw( eng, &tmp, taz_CONFIG_SCRATCH_CHUNK_SIZE );
+    check( bar.rawAnchors == &tmp );
+    tazE_cancelRaw( eng, &tmp );
+    
+    tazE_popBarrier( eng, &bar );
+    check( full->scratch == NULL );
+    tazE_freeRaw( eng, committed, sizeof(str) );
+    
+    // An error gives back everything a barrier took, across chunks.
+    tazE_Barrier outer = { 0 };
+    if( setjmp( outer.errorDst ) || setjmp( outer.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &outer );
+    char* kept = tazE_scratchRaw( eng, &anc, 64 );
+    memset( kept, 'k', 64 );
+    
+    tazE_Barrier inner = { 0 };
+    if( setjmp( inner.yieldDst ) )
+        fail();
+    if( setjmp( inner.errorDst ) ) {
+        check( full->scratch != NULL && full->scratch->bump == kept + 64 );
+        check( full->scratchSpare != NULL );
+        check( kept[0] == 'k' && kept[63] == 'k' );
+        
+        tazE_popBarrier( eng, &outer );
+        check( full->scratch == NULL );
+        check( full->memUsed == used );
+        pass();
+    }
+    tazE_pushBarrier( eng, &inner );
+    for( unsigned i = 0 ; i < 10 ; i++ )
+        tazE_scratchRaw( eng, &tmp, SCRATCH_MAX );
+    check( full->scratch->next != NULL );
+    tazE_error( eng, taz_ErrNum_OTHER );
+    fail();
+end_test( scratch_allocations, TEARDOWN_ENGINE )
+
+#if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+
+begin_test( large_object_space, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    
+    // Large buffers are mapped, and accounted for, in whole pages.
+    size_t used = full->memUsed;
+    size_t sz   = taz_CONFIG_LARGE_OBJECT_SIZE + 1;
+    
+    tazE_RawAnchor anc;
+    char* raw = tazE_zallocRaw( eng, &anc, sz );
+    check( raw[0] == 0 && raw[sz - 1] == 0 );
+    check( full->largeUsed == largeSize( full, sz ) );
+    check( full->memUsed == used + largeSize( full, sz ) );
+    memset( raw, 'x', sz );
+    tazE_commitRaw( eng, &anc );
+    
+    // Growth keeps the contents.
+    raw = tazE_reallocRaw( eng, &anc, 4*sz );
+    tazE_commitRaw( eng, &anc );
+    check( raw[0] == 'x' && raw[sz - 1] == 'x' );
+    check( full->largeUsed == largeSize( full, 4*sz ) );
+    
+    // As does shrinking back below the threshold.
+    raw = tazE_reallocRaw( eng, &anc, 16 );
+    tazE_commitRaw( eng, &anc );
+    check( raw[0] == 'x' && raw[15] == 'x' );
+    check( full->largeUsed == 0 );
+    check( full->memUsed == used + 16 );
+    
+    raw = tazE_reallocRaw( eng, &anc, sz );
+    tazE_commitRaw( eng, &anc );
+    check( raw[0] == 'x' && raw[15] == 'x' );
+    
+    // Released mappings are kept as spares and come back zeroed.
+    tazE_freeRaw( eng, raw, sz );
+    check( full->largeUsed == 0 );
+    check( full->largeSpare == raw );
+    check( full->memUsed == used );
+    
+    raw = tazE_zallocRaw( eng, &anc, 2*sz );
+    check( full->largeSpare == NULL );
+    check( raw[0] == 0 && raw[2*sz - 1] == 0 );
+    tazE_cancelRaw( eng, &anc );
+end_test( large_object_space, TEARDOWN_ENGINE_AND_BARRIER )
+
+#endif
+
+begin_test( arena_engine, )
+    taz_Config   cfg = { .alloc = countingAlloc, .arenaChunkSize = 64*1024 };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    EngineFull*  full = (EngineFull*)eng;
+    check( eng != NULL && full->arena != NULL );
+    check( (void*)eng > (void*)full->arena && (void*)eng < (void*)full->arena->end );
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    
+    // Objects and collections work as usual.
+    Cell* cell = NULL;
+    for( int i = 0 ; i < 10000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    tazE_collect( eng, true );
+    int n = 0;
+    for( Cell* it = cell ; it ; it = it->cdr )
+        check( it->car == 10000 - ++n );
+    check( n == 10000 );
+    
+    // The last allocation is grown in place, others are copied.
+    tazE_RawAnchor anc1, anc2;
+    char* raw1 = tazE_mallocRaw( eng, &anc1, 100 );
+    memset( raw1, 'x', 100 );
+    tazE_commitRaw( eng, &anc1 );
+    check( tazE_reallocRaw( eng, &anc1, 200 ) == raw1 );
+    tazE_commitRaw( eng, &anc1 );
+    char* raw2 = tazE_mallocRaw( eng, &anc2, 100 );
+    tazE_commitRaw( eng, &anc2 );
+    raw1 = tazE_reallocRaw( eng, &anc1, 400 );
+    tazE_commitRaw( eng, &anc1 );
+    check( raw1 != raw2 && raw1[0] == 'x' && raw1[99] == 'x' );
+    
+    // Large buffers are kept in the arena too, and still zeroed.
+    size_t sz  = taz_CONFIG_LARGE_OBJECT_SIZE + 1;
+    char*  big = tazE_zallocRaw( eng, &anc1, sz );
+    check( big[0] == 0 && big[sz - 1] == 0 );
+    tazE_commitRaw( eng, &anc1 );
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        check( full->largeUsed == 0 );
+    #endif
+    
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    
+    // Teardown hands every chunk back.
+    check( hostBlocks > 0 );
+    tazE_freeEngine( eng );
+    check( hostBlocks == 0 );
+end_test( arena_engine, )
+
+begin_test( reset_engine, SETUP_ENGINE )
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    size_t baseStrs = stats.strCount;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket  base;
+        tazR_TVal    cell;
+        tazR_TVal    str;
+    } buc;
+    tazE_addBucket( eng, &buc, 2 );
+    
+    // A stand in for the environment, and a string that's only held
+    // until the request is done.
+    Cell* env = NULL;
+    for( int i = 0 ; i < 10 ; i++ )
+        env = cons( eng, i, env );
+    eng->envState = (tazR_State*)env;
+    buc.str = tazR_strVal( tazE_makeStr( eng, "a string interned while serving a request", 41 ) );
+    
+    Cell* cell = NULL;
+    for( unsigned i = 0 ; i < 1000 ; i++ ) {
+        cell = cons( eng, i, cell );
+        buc.cell = tazR_stateVal( cell );
+    }
+    
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    
+    // The environment is kept as it was, and so are the strings.
+    tazE_resetEngine( eng, tazE_Keep_ENV | tazE_Keep_STRS );
+    tazE_getStats( eng, &stats );
+    check( eng->envState == (tazR_State*)env );
+    check( stats.liveObjects[tazR_Type_STATE] == 10 );
+    check( stats.strCount == baseStrs + 1 );
+    for( int i = 0 ; i < 10 ; i++, env = env->cdr )
+        check( env->car == 9 - i );
+    
+    // Then everything goes, but for the error messages.
+    tazE_resetEngine( eng, 0 );
+    tazE_getStats( eng, &stats );
+    check( eng->envState == NULL );
+    check( stats.liveObjects[tazR_Type_STATE] == 0 );
+    check( stats.strCount == baseStrs );
+end_test( reset_engine, TEARDOWN_ENGINE )
+
+static bool warmEngine( void* data, tazE_Engine* eng ) {
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        return false;
+    tazE_pushBarrier( eng, &bar );
+    eng->envState = (tazR_State*)cons( eng, 42, NULL );
+    tazE_popBarrier( eng, &bar );
+    
+    __atomic_add_fetch( (unsigned*)data, 1, __ATOMIC_RELAXED );
+    return true;
+}
+
+// Does a request's worth of work on an engine from the pool.
+static bool usePooled( tazE_Pool* pool ) {
+    tazE_Engine* eng = tazE_takeEngine( pool );
+    if( !eng || ((Cell*)eng->envState)->car != 42 )
+        return false;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        return false;
+    tazE_pushBarrier( eng, &bar );
+    for( unsigned i = 0 ; i < 100 ; i++ )
+        cons( eng, i, NULL );
+    tazE_popBarrier( eng, &bar );
+    
+    tazE_giveEngine( pool, eng );
+    return true;
+}
+
+#if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+    static void* poolThreadMain( void* pool ) {
+        for( unsigned i = 0 ; i < 50 ; i++ ) {
+            if( !usePooled( pool ) )
+                return pool;
+        }
+        return NULL;
+    }
+#endif
+
+begin_test( engine_pool, )
+    taz_Config cfg   = { .alloc = countingAlloc };
+    unsigned   warms = 0;
+    tazE_Pool* pool  = tazE_makePool( &cfg, 2, tazE_Keep_ENV, warmEngine, &warms );
+    check( pool != NULL && warms == 2 );
+    
+    // Engines are made as needed once the pool runs dry...
+    tazE_Engine* engs[3];
+    for( unsigned i = 0 ; i < 3 ; i++ ) {
+        engs[i] = tazE_takeEngine( pool );
+        check( engs[i] != NULL && ((Cell*)engs[i]->envState)->car == 42 );
+    }
+    check( warms == 3 );
+    
+    // ...and only as many as fit are kept when they're given back.
+    for( unsigned i = 0 ; i < 3 ; i++ )
+        tazE_giveEngine( pool, engs[i] );
+    for( unsigned i = 0 ; i < 10 ; i++ )
+        check( usePooled( pool ) );
+    check( warms == 3 );
+    
+    tazE_freePool( pool );
+    check( hostBlocks == 0 );
+    
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        cfg.alloc = alloc;
+        pool = tazE_makePool( &cfg, 2, tazE_Keep_ENV, warmEngine, &warms );
+        
+        pthread_t threads[4];
+        for( unsigned i = 0 ; i < 4 ; i++ )
+            check( !pthread_create( &threads[i], NULL, poolThreadMain, pool ) );
+        for( unsigned i = 0 ; i < 4 ; i++ ) {
+            void* failed;
+            pthread_join( threads[i], &failed );
+            check( !failed );
+        }
+        tazE_freePool( pool );
+    #endif
+end_test( engine_pool, )
+
+typedef struct Pair Pair;
+
+struct Pair {
+    tazR_State base;
+    tazR_TVal  fst;
+    tazR_TVal  snd;
+};
+
+static void pairScan( tazE_Engine* eng, tazR_State* self, bool full ) {
+    tazE_markVal( eng, ((Pair*)self)->fst );
+    tazE_markVal( eng, ((Pair*)self)->snd );
+}
+
+static size_t pairSize( tazE_Engine* eng, tazR_State* self ) {
+    return sizeof(Pair);
+}
+
+static void pairSave( tazE_Engine* eng, tazR_State* self, tazE_Image* img ) {
+    tazE_saveVal( eng, img, ((Pair*)self)->fst );
+    tazE_saveVal( eng, img, ((Pair*)self)->snd );
+}
+
+static void pairLoad( tazE_Engine* eng, tazR_State* self, tazE_Image* img ) {
+    Pair* pair = (Pair*)self;
+    if( tazE_loadSize( eng, img ) != sizeof(Pair) )
+        tazE_error( eng, taz_ErrNum_OTHER );
+    
+    pair->base.scan  = pairScan;
+    pair->base.finl  = NULL;
+    pair->base.size  = pairSize;
+    pair->base.owned = NULL;
+    pair->base.save  = pairSave;
+    pair->base.load  = pairLoad;
+    pair->fst = tazE_loadVal( eng, img );
+    pair->snd = tazE_loadVal( eng, img );
+}
+
+static Pair* makePair( tazE_Engine* eng, tazR_TVal fst, tazR_TVal snd ) {
+    tazE_ObjAnchor anc;
+    Pair* pair = tazE_mallocObj( eng, &anc, sizeof(Pair), tazR_Type_STATE );
+    pair->base.scan  = pairScan;
+    pair->base.finl  = NULL;
+    pair->base.size  = pairSize;
+    pair->base.owned = NULL;
+    pair->base.save  = pairSave;
+    pair->base.load  = pairLoad;
+    pair->fst = fst;
+    pair->snd = snd;
+    
+    tazE_commitObj( eng, &anc );
+    return pair;
+}
+
+static bool strIs( tazE_Engine* eng, tazR_TVal val, char const* str ) {
+    char buf[64];
+    if( tazR_getValType( val ) != tazR_Type_STR )
+        return false;
+    
+    size_t len = copyStr( (EngineFull*)eng, tazR_getValStr( val ), buf, sizeof(buf) );
+    return len == strlen( str ) && !memcmp( buf, str, len );
+}
+
+#define NUM_PAIRS (300)
+
+static void pairStr( unsigned i, char* buf ) {
+    switch( i % 3 ) {
+        case 0: sprintf( buf, "%u", i % 1000 ); break;
+        case 1: sprintf( buf, "medium %u", i ); break;
+        case 2: sprintf( buf, "a long string, number %u of them", i ); break;
+    }
+}
+
+// Writes the sum of the first `len` bytes of an image after them, as
+// if it had been saved that way.
+static void sealImage( char* buf, size_t len ) {
+    ulongest sum = IMAGE_SUM_BASIS;
+    for( size_t i = 0 ; i < len ; i++ )
+        sum = (sum ^ (uchar)buf[i])*IMAGE_SUM_PRIME;
+    for( unsigned i = 0 ; i < 8 ; i++ )
+        buf[len + i] = (char)(sum >> i*8);
+}
+
+// Checks the pairs list is as `image_round_trip` built it.
+static bool checkPairs( tazE_Engine* eng ) {
+    Pair* pair = (Pair*)eng->envState;
+    for( unsigned i = NUM_PAIRS ; i-- > 0 ; ) {
+        char buf[64];
+        pairStr( i, buf );
+        if( !pair || !strIs( eng, pair->fst, buf ) )
+            return false;
+        
+        tazR_TVal next = pair->snd;
+        pair = i > 0 ? (Pair*)tazR_getValState( next ) : NULL;
+        if( i == 0 && tazR_getValType( next ) != tazR_Type_DEC )
+            return false;
+    }
+    return true;
+}
+
+begin_test( image_round_trip, SETUP_ENGINE )
+    BufWriter    w    = { .base = { .write = bufWrite } };
+    tazE_Engine* copy = NULL;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   head;
+        tazR_TVal   str;
+    } buc;
+    tazE_addBucket( eng, &buc, 2 );
+    
+    buc.head = tazR_decVal( 1.5 );
+    for( unsigned i = 0 ; i < NUM_PAIRS ; i++ ) {
+        char buf[64];
+        pairStr( i, buf );
+        buc.str  = tazR_strVal( tazE_makeStr( eng, buf, strlen( buf ) ) );
+        buc.head = tazR_stateVal( makePair( eng, buc.str, buc.head ) );
+        
+        // Garbage, which shouldn't make it into the image.
+        makePair( eng, buc.str, tazR_udf );
+    }
+    eng->envState = tazR_getValState( buc.head );
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    
+    check( tazE_saveImage( eng, &w.base ) );
+    copy = tazE_loadImage( &cfg, w.buf, w.len );
+    check( copy );
+    check( checkPairs( copy ) );
+    
+    tazE_Stats stats;
+    tazE_getStats( copy, &stats );
+    check( stats.liveObjects[tazR_Type_STATE] == NUM_PAIRS );
+    
+    // The loaded strings are still interned, and survive collection.
+    tazE_collect( copy, true );
+    tazE_collect( copy, true );
+    check( checkPairs( copy ) );
+    
+    Pair* head = (Pair*)copy->envState;
+    char  buf[64];
+    pairStr( NUM_PAIRS - 2, buf );
+    tazR_TVal next = head->snd;
+    check( tazR_valEqual( ((Pair*)tazR_getValState( next ))->fst, tazR_strVal( tazE_makeStr( copy, buf, strlen( buf ) ) ) ) );
+    tazE_freeEngine( copy );
+    copy = NULL;
+    
+    // Damaged or truncated images are turned away.
+    w.buf[w.len/2] ^= 0x10;
+    check( !tazE_loadImage( &cfg, w.buf, w.len ) );
+    w.buf[w.len/2] ^= 0x10;
+    check( !tazE_loadImage( &cfg, w.buf, w.len - 1 ) );
+    check( !tazE_loadImage( &cfg, w.buf, 4 ) );
+    
+    // Even when the sum is made to match, so loading fails partway.
+    char* cut = malloc( w.len );
+    for( size_t len = 16 ; len < w.len - 8 ; len += 61 ) {
+        memcpy( cut, w.buf, len );
+        sealImage( cut, len );
+        check( !tazE_loadImage( &cfg, cut, len + 8 ) );
+    }
+    free( cut );
+    
+    #if taz_CONFIG_ENABLE_IMAGE_MAPPING
+        char  path[] = "/tmp/taz_image_XXXXXX";
+        int   fd     = mkstemp( path );
+        check( fd >= 0 );
+        check( write( fd, w.buf, w.len ) == (ssize_t)w.len );
+        close( fd );
+        
+        copy = tazE_mapImage( &cfg, path );
+        unlink( path );
+        check( copy && checkPairs( copy ) );
+        tazE_freeEngine( copy );
+        copy = NULL;
+    #endif
+    
+    // States without hooks can't be saved.
+    tazE_pushBarrier( eng, &bar );
+    eng->apiState = (tazR_State*)cons( eng, 1, NULL );
+    tazE_popBarrier( eng, &bar );
+    
+    w.len = 0;
+    check( !tazE_saveImage( eng, &w.base ) );
+end_test( image_round_trip, { free( w.buf ); if( copy ) tazE_freeEngine( copy ); TEARDOWN_ENGINE } )
+
+// Builds garbage in an engine sharing `handle`, along with pairs that
+// reference the frozen pairs and strings, and checks that collecting it
+// leaves both intact.  The handle is the frozen engine itself.
+static bool useShared( taz_Shared* handle ) {
+    tazE_Engine* frozen = (tazE_Engine*)handle;
+    taz_Config   cfg    = { .alloc = alloc, .shared = handle };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    if( !eng )
+        return false;
+    
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        return false;
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   head;
+        tazR_TVal   str;
+        tazR_TVal   pair;
+    } buc;
+    tazE_addBucket( eng, &buc, 3 );
+    
+    bool  ok     = true;
+    Pair* shared = (Pair*)frozen->envState;
+    buc.head = tazR_udf;
+    for( unsigned i = NUM_PAIRS ; i-- > 0 ; ) {
+        char buf[64];
+        pairStr( i, buf );
+        buc.str = tazR_strVal( tazE_makeStr( eng, buf, strlen( buf ) ) );
+        
+        // Medium strings the frozen engine has are the same string here.
+        if( i % 3 == 1 && !tazR_valEqual( buc.str, shared->fst ) )
+            ok = false;
+        
+        buc.pair = tazR_stateVal( makePair( eng, buc.str, tazR_stateVal( (tazR_State*)shared ) ) );
+        buc.head = tazR_stateVal( makePair( eng, buc.pair, buc.head ) );
+        
+        sprintf( buf, "unshared %u", i );
+        buc.str = tazR_strVal( tazE_makeStr( eng, buf, strlen( buf ) ) );
+        makePair( eng, buc.str, tazR_udf );
+        
+        shared = i > 0 ? (Pair*)tazR_getValState( shared->snd ) : NULL;
+    }
+    tazE_collect( eng, true );
+    tazE_collect( eng, false );
+    tazE_collect( eng, true );
+    
+    for( unsigned i = 0 ; ok && i < NUM_PAIRS ; i++ ) {
+        char  buf[64];
+        Pair* link = (Pair*)tazR_getValState( buc.head );
+        Pair* pair = (Pair*)tazR_getValState( link->fst );
+        pairStr( i, buf );
+        ok = strIs( eng, pair->fst, buf ) &&
+             strIs( eng, ((Pair*)tazR_getValState( pair->snd ))->fst, buf );
+        
+        buc.head = link->snd;
+    }
+    
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    tazE_freeEngine( eng );
+    return ok;
+}
+
+#if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+    static void* sharedThreadMain( void* shared ) {
+        for( unsigned i = 0 ; i < 5 ; i++ ) {
+            if( !useShared( shared ) )
+                return shared;
+        }
+        return NULL;
+    }
+#endif
+
+begin_test( shared_engine, SETUP_ENGINE )
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   head;
+        tazR_TVal   str;
+    } buc;
+    tazE_addBucket( eng, &buc, 2 );
+    
+    buc.head = tazR_decVal( 1.5 );
+    for( unsigned i = 0 ; i < NUM_PAIRS ; i++ ) {
+        char buf[64];
+        pairStr( i, buf );
+        buc.str  = tazR_strVal( tazE_makeStr( eng, buf, strlen( buf ) ) );
+        buc.head = tazR_stateVal( makePair( eng, buc.str, buc.head ) );
+        makePair( eng, buc.str, tazR_udf );
+    }
+    eng->envState = tazR_getValState( buc.head );
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    
+    taz_Shared* shared = tazE_freezeEngine( eng );
+    check( checkPairs( eng ) );
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    check( stats.liveObjects[tazR_Type_STATE] == NUM_PAIRS );
+    
+    check( useShared( shared ) );
+    check( checkPairs( eng ) );
+    
+    // Engines sharing have nowhere to put the shared references in an image.
+    taz_Config   scfg   = { .alloc = alloc, .shared = shared };
+    tazE_Engine* sharer = tazE_makeEngine( &scfg );
+    BufWriter    w      = { .base = { .write = bufWrite } };
+    check( sharer && !tazE_saveImage( sharer, &w.base ) );
+    tazE_freeEngine( sharer );
+    free( w.buf );
+    
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        pthread_t threads[4];
+        for( unsigned i = 0 ; i < 4 ; i++ )
+            check( !pthread_create( &threads[i], NULL, sharedThreadMain, shared ) );
+        for( unsigned i = 0 ; i < 4 ; i++ ) {
+            void* failed;
+            pthread_join( threads[i], &failed );
+            check( !failed );
+        }
+        check( checkPairs( eng ) );
+    #endif
+end_test( shared_engine, TEARDOWN_ENGINE )
+
 
 static bool calledErrorFun = false;
 static void errorFun( tazE_Engine* eng, tazE_Barrier* bar ) {
@@ -194,6 +1643,44 @@ begin_test( yield_handling, SETUP_ENGINE )
     fail();
 end_test( yield_handling, TEARDOWN_ENGINE )
 
+begin_test( jump_barrier, SETUP_ENGINE )
+    volatile unsigned errors = 0;
+    volatile unsigned yields = 0;
+    calledErrorFun = false;
+    calledYieldFun = false;
+    
+    // Both interrupts land on the one destination, told apart by `errnum`.
+    for( unsigned i = 0 ; i < 4 ; i++ ) {
+        tazE_Barrier bar = { .errorFun = errorFun, .yieldFun = yieldFun };
+        if( tazE_setJump( &bar ) ) {
+            if( bar.errnum == taz_ErrNum_NONE ) {
+                yields++;
+            }
+            else {
+                check( bar.errnum == taz_ErrNum_OTHER );
+                errors++;
+            }
+            continue;
+        }
+        tazE_pushJumpBarrier( eng, &bar );
+        
+        if( i % 2 )
+            doError( eng );
+        else
+            doYield( eng );
+        fail();
+    }
+    check( errors == 2 && yields == 2 );
+    check( calledErrorFun && calledYieldFun );
+    
+    tazE_Barrier bar = { 0 };
+    if( tazE_setJump( &bar ) )
+        fail();
+    tazE_pushJumpBarrier( eng, &bar );
+    tazE_popBarrier( eng, &bar );
+    check( ((EngineFull*)eng)->barriers == NULL );
+end_test( jump_barrier, TEARDOWN_ENGINE )
+
 char const* randLongStr( void ) {
     static char buf[32];
     for( unsigned i = 0 ; i < elemsof(buf) - 1 ; i++ )
@@ -258,6 +1745,76 @@ begin_test( short_strings, SETUP_ENGINE_AND_BARRIER )
     tazE_collect( eng, true );
 end_test( medium_strings, TEARDOWN_ENGINE_AND_BARRIER )
 
+// IDs are never handed out twice while in use, and those freed by the
+// collector are handed out again before the pool grows.
+begin_test( string_ids, SETUP_ENGINE_AND_BARRIER )
+    char     buf[64];
+    tazR_Str strs[1000];
+    for( unsigned i = 0 ; i < 1000 ; i++ ) {
+        sprintf( buf, "a long string, number %u", i );
+        strs[i] = tazE_makeStr( eng, buf, strlen( buf ) );
+        for( unsigned j = 0 ; j < i ; j++ )
+            check( strs[j] != strs[i] );
+    }
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    size_t nStrs  = stats.strCount;
+    size_t nSlots = stats.strSlots;
+    check( nSlots >= nStrs && nSlots < nStrs*2 + 8 );
+    
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.strCount <= nStrs - 1000 );
+    
+    for( unsigned i = 0 ; i < 1000 ; i++ ) {
+        sprintf( buf, "another long string, number %u", i );
+        strs[i] = tazE_makeStr( eng, buf, strlen( buf ) );
+        for( unsigned j = 0 ; j < i ; j++ )
+            check( strs[j] != strs[i] );
+    }
+    tazE_getStats( eng, &stats );
+    check( stats.strCount == nStrs );
+    check( stats.strSlots == nSlots );
+end_test( string_ids, TEARDOWN_ENGINE_AND_BARRIER )
+
+// The medium string table grows to keep probes short as strings are
+// interned, and shrinks back once they've been collected.
+begin_test( string_table, SETUP_ENGINE_AND_BARRIER )
+    static struct {
+        tazE_Bucket base;
+        tazR_TVal   strs[20000];
+    } buc;
+    tazE_addBucket( eng, &buc, 20000 );
+    
+    char       buf[16];
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    size_t nSlots = stats.strTableSlots;
+    size_t nUsed  = stats.strTableUsed;
+    
+    for( unsigned i = 0 ; i < 20000 ; i++ ) {
+        sprintf( buf, "field_%u", i );
+        buc.strs[i] = tazR_strVal( tazE_makeStr( eng, buf, strlen( buf ) ) );
+    }
+    for( unsigned i = 0 ; i < 20000 ; i++ ) {
+        sprintf( buf, "field_%u", i );
+        check( tazE_makeStr( eng, buf, strlen( buf ) ) == tazR_getValStr( buc.strs[i] ) );
+    }
+    
+    tazE_getStats( eng, &stats );
+    check( stats.strTableUsed == nUsed + 20000 );
+    check( stats.strTableUsed*4 <= stats.strTableSlots*3 );
+    check( stats.strProbeTotal < stats.strTableUsed*3 );
+    check( stats.strProbeMax < 64 );
+    
+    tazE_remBucket( eng, &buc );
+    tazE_collect( eng, true );
+    tazE_getStats( eng, &stats );
+    check( stats.strTableUsed == nUsed );
+    check( stats.strTableSlots == nSlots );
+end_test( string_table, TEARDOWN_ENGINE_AND_BARRIER )
+
 begin_test( string_comparison, SETUP_ENGINE_AND_BARRIER )
     for( unsigned i = 0 ; i < 1000 ; i++ ) {
         char const* shortRnd  = randShortStr();
@@ -294,14 +1851,44 @@ end_test( string_comparison, TEARDOWN_ENGINE_AND_BARRIER )
 begin_suite( engine_tests )
     with_test( make_and_free_engine )
     with_test( malloc_and_collect_objects )
+    with_test( generational_collection )
+    with_test( incremental_collection )
+    with_test( lazy_sweeping )
+    with_test( gc_statistics )
+    with_test( memory_accounting )
+    with_test( deferred_finalizers )
+    #if taz_CONFIG_ENABLE_GC_BACKGROUND_FREE
+        with_test( background_freeing )
+    #endif
+    with_test( heap_limits )
+    with_test( full_cycle_floor )
+    with_test( allocation_sampling )
+    with_test( object_heap )
+    with_test( side_mark_bits )
+    with_test( deep_marking )
+    #if taz_CONFIG_ENABLE_GC_PARALLEL_MARK
+        with_test( parallel_marking )
+    #endif
     with_test( zalloc_and_cancel_objects )
     with_test( raw_memory_management )
+    with_test( scratch_allocations )
+    #if taz_CONFIG_ENABLE_LARGE_OBJECT_SPACE
+        with_test( large_object_space )
+    #endif
+    with_test( arena_engine )
+    with_test( reset_engine )
+    with_test( engine_pool )
+    with_test( image_round_trip )
+    with_test( shared_engine )
     with_test( error_handling );
     with_test( panic_handling );
     with_test( yield_handling );
+    with_test( jump_barrier );
     with_test( long_strings );
     with_test( medium_strings );
     with_test( short_strings );
+    with_test( string_ids );
+    with_test( string_table );
     with_test( string_comparison );
 end_suite( engine_tests )
 
@@ -64,8 +64,64 @@ begin_test( test_globals, SETUP_ENGINE_AND_BARRIER )
     check( tazR_valEqual( *tazR_getGlobalValByLoc( eng, loc ), tazR_intVal( 321 ) ) );
 end_test( test_globals, TEARDOWN_ENGINE_AND_BARRIER )
 
+#define NUM_GLOBALS (200)
+
+begin_test( image_round_trip, SETUP_ENGINE_AND_BARRIER )
+    BufWriter    w    = { .base = { .write = bufWrite } };
+    tazE_Engine* copy = NULL;
+    tazR_initEnv( eng );
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   key;
+        tazR_TVal   idx;
+        tazR_TVal   rec;
+    } buc;
+    tazE_addBucket( eng, &buc, 3 );
+    
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+    
+    // Each global gets a record with its name and number.
+    char buf[32];
+    for( unsigned i = 0 ; i < NUM_GLOBALS ; i++ ) {
+        int len = sprintf( buf, "global_%u", i );
+        buc.key = tazR_strVal( tazE_makeStr( eng, buf, len ) );
+        
+        tazR_Rec* rec = tazR_makeRec( eng, idx );
+        buc.rec = tazR_recVal( rec );
+        tazR_recDef( eng, rec, tazR_strVal( tazE_makeStr( eng, "name", 4 ) ), buc.key );
+        tazR_recDef( eng, rec, tazR_strVal( tazE_makeStr( eng, "number", 6 ) ), tazR_intVal( i ) );
+        *tazR_getGlobalVal( eng, tazR_getValStr( buc.key ) ) = buc.rec;
+    }
+    tazE_remBucket( eng, &buc );
+    
+    check( tazE_saveImage( eng, &w.base ) );
+    copy = tazE_loadImage( &cfg, w.buf, w.len );
+    check( copy );
+    tazE_collect( copy, true );
+    
+    tazE_Barrier copyBar = { 0 };
+    if( setjmp( copyBar.errorDst ) || setjmp( copyBar.yieldDst ) )
+        fail();
+    tazE_pushBarrier( copy, &copyBar );
+    
+    for( unsigned i = 0 ; i < NUM_GLOBALS ; i++ ) {
+        int       len  = sprintf( buf, "global_%u", i );
+        tazR_Str  name = tazE_makeStr( copy, buf, len );
+        tazR_TVal val  = *tazR_getGlobalVal( copy, name );
+        check( tazR_getValType( val ) == tazR_Type_REC );
+        
+        tazR_Rec* rec = tazR_getValRec( val );
+        check( tazR_valEqual( tazR_recGet( copy, rec, tazR_strVal( tazE_makeStr( copy, "name", 4 ) ) ), tazR_strVal( name ) ) );
+        check( tazR_valEqual( tazR_recGet( copy, rec, tazR_strVal( tazE_makeStr( copy, "number", 6 ) ) ), tazR_intVal( i ) ) );
+    }
+    tazE_popBarrier( copy, &copyBar );
+end_test( image_round_trip, { free( w.buf ); if( copy ) tazE_freeEngine( copy ); TEARDOWN_ENGINE_AND_BARRIER } )
+
 begin_suite( environment_tests )
     with_test( test_globals );
+    with_test( image_round_trip );
 end_suite( environment_tests )
 
 int main( void ) {
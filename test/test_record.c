@@ -107,6 +107,9 @@ begin_test( record_fields, SETUP_ENGINE_AND_BARRIER )
 
     tazR_Rec* rec = tazR_makeRec( eng, idx );
     buc.rec = tazR_recVal( rec );
+    
+    size_t idxSize = tazE_deepSize( eng, idx );
+    size_t recSize = tazE_deepSize( eng, rec );
 
     for( unsigned i = 0 ; i < 1000 ; i++ ) {
         randVal( eng, &buc.key );
@@ -120,6 +123,13 @@ begin_test( record_fields, SETUP_ENGINE_AND_BARRIER )
         check( tazR_valEqual( tazR_recGet( eng, rec, buc.key ), buc.val2 ) );
     }
     
+    // The index's table and the record's values grow with the fields,
+    // the objects themselves don't.
+    check( tazE_shallowSize( eng, rec ) == tazE_shallowSize( eng, tazR_makeRec( eng, idx ) ) );
+    check( tazE_deepSize( eng, idx ) > idxSize );
+    check( tazE_deepSize( eng, rec ) > recSize );
+    check( tazE_deepSize( eng, rec ) - tazE_shallowSize( eng, rec ) >= sizeof(tazR_TVal)*tazR_recCount( eng, rec ) );
+    
     tazE_remBucket( eng, &buc );
 end_test( record_fields, TEARDOWN_ENGINE_AND_BARRIER )
 
@@ -265,6 +275,362 @@ begin_test( record_comparison, SETUP_ENGINE_AND_BARRIER )
     tazE_remBucket( eng, &buc );
 end_test( record_comparison, TEARDOWN_ENGINE )
 
+begin_test( record_write_barrier, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+        tazR_TVal   rec;
+    } buc;
+    tazE_addBucket( eng, &buc, 2 );
+
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+
+    tazR_Rec* rec = tazR_makeRec( eng, idx );
+    buc.rec = tazR_recVal( rec );
+
+    tazE_collect( eng, true );
+    check( tazR_isObjOld( tazR_toObj( rec ) ) );
+
+    // The child is only reachable through the old record, so it'll
+    // only survive a minor cycle if the barrier remembered `rec`.
+    tazR_Rec* child = tazR_makeRec( eng, idx );
+    tazR_recDef( eng, child, tazR_intVal( 0 ), tazR_intVal( 321 ) );
+    tazR_recDef( eng, rec, tazR_intVal( 0 ), tazR_recVal( child ) );
+    check( tazR_isObjRemembered( tazR_toObj( rec ) ) );
+
+    ((EngineFull*)eng)->nGCCycles = 1;
+    tazE_collect( eng, false );
+    check( tazR_isObjOld( tazR_toObj( child ) ) );
+    check( !tazR_isObjRemembered( tazR_toObj( rec ) ) );
+    check( tazR_valEqual( tazR_recGet( eng, child, tazR_intVal( 0 ) ), tazR_intVal( 321 ) ) );
+
+    tazE_remBucket( eng, &buc );
+end_test( record_write_barrier, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( record_incremental_barrier, SETUP_ENGINE_AND_BARRIER )
+    EngineFull* full = (EngineFull*)eng;
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+        tazR_TVal   holder;
+        tazR_TVal   rec;
+    } buc;
+    tazE_addBucket( eng, &buc, 3 );
+
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+
+    tazR_Rec* holder = tazR_makeRec( eng, idx );
+    buc.holder = tazR_recVal( holder );
+    
+    tazR_Rec* rec = tazR_makeRec( eng, idx );
+    buc.rec = tazR_recVal( rec );
+    
+    tazR_Rec* child = tazR_makeRec( eng, idx );
+    tazR_recDef( eng, child, tazR_intVal( 0 ), tazR_intVal( 321 ) );
+    tazR_recDef( eng, holder, tazR_intVal( 0 ), tazR_recVal( child ) );
+    tazR_recDef( eng, rec, tazR_intVal( 0 ), tazR_nil );
+    
+    // Start a full cycle and take a single step, this scans `rec` since
+    // it was the last root to be marked; `holder` is left unscanned.
+    full->gcStepSize = 1;
+    full->nGCCycles  = 0;
+    stepGC( full, 0 );
+    check( full->gcPhase == GCPhase_MARK );
+    check( !isObjMarked( tazR_toObj( child ) ) );
+    
+    // Now move the child from the unscanned record to the scanned one,
+    // the barrier should shade it.
+    tazR_recSet( eng, rec, tazR_intVal( 0 ), tazR_recVal( child ) );
+    tazR_recSet( eng, holder, tazR_intVal( 0 ), tazR_nil );
+    check( isObjMarked( tazR_toObj( child ) ) );
+    
+    tazE_collect( eng, false );
+    check( full->gcPhase == GCPhase_IDLE );
+    check( tazR_isObjOld( tazR_toObj( child ) ) );
+    check( tazR_valEqual( tazR_recGet( eng, child, tazR_intVal( 0 ) ), tazR_intVal( 321 ) ) );
+
+    tazE_remBucket( eng, &buc );
+end_test( record_incremental_barrier, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( weak_record, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+        tazR_TVal   rec;
+        tazR_TVal   kept;
+    } buc;
+    tazE_addBucket( eng, &buc, 3 );
+
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+
+    tazR_Rec* rec = tazR_makeRec( eng, idx );
+    buc.rec = tazR_recVal( rec );
+    tazR_recWeak( eng, rec, false );
+
+    tazR_Rec* kept = tazR_makeRec( eng, idx );
+    buc.kept = tazR_recVal( kept );
+
+    tazR_recDef( eng, rec, tazR_intVal( 0 ), tazR_recVal( tazR_makeRec( eng, idx ) ) );
+    tazR_recDef( eng, rec, tazR_intVal( 1 ), buc.kept );
+    tazR_recDef( eng, rec, tazR_intVal( 2 ), tazR_intVal( 123 ) );
+    tazR_recDef( eng, rec, tazR_intVal( 3 ), tazR_strVal( tazE_makeStr( eng, "cached string", 13 ) ) );
+
+    tazE_collect( eng, true );
+    check( tazR_getValType( tazR_recGet( eng, rec, tazR_intVal( 0 ) ) ) == tazR_Type_UDF );
+    check( tazR_valEqual( tazR_recGet( eng, rec, tazR_intVal( 1 ) ), buc.kept ) );
+    check( tazR_valEqual( tazR_recGet( eng, rec, tazR_intVal( 2 ) ), tazR_intVal( 123 ) ) );
+    check( tazR_getValType( tazR_recGet( eng, rec, tazR_intVal( 3 ) ) ) == tazR_Type_UDF );
+    check( tazR_recCount( eng, rec ) == 2 );
+
+    // Minor cycles clear young values just the same.
+    tazR_recDef( eng, rec, tazR_intVal( 0 ), tazR_recVal( tazR_makeRec( eng, idx ) ) );
+    ((EngineFull*)eng)->nGCCycles = 1;
+    tazE_collect( eng, false );
+    check( tazR_getValType( tazR_recGet( eng, rec, tazR_intVal( 0 ) ) ) == tazR_Type_UDF );
+    check( tazR_valEqual( tazR_recGet( eng, rec, tazR_intVal( 1 ) ), buc.kept ) );
+
+    tazE_remBucket( eng, &buc );
+end_test( weak_record, TEARDOWN_ENGINE_AND_BARRIER )
+
+begin_test( ephemeron_record, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+        tazR_TVal   rec;
+        tazR_TVal   key1;
+        tazR_TVal   key2;
+        tazR_TVal   tmp;
+    } buc;
+    tazE_addBucket( eng, &buc, 5 );
+
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+
+    tazR_Rec* rec = tazR_makeRec( eng, idx );
+    buc.rec = tazR_recVal( rec );
+    tazR_recWeak( eng, rec, true );
+    check( tazR_getPtrAddr( rec->index_and_flags ) != idx );
+
+    buc.key1 = tazR_strVal( tazE_makeStr( eng, "first key", 9 ) );
+    buc.key2 = tazR_strVal( tazE_makeStr( eng, "second key", 10 ) );
+
+    // The second key is only reachable through the value of the first,
+    // so it's only found alive on a second pass over the ephemeron.
+    tazR_Rec* val1 = tazR_makeRec( eng, idx );
+    buc.tmp = tazR_recVal( val1 );
+    tazR_recDef( eng, val1, tazR_intVal( 0 ), buc.key2 );
+    tazR_recDef( eng, rec, buc.key2, tazR_recVal( tazR_makeRec( eng, idx ) ) );
+    tazR_recDef( eng, rec, buc.key1, buc.tmp );
+    tazR_recDef( eng, rec, tazR_intVal( 7 ), tazR_recVal( tazR_makeRec( eng, idx ) ) );
+
+    buc.tmp = tazR_strVal( tazE_makeStr( eng, "third key", 9 ) );
+    tazR_recDef( eng, rec, buc.tmp, tazR_recVal( tazR_makeRec( eng, idx ) ) );
+    buc.tmp  = tazR_udf;
+    buc.key2 = tazR_udf;
+
+    tazE_collect( eng, true );
+    check( tazR_recCount( eng, rec ) == 3 );
+    check( tazR_getValType( tazR_recGet( eng, rec, buc.key1 ) ) == tazR_Type_REC );
+    check( tazR_getValType( tazR_recGet( eng, rec, tazR_intVal( 7 ) ) ) == tazR_Type_REC );
+
+    buc.key2 = tazR_recGet( eng, tazR_getValRec( tazR_recGet( eng, rec, buc.key1 ) ), tazR_intVal( 0 ) );
+    check( tazR_getValType( tazR_recGet( eng, rec, buc.key2 ) ) == tazR_Type_REC );
+
+    // The dropped key's slot is reclaimed at the next definition.
+    check( tazR_getPtrTag( rec->index_and_flags ) & SEP_FLAG_MASK );
+    tazR_recDef( eng, rec, tazR_intVal( 8 ), tazR_nil );
+    check( tazR_idxNumKeys( eng, tazR_getPtrAddr( rec->index_and_flags ) ) == 4 );
+    check( tazR_getPtrTag( rec->index_and_flags ) & EPHE_FLAG_MASK );
+    check( tazR_recCount( eng, rec ) == 4 );
+
+    // Once the first key goes, so does everything else.
+    buc.key1 = tazR_udf;
+    buc.key2 = tazR_udf;
+    tazE_collect( eng, true );
+    check( tazR_recCount( eng, rec ) == 2 );
+
+    tazE_remBucket( eng, &buc );
+end_test( ephemeron_record, TEARDOWN_ENGINE_AND_BARRIER )
+
+static ulongest bufRead( BufWriter* w, size_t* pos, unsigned bytes ) {
+    ulongest u = 0;
+    for( unsigned i = 0 ; i < bytes ; i++ )
+        u |= (ulongest)(uchar)w->buf[(*pos)++] << i*8;
+    return u;
+}
+
+// A linked list of records, all sharing the index returned.  The list
+// starts out as the index, so it's rooted while it's built.
+static tazR_Idx* makeRecList( tazE_Engine* eng, tazR_TVal* list ) {
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    *list = tazR_idxVal( idx );
+    for( unsigned i = 0 ; i < 100 ; i++ ) {
+        tazR_Rec* rec = tazR_makeRec( eng, idx );
+        tazR_recDef( eng, rec, tazR_strVal( tazE_makeStr( eng, "next node", 9 ) ), *list );
+        *list = tazR_recVal( rec );
+    }
+    return idx;
+}
+
+begin_test( heap_dump, SETUP_ENGINE_AND_BARRIER )
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   list;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    tazR_Idx* idx = makeRecList( eng, &buc.list );
+
+    BufWriter w = { .base = { .write = bufWrite } };
+    check( tazE_dumpHeap( eng, &w.base ) );
+    check( w.len > 8 && memcmp( w.buf, "TAZHEAP\1", 8 ) == 0 );
+
+    size_t   pos     = 8;
+    unsigned nRecs   = 0;
+    unsigned nStrs   = 0;
+    bool     rooted  = false;
+    bool     indexed = true;
+    while( true ) {
+        char tag = bufRead( &w, &pos, 1 );
+        if( tag == 'E' )
+            break;
+
+        ulongest id, ref;
+        switch( tag ) {
+            case 'R':
+                while( (ref = bufRead( &w, &pos, 8 )) != 0 )
+                    rooted = rooted || ref == (ulongest)(uintptr_t)tazR_toObj( tazR_getValRec( buc.list ) );
+            break;
+            case 'O': {
+                id = bufRead( &w, &pos, 8 );
+                tazR_Type type = bufRead( &w, &pos, 1 );
+                check( bufRead( &w, &pos, 4 ) > 0 );
+
+                // A record's index is its first reference.
+                ref = bufRead( &w, &pos, 8 );
+                if( type == tazR_Type_REC ) {
+                    nRecs++;
+                    indexed = indexed && ref == (ulongest)(uintptr_t)tazR_toObj( idx );
+                }
+                while( ref != 0 )
+                    ref = bufRead( &w, &pos, 8 );
+            } break;
+            case 'S':
+                bufRead( &w, &pos, 8 );
+                bufRead( &w, &pos, 4 );
+                nStrs++;
+            break;
+            default:
+                fail();
+        }
+    }
+    check( pos == w.len );
+    check( rooted );
+    check( indexed );
+    check( nRecs == 100 );
+    check( nStrs > 0 );
+    free( w.buf );
+
+    tazE_remBucket( eng, &buc );
+end_test( heap_dump, TEARDOWN_ENGINE_AND_BARRIER )
+
+// Writes a dump of the heap `heap_dump` checks to the given file, for
+// the analyzer to be tried on; see the makefile.
+static bool writeDump( char const* path ) {
+    taz_Config   cfg = { .alloc = alloc };
+    tazE_Engine* eng = tazE_makeEngine( &cfg );
+    tazE_Barrier bar = { 0 };
+    if( setjmp( bar.errorDst ) || setjmp( bar.yieldDst ) ) {
+        tazE_freeEngine( eng );
+        return false;
+    }
+    tazE_pushBarrier( eng, &bar );
+    
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   list;
+    } buc;
+    tazE_addBucket( eng, &buc, 1 );
+    makeRecList( eng, &buc.list );
+    
+    BufWriter w  = { .base = { .write = bufWrite } };
+    bool      ok = tazE_dumpHeap( eng, &w.base );
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    tazE_freeEngine( eng );
+    
+    FILE* file = ok ? fopen( path, "wb" ) : NULL;
+    ok = file && fwrite( w.buf, 1, w.len, file ) == w.len;
+    if( file )
+        fclose( file );
+    free( w.buf );
+    return ok;
+}
+
+#define SETUP_COMPACTING_ENGINE                                             \
+    taz_Config   cfg = { .alloc = alloc, .gcCompact = true };               \
+    tazE_Engine* eng = tazE_makeEngine( &cfg );                             \
+    tazE_Barrier bar = { 0 };                                               \
+    if( setjmp( bar.errorDst ) )                                            \
+        fail();                                                             \
+    if( setjmp( bar.yieldDst ) )                                            \
+        fail();                                                             \
+    tazE_pushBarrier( eng, &bar );
+
+begin_test( record_compaction, SETUP_COMPACTING_ENGINE )
+    struct {
+        tazE_Bucket base;
+        tazR_TVal   idx;
+        tazR_TVal   tmp;
+        tazR_TVal   recs[256];
+    } buc;
+    tazE_addBucket( eng, &buc, 258 );
+    
+    // Only one record in sixteen is kept, so the value arrays of the
+    // survivors are spread thin over their pages.
+    tazR_Idx* idx = tazR_makeIdx( eng );
+    buc.idx = tazR_idxVal( idx );
+    for( unsigned i = 0 ; i < 4096 ; i++ ) {
+        tazR_Rec* rec = tazR_makeRec( eng, idx );
+        buc.tmp = tazR_recVal( rec );
+        tazR_recDef( eng, rec, tazR_intVal( 0 ), tazR_intVal( i ) );
+        tazR_recDef( eng, rec, tazR_intVal( 1 ), tazR_intVal( i*2 ) );
+        if( i % 16 == 0 )
+            buc.recs[i/16] = buc.tmp;
+    }
+    buc.tmp = tazR_udf;
+    tazE_collect( eng, true );
+    
+    // Compaction waits for the outermost barrier to be popped; the
+    // records are unrooted after that, but nothing collects them
+    // before they're checked.
+    tazR_Rec* recs[256];
+    for( unsigned i = 0 ; i < 256 ; i++ )
+        recs[i] = tazR_getValRec( buc.recs[i] );
+    tazE_remBucket( eng, &buc );
+    tazE_popBarrier( eng, &bar );
+    
+    tazE_Stats stats;
+    tazE_getStats( eng, &stats );
+    check( stats.bytesCompacted > 0 );
+    #if taz_CONFIG_ENABLE_PAGE_RELEASE
+        check( stats.pagesReleased > 0 );
+    #endif
+    
+    tazE_pushBarrier( eng, &bar );
+    for( unsigned i = 0 ; i < 256 ; i++ ) {
+        check( tazR_valEqual( tazR_recGet( eng, recs[i], tazR_intVal( 0 ) ), tazR_intVal( i*16 ) ) );
+        check( tazR_valEqual( tazR_recGet( eng, recs[i], tazR_intVal( 1 ) ), tazR_intVal( i*32 ) ) );
+    }
+    tazE_popBarrier( eng, &bar );
+    
+    // With nothing left alive, an explicit compaction frees it all.
+    tazE_compact( eng );
+end_test( record_compaction, TEARDOWN_ENGINE )
+
 begin_suite( record_tests )
     with_test( create_record )
     with_test( record_fields )
@@ -272,9 +638,18 @@ begin_suite( record_tests )
     with_test( fail_on_set_from_udf )
     with_test( fail_on_set_to_udf )
     with_test( record_comparison )
+    with_test( record_write_barrier )
+    with_test( record_incremental_barrier )
+    with_test( weak_record )
+    with_test( ephemeron_record )
+    with_test( heap_dump )
+    with_test( record_compaction )
 end_suite( record_tests )
 
-int main( void ) {
+int main( int argc, char** argv ) {
+    if( argc == 3 && !strcmp( argv[1], "--dump" ) )
+        return writeDump( argv[2] ) ? 0 : 1;
+    
     if( run_suite( record_tests ) ) {
         printf( "PASSED\n" );
         return 0;
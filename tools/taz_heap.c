@@ -0,0 +1,524 @@
+/* Note: Heap Analyzer
+Reads a heap dump written by `tazE_dumpHeap()` (see the note in `taz_engine.h`
+for the format) and prints a summary of what's taking up the heap: the number
+and size of objects of each type, the objects with the largest retained sizes
+along with a path by which they're reachable from the roots, and
+records grouped by the index they share.
+
+An object's retained size is the amount of memory that would be released if
+it were to die, which is the sum of the sizes of all objects it dominates; an
+object A dominates another object B if every path from the roots to B passes
+through A.  The dominator tree is computed with the iterative algorithm from
+Cooper, Harvey, and Kennedy's "A Simple, Fast Dominance Algorithm"; which is
+quick enough for heaps of a few million objects.
+
+Usage: taz_heap [-n COUNT] DUMP_FILE
+*/
+#include "../taz_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STR_FLAG  (1LLU << 63)
+#define TYPE_STR  (tazR_Type_LAST_OBJECT + 1)
+#define TYPE_ROOT (tazR_Type_LAST_OBJECT + 2)
+#define NO_NODE   (~0U)
+
+typedef struct {
+    ulongest id;
+    ulongest size;
+    ulongest retained;
+    unsigned type;
+    unsigned refs;
+    unsigned nRefs;
+    unsigned idom;
+    unsigned parent;
+    unsigned order;
+} Node;
+
+typedef struct {
+    Node*     nodes;
+    unsigned  nNodes;
+    unsigned  capNodes;
+
+    // References are read as IDs then resolved to node indices, in place.
+    ulongest* refs;
+    unsigned  nRefs;
+    unsigned  capRefs;
+
+    // Reverse post order of the nodes reachable from the root.
+    unsigned* rpo;
+    unsigned  nRpo;
+} Heap;
+
+static char const* typeName( unsigned type ) {
+    switch( type ) {
+        case tazR_Type_IDX:   return "idx";
+        case tazR_Type_REC:   return "rec";
+        case tazR_Type_CODE:  return "code";
+        case tazR_Type_FUN:   return "fun";
+        case tazR_Type_FIB:   return "fib";
+        case tazR_Type_UPV:   return "upv";
+        case tazR_Type_STATE: return "state";
+        case TYPE_STR:        return "str";
+        case TYPE_ROOT:       return "root";
+        default:              return "?";
+    }
+}
+
+static void* grow( void* buf, unsigned* cap, size_t elem ) {
+    *cap = *cap > 0 ? *cap*2 : 1024;
+    buf  = realloc( buf, *cap*elem );
+    if( !buf ) {
+        fprintf( stderr, "Out of memory\n" );
+        exit( 1 );
+    }
+    return buf;
+}
+
+/********************************* Parsing ************************************/
+
+typedef struct {
+    uchar const* buf;
+    size_t       len;
+    size_t       pos;
+} Input;
+
+static ulongest readWord( Input* in, unsigned bytes ) {
+    if( in->pos + bytes > in->len ) {
+        fprintf( stderr, "Truncated heap dump\n" );
+        exit( 1 );
+    }
+    ulongest u = 0;
+    for( unsigned i = 0 ; i < bytes ; i++ )
+        u |= (ulongest)in->buf[in->pos++] << i*8;
+    return u;
+}
+
+static Node* addNode( Heap* heap, ulongest id, unsigned type, ulongest size ) {
+    if( heap->nNodes >= heap->capNodes )
+        heap->nodes = grow( heap->nodes, &heap->capNodes, sizeof(Node) );
+
+    Node* node = &heap->nodes[heap->nNodes++];
+    node->id    = id;
+    node->size  = size;
+    node->type  = type;
+    node->refs  = heap->nRefs;
+    node->nRefs = 0;
+    return node;
+}
+
+static void readRefs( Heap* heap, Input* in, Node* node ) {
+    ulongest id;
+    while( (id = readWord( in, 8 )) != 0 ) {
+        if( heap->nRefs >= heap->capRefs )
+            heap->refs = grow( heap->refs, &heap->capRefs, sizeof(ulongest) );
+        heap->refs[heap->nRefs++] = id;
+        node->nRefs++;
+    }
+}
+
+static void readHeap( Heap* heap, Input* in ) {
+    if( in->len < 8 || memcmp( in->buf, "TAZHEAP", 7 ) != 0 ) {
+        fprintf( stderr, "Not a heap dump\n" );
+        exit( 1 );
+    }
+    in->pos = 7;
+    if( readWord( in, 1 ) != 1 ) {
+        fprintf( stderr, "Unsupported heap dump version\n" );
+        exit( 1 );
+    }
+
+    // The root is always node zero.
+    addNode( heap, 0, TYPE_ROOT, 0 );
+
+    while( true ) {
+        char tag = readWord( in, 1 );
+        if( tag == 'E' )
+            break;
+
+        switch( tag ) {
+            case 'R':
+                // The root's refs have to stay contiguous.
+                if( heap->nodes[0].nRefs > 0 ) {
+                    fprintf( stderr, "Roots listed twice in heap dump\n" );
+                    exit( 1 );
+                }
+                heap->nodes[0].refs = heap->nRefs;
+                readRefs( heap, in, &heap->nodes[0] );
+            break;
+            case 'O': {
+                ulongest id   = readWord( in, 8 );
+                unsigned type = readWord( in, 1 );
+                ulongest size = readWord( in, 4 );
+                readRefs( heap, in, addNode( heap, id, type, size ) );
+            } break;
+            case 'S': {
+                ulongest id   = readWord( in, 8 );
+                ulongest size = readWord( in, 4 );
+                addNode( heap, id, TYPE_STR, size );
+            } break;
+            default:
+                fprintf( stderr, "Corrupt heap dump\n" );
+                exit( 1 );
+        }
+    }
+}
+
+static Heap* sortHeap;
+
+static int compareIds( void const* a, void const* b ) {
+    ulongest ia = sortHeap->nodes[*(unsigned const*)a].id;
+    ulongest ib = sortHeap->nodes[*(unsigned const*)b].id;
+    return ia < ib ? -1 : ia > ib ? 1 : 0;
+}
+
+// Replaces the reference IDs with node indices, references to anything
+// that isn't in the dump are replaced with the root; which doesn't matter
+// since the root dominates everything anyway.
+static void resolveRefs( Heap* heap ) {
+    unsigned* byId = malloc( sizeof(unsigned)*heap->nNodes );
+    for( unsigned i = 0 ; i < heap->nNodes ; i++ )
+        byId[i] = i;
+    sortHeap = heap;
+    qsort( byId + 1, heap->nNodes - 1, sizeof(unsigned), compareIds );
+
+    for( unsigned i = 0 ; i < heap->nRefs ; i++ ) {
+        ulongest id = heap->refs[i];
+        unsigned lo = 1, hi = heap->nNodes;
+        while( lo < hi ) {
+            unsigned mid = lo + (hi - lo)/2;
+            if( heap->nodes[byId[mid]].id < id )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        heap->refs[i] = (lo < heap->nNodes && heap->nodes[byId[lo]].id == id) ? byId[lo] : 0;
+    }
+    free( byId );
+}
+
+/******************************** Dominators **********************************/
+
+// A depth first walk from the root gives us the reverse post order the
+// dominator algorithm wants, done with an explicit stack since the heap
+// may be very deep.  The `parent` of each node is also set here, as the
+// node it was first reached from; so the path back to the root is a
+// valid, if not always the shortest, reference chain.
+static void orderHeap( Heap* heap ) {
+    unsigned* stack = malloc( sizeof(unsigned)*heap->nNodes );
+    unsigned* next  = calloc( heap->nNodes, sizeof(unsigned) );
+    unsigned  top   = 0;
+
+    heap->rpo  = malloc( sizeof(unsigned)*heap->nNodes );
+    heap->nRpo = 0;
+    for( unsigned i = 0 ; i < heap->nNodes ; i++ ) {
+        heap->nodes[i].parent = NO_NODE;
+        heap->nodes[i].order  = NO_NODE;
+        heap->nodes[i].idom   = NO_NODE;
+    }
+
+    heap->nodes[0].parent = 0;
+    stack[top++] = 0;
+    while( top > 0 ) {
+        unsigned n    = stack[top-1];
+        Node*    node = &heap->nodes[n];
+        if( next[n] < node->nRefs ) {
+            unsigned m = heap->refs[node->refs + next[n]++];
+            if( heap->nodes[m].parent == NO_NODE ) {
+                heap->nodes[m].parent = n;
+                stack[top++] = m;
+            }
+            continue;
+        }
+        heap->rpo[heap->nRpo++] = n;
+        top--;
+    }
+
+    // That gave us the post order, so flip it.
+    for( unsigned i = 0 ; i < heap->nRpo/2 ; i++ ) {
+        unsigned tmp = heap->rpo[i];
+        heap->rpo[i] = heap->rpo[heap->nRpo - 1 - i];
+        heap->rpo[heap->nRpo - 1 - i] = tmp;
+    }
+    for( unsigned i = 0 ; i < heap->nRpo ; i++ )
+        heap->nodes[heap->rpo[i]].order = i;
+
+    free( stack );
+    free( next );
+}
+
+static unsigned intersect( Heap* heap, unsigned a, unsigned b ) {
+    while( a != b ) {
+        while( heap->nodes[a].order > heap->nodes[b].order )
+            a = heap->nodes[a].idom;
+        while( heap->nodes[b].order > heap->nodes[a].order )
+            b = heap->nodes[b].idom;
+    }
+    return a;
+}
+
+static void findDominators( Heap* heap ) {
+    // Predecessor lists, in compressed form.
+    unsigned* predStart = calloc( heap->nNodes + 1, sizeof(unsigned) );
+    for( unsigned n = 0 ; n < heap->nNodes ; n++ ) {
+        Node* node = &heap->nodes[n];
+        for( unsigned i = 0 ; i < node->nRefs ; i++ )
+            predStart[heap->refs[node->refs + i] + 1]++;
+    }
+    for( unsigned n = 0 ; n < heap->nNodes ; n++ )
+        predStart[n + 1] += predStart[n];
+
+    unsigned* fill  = malloc( sizeof(unsigned)*heap->nNodes );
+    unsigned* preds = malloc( sizeof(unsigned)*(heap->nRefs + 1) );
+    memcpy( fill, predStart, sizeof(unsigned)*heap->nNodes );
+    for( unsigned n = 0 ; n < heap->nNodes ; n++ ) {
+        Node* node = &heap->nodes[n];
+        for( unsigned i = 0 ; i < node->nRefs ; i++ )
+            preds[fill[heap->refs[node->refs + i]]++] = n;
+    }
+    free( fill );
+
+    heap->nodes[0].idom = 0;
+    bool changed = true;
+    while( changed ) {
+        changed = false;
+        for( unsigned i = 1 ; i < heap->nRpo ; i++ ) {
+            unsigned n    = heap->rpo[i];
+            unsigned idom = NO_NODE;
+            for( unsigned j = predStart[n] ; j < predStart[n + 1] ; j++ ) {
+                unsigned p = preds[j];
+                if( heap->nodes[p].idom == NO_NODE )
+                    continue;
+                idom = (idom == NO_NODE) ? p : intersect( heap, p, idom );
+            }
+            if( heap->nodes[n].idom != idom ) {
+                heap->nodes[n].idom = idom;
+                changed = true;
+            }
+        }
+    }
+    free( predStart );
+    free( preds );
+
+    // Children come after their dominators in reverse post order, so
+    // walking it backwards adds each node's retained size to its
+    // dominator only once the node's own total is complete.
+    for( unsigned n = 0 ; n < heap->nNodes ; n++ )
+        heap->nodes[n].retained = heap->nodes[n].size;
+    for( unsigned i = heap->nRpo ; i-- > 1 ; ) {
+        Node* node = &heap->nodes[heap->rpo[i]];
+        heap->nodes[node->idom].retained += node->retained;
+    }
+}
+
+/********************************* Reports ************************************/
+
+static void printNode( Heap* heap, unsigned n ) {
+    Node* node = &heap->nodes[n];
+    if( node->type == TYPE_STR )
+        printf( "str#%llu", node->id & ~STR_FLAG );
+    else
+    if( node->type == TYPE_ROOT )
+        printf( "root" );
+    else
+        printf( "%s@%llx", typeName( node->type ), node->id );
+}
+
+static void printPath( Heap* heap, unsigned n ) {
+    unsigned path[16];
+    unsigned len = 0;
+    for( unsigned it = n ; it != 0 && len < 16 ; it = heap->nodes[it].parent )
+        path[len++] = it;
+
+    printf( "        root" );
+    if( len == 16 && heap->nodes[path[15]].parent != 0 )
+        printf( " -> ..." );
+    while( len-- > 0 ) {
+        printf( " -> " );
+        printNode( heap, path[len] );
+    }
+    printf( "\n" );
+}
+
+static void reportTypes( Heap* heap ) {
+    ulongest counts[TYPE_ROOT + 1] = { 0 };
+    ulongest sizes[TYPE_ROOT + 1]  = { 0 };
+    for( unsigned n = 1 ; n < heap->nNodes ; n++ ) {
+        Node* node = &heap->nodes[n];
+        if( node->type > TYPE_ROOT )
+            continue;
+        counts[node->type]++;
+        sizes[node->type] += node->size;
+    }
+
+    printf( "Objects by type:\n" );
+    printf( "    %-8s %12s %14s\n", "type", "count", "bytes" );
+    for( unsigned t = 0 ; t < TYPE_ROOT ; t++ ) {
+        if( counts[t] > 0 )
+            printf( "    %-8s %12llu %14llu\n", typeName( t ), counts[t], sizes[t] );
+    }
+    printf( "    %-8s %12s %14llu\n", "total", "", heap->nodes[0].retained );
+
+    unsigned unreachable = heap->nNodes - heap->nRpo;
+    if( unreachable > 0 )
+        printf( "    (%u unreachable nodes not counted)\n", unreachable );
+    printf( "\n" );
+}
+
+static int compareRetained( void const* a, void const* b ) {
+    ulongest ra = sortHeap->nodes[*(unsigned const*)a].retained;
+    ulongest rb = sortHeap->nodes[*(unsigned const*)b].retained;
+    return ra > rb ? -1 : ra < rb ? 1 : 0;
+}
+
+static void reportRetainers( Heap* heap, unsigned count ) {
+    unsigned* top = malloc( sizeof(unsigned)*heap->nRpo );
+    unsigned  n   = 0;
+    for( unsigned i = 1 ; i < heap->nRpo ; i++ )
+        top[n++] = heap->rpo[i];
+    sortHeap = heap;
+    qsort( top, n, sizeof(unsigned), compareRetained );
+
+    printf( "Largest retained sizes:\n" );
+    for( unsigned i = 0 ; i < n && i < count ; i++ ) {
+        Node* node = &heap->nodes[top[i]];
+        printf( "    %14llu  ", node->retained );
+        printNode( heap, top[i] );
+        printf( " (%llu bytes)\n", node->size );
+        printPath( heap, top[i] );
+    }
+    printf( "\n" );
+    free( top );
+}
+
+typedef struct {
+    unsigned idx;
+    ulongest count;
+    ulongest size;
+    ulongest retained;
+} Group;
+
+static int compareGroups( void const* a, void const* b ) {
+    Group const* ga = a;
+    Group const* gb = b;
+    return ga->count > gb->count ? -1 : ga->count < gb->count ? 1 : 0;
+}
+
+// Records reference their index, so any records sharing an index were
+// most likely built by the same piece of code; which makes these groups
+// a good stand-in for the 'class' of a record.  Members of a group often
+// dominate each other (as in a linked list) so a member's retained size
+// is only added to the group's if the nearest record dominating it is
+// from a different group; this isn't exact, but catches the usual case.
+static void reportIdxGroups( Heap* heap, unsigned count ) {
+    unsigned* idxOf   = malloc( sizeof(unsigned)*heap->nNodes );
+    unsigned* nearest = malloc( sizeof(unsigned)*heap->nNodes );
+    unsigned* slot    = malloc( sizeof(unsigned)*heap->nNodes );
+    Group*    groups  = malloc( sizeof(Group)*heap->nNodes );
+    unsigned  nGroups = 0;
+    for( unsigned n = 0 ; n < heap->nNodes ; n++ ) {
+        idxOf[n]   = NO_NODE;
+        nearest[n] = NO_NODE;
+        slot[n]    = NO_NODE;
+    }
+
+    for( unsigned n = 1 ; n < heap->nNodes ; n++ ) {
+        Node* node = &heap->nodes[n];
+        if( node->type != tazR_Type_REC )
+            continue;
+
+        for( unsigned i = 0 ; i < node->nRefs && idxOf[n] == NO_NODE ; i++ ) {
+            unsigned m = heap->refs[node->refs + i];
+            if( heap->nodes[m].type == tazR_Type_IDX )
+                idxOf[n] = m;
+        }
+    }
+
+    // Dominators come first in reverse post order.
+    for( unsigned i = 1 ; i < heap->nRpo ; i++ ) {
+        unsigned n    = heap->rpo[i];
+        unsigned idom = heap->nodes[n].idom;
+        nearest[n] = heap->nodes[idom].type == tazR_Type_REC ? idom : nearest[idom];
+    }
+
+    for( unsigned n = 1 ; n < heap->nNodes ; n++ ) {
+        unsigned idx = idxOf[n];
+        if( idx == NO_NODE )
+            continue;
+
+        if( slot[idx] == NO_NODE ) {
+            slot[idx] = nGroups;
+            groups[nGroups++] = (Group){ .idx = idx };
+        }
+        Group* group = &groups[slot[idx]];
+        group->count++;
+        group->size += heap->nodes[n].size;
+        if( nearest[n] == NO_NODE || idxOf[nearest[n]] != idx )
+            group->retained += heap->nodes[n].retained;
+    }
+    qsort( groups, nGroups, sizeof(Group), compareGroups );
+
+    printf( "Records by shared index:\n" );
+    printf( "    %-20s %12s %14s %14s\n", "index", "records", "bytes", "retained" );
+    for( unsigned i = 0 ; i < nGroups && i < count ; i++ ) {
+        Group* group = &groups[i];
+        printf( "    idx@%-16llx %12llu %14llu %14llu\n",
+            heap->nodes[group->idx].id, group->count, group->size, group->retained
+        );
+    }
+    printf( "\n" );
+
+    free( idxOf );
+    free( nearest );
+    free( slot );
+    free( groups );
+}
+
+int main( int argc, char** argv ) {
+    unsigned    count = 20;
+    char const* path  = NULL;
+    for( int i = 1 ; i < argc ; i++ ) {
+        if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+            count = atoi( argv[++i] );
+        else
+            path = argv[i];
+    }
+    if( !path ) {
+        fprintf( stderr, "Usage: %s [-n COUNT] DUMP_FILE\n", argv[0] );
+        return 1;
+    }
+
+    FILE* file = fopen( path, "rb" );
+    if( !file ) {
+        fprintf( stderr, "Can't open %s\n", path );
+        return 1;
+    }
+    fseek( file, 0, SEEK_END );
+    long len = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    uchar* buf = malloc( len > 0 ? len : 1 );
+    if( fread( buf, 1, len, file ) != (size_t)len ) {
+        fprintf( stderr, "Can't read %s\n", path );
+        return 1;
+    }
+    fclose( file );
+
+    Heap  heap = { 0 };
+    Input in   = { .buf = buf, .len = len, .pos = 0 };
+    readHeap( &heap, &in );
+    resolveRefs( &heap );
+    orderHeap( &heap );
+    findDominators( &heap );
+
+    reportTypes( &heap );
+    reportRetainers( &heap, count );
+    reportIdxGroups( &heap, count );
+
+    free( heap.nodes );
+    free( heap.refs );
+    free( heap.rpo );
+    free( buf );
+    return 0;
+}